@@ -0,0 +1,370 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "BatchRunner.h"
+#include "PhyView.h"
+#include "TreeCommands.h"
+#include "TreeLoader.h"
+#include "BinaryTreeFormat.h"
+#include "CompressedStream.h"
+
+#include <Bpp/Exceptions.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Graphics/CladogramPlot.h>
+#include <Bpp/Phyl/Graphics/PhylogramPlot.h>
+
+// From bpp-qt:
+#include <Bpp/Qt/Tree/TreeCanvas.h>
+
+// From Qt:
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QThread>
+
+// From the STL:
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+double toDouble(const BatchRunner::Operation& operation, size_t i)
+{
+  bool ok;
+  double value = QString::fromStdString(operation.arguments[i]).toDouble(&ok);
+  if (!ok)
+    throw Exception("Line " + TextTools::toString(operation.line) + ": '" + operation.arguments[i] + "' is not a number.");
+  return value;
+}
+}
+
+BatchRunner::BatchRunner(const QString& scriptPath, const string& format, const QString& outputDir, unsigned int numberOfThreads) :
+  operations_(),
+  format_(format),
+  outputDir_(outputDir),
+  numberOfThreads_(numberOfThreads > 0 ? numberOfThreads : static_cast<unsigned int>(max(1, QThread::idealThreadCount()))),
+  tables_()
+{
+  ifstream script(scriptPath.toStdString().c_str(), ios::in);
+  if (!script)
+    throw IOException("Cannot open script " + scriptPath.toStdString());
+  string line;
+  unsigned int lineNumber = 0;
+  while (getline(script, line))
+  {
+    ++lineNumber;
+    istringstream words(line);
+    Operation operation;
+    operation.line = lineNumber;
+    if (!(words >> operation.name) || operation.name[0] == '#')
+      continue;
+    string word;
+    while (words >> word)
+    {
+      operation.arguments.push_back(word);
+    }
+
+    // Check arguments now rather than after hours of processing:
+    const string& name = operation.name;
+    if (name == "midpoint-rooting")
+    {
+      // The criterion contains spaces:
+      string criterion = "Sum of squares";
+      if (!operation.arguments.empty())
+      {
+        criterion = operation.arguments[0];
+        for (size_t i = 1; i < operation.arguments.size(); ++i)
+        {
+          criterion += " " + operation.arguments[i];
+        }
+      }
+      operation.arguments.assign(1, criterion);
+    }
+    else if (name == "init-grafen" || name == "delete-lengths" || name == "delete-support-values" || name == "convert-to-clock-tree")
+    {
+      checkArguments_(operation, 0, 0);
+    }
+    else if (name == "compute-grafen" || name == "set-lengths" || name == "unresolve")
+    {
+      checkArguments_(operation, 1, 1);
+      toDouble(operation, 0);
+    }
+    else if (name == "attach-data")
+    {
+      checkArguments_(operation, 2, 4);
+      if (operation.arguments.size() > 2 && operation.arguments[2] != "id" && operation.arguments[2] != "name")
+        throw Exception("Line " + TextTools::toString(lineNumber) + ": key must be 'id' or 'name'.");
+      if (operation.arguments.size() > 3 && operation.arguments[3] != "comma" && operation.arguments[3] != "tab")
+        throw Exception("Line " + TextTools::toString(lineNumber) + ": separator must be 'comma' or 'tab'.");
+      const string& path = operation.arguments[0];
+      if (tables_.find(path) == tables_.end())
+      {
+        if (!QFileInfo::exists(QString::fromStdString(path)))
+          throw IOException("Line " + TextTools::toString(lineNumber) + ": cannot open data file " + path);
+        CompressedInputFile file(path);
+        string sep = operation.arguments.size() > 3 && operation.arguments[3] == "tab" ? "\t" : ",";
+        tables_[path] = shared_ptr<DataTable>(DataTable::read(file, sep));
+      }
+      const DataTable& table = *tables_[path];
+      bool found = false;
+      for (unsigned int i = 0; i < table.getNumberOfColumns() && !found; ++i)
+      {
+        found = table.getColumnName(i) == operation.arguments[1];
+      }
+      if (!found)
+        throw Exception("Line " + TextTools::toString(lineNumber) + ": no column " + operation.arguments[1] + " in " + path + ".");
+    }
+    else if (name == "set-names-from-data")
+    {
+      checkArguments_(operation, 1, 2);
+      if (operation.arguments.size() > 1 && operation.arguments[1] != "inner")
+        throw Exception("Line " + TextTools::toString(lineNumber) + ": unknown option " + operation.arguments[1] + ".");
+    }
+    else if (name == "naive-asr" || name == "fitch-asr")
+    {
+      checkArguments_(operation, 1, operation.arguments.size());
+    }
+    else if (name == "export-image")
+    {
+      checkArguments_(operation, 2, 3);
+      if (toDouble(operation, 0) < 1. || toDouble(operation, 1) < 1.)
+        throw Exception("Line " + TextTools::toString(lineNumber) + ": invalid image size.");
+      if (operation.arguments.size() > 2 && operation.arguments[2] != "phylogram" && operation.arguments[2] != "cladogram")
+        throw Exception("Line " + TextTools::toString(lineNumber) + ": drawing must be 'phylogram' or 'cladogram'.");
+    }
+    else
+    {
+      throw Exception("Line " + TextTools::toString(lineNumber) + ": unknown operation " + name + ".");
+    }
+    operations_.push_back(operation);
+  }
+}
+
+void BatchRunner::checkArguments_(const Operation& operation, size_t min, size_t max)
+{
+  if (operation.arguments.size() < min || operation.arguments.size() > max)
+    throw Exception("Line " + TextTools::toString(operation.line) + ": wrong number of arguments for " + operation.name + ".");
+}
+
+QString BatchRunner::getTreeOutputPath_(const QString& file) const
+{
+  return QDir(outputDir_).filePath(QFileInfo(file).fileName());
+}
+
+QString BatchRunner::getImageOutputPath_(const QString& file) const
+{
+  return QDir(outputDir_).filePath(QFileInfo(file).completeBaseName() + ".png");
+}
+
+void BatchRunner::checkOutputPaths_(const QStringList& files) const
+{
+  bool images = false;
+  for (const auto& operation : operations_)
+  {
+    if (operation.name == "export-image")
+      images = true;
+  }
+  // Paths are compared once resolved, whatever the way they are written:
+  auto resolve = [](const QString& path) {
+    QFileInfo info(path);
+    return info.exists() ? info.canonicalFilePath() : QDir::cleanPath(info.absoluteFilePath());
+  };
+  set<QString> inputs;
+  for (const auto& file : files)
+  {
+    inputs.insert(resolve(file));
+  }
+  map<QString, QString> outputs;
+  outputs[resolve(QDir(outputDir_).filePath("timing.tsv"))] = "the timing report";
+  for (const auto& file : files)
+  {
+    QStringList paths(getTreeOutputPath_(file));
+    if (images)
+      paths.append(getImageOutputPath_(file));
+    for (const auto& path : paths)
+    {
+      QString resolved = resolve(path);
+      if (inputs.find(resolved) != inputs.end())
+        throw Exception("The result of " + file.toStdString() + " would overwrite the input file " + resolved.toStdString() + ", choose another output directory.");
+      auto it = outputs.insert(make_pair(resolved, file));
+      if (!it.second)
+        throw Exception("Both " + it.first->second.toStdString() + " and " + file.toStdString() + " would be written to " + path.toStdString() + ".");
+    }
+  }
+}
+
+unsigned int BatchRunner::run(const QStringList& files)
+{
+  checkOutputPaths_(files);
+  QDir().mkpath(outputDir_);
+  vector< vector<Timing> > timings(static_cast<size_t>(files.size()));
+  atomic<int> next(0);
+  atomic<unsigned int> running(numberOfThreads_);
+  // The GUI thread waits here, serving image rendering requests until all workers are done:
+  QEventLoop loop;
+  vector<thread> workers;
+  for (unsigned int i = 0; i < numberOfThreads_; ++i)
+  {
+    workers.push_back(thread([this, &files, &timings, &next, &running, &loop]() {
+      for (int j = next++; j < files.size(); j = next++)
+      {
+        process_(files[j], timings[static_cast<size_t>(j)]);
+      }
+      if (--running == 0)
+        QMetaObject::invokeMethod(&loop, "quit", Qt::QueuedConnection);
+    }));
+  }
+  loop.exec();
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  unsigned int failures = 0;
+  ofstream report(QDir(outputDir_).filePath("timing.tsv").toStdString().c_str(), ios::out);
+  report << "File\tOperation\tSeconds\tError" << endl;
+  for (int j = 0; j < files.size(); ++j)
+  {
+    for (const auto& timing : timings[static_cast<size_t>(j)])
+    {
+      report << files[j].toStdString() << "\t" << timing.operation << "\t" << timing.seconds << "\t" << timing.error << endl;
+      if (!timing.error.empty())
+      {
+        cerr << files[j].toStdString() << ": " << timing.operation << ": " << timing.error << endl;
+        ++failures;
+      }
+    }
+  }
+  return failures;
+}
+
+void BatchRunner::process_(const QString& file, vector<Timing>& timings) const
+{
+  QElapsedTimer timer;
+  Timing timing;
+  timing.operation = "read";
+  try
+  {
+    timer.start();
+    shared_ptr<TreeTemplate<Node>> tree;
+    if (BinaryTreeFormat::isBinaryFile(file.toStdString()))
+    {
+      tree = BinaryTreeFormat::read(file.toStdString()).tree;
+    }
+    else
+    {
+      CompressedInputFile in(file.toStdString());
+      tree = TreeLoader::readTree(in, format_);
+    }
+    if (!tree)
+      throw Exception("No tree found in file.");
+    auto doc = make_shared<TreeDocument>();
+    doc->setTree(tree);
+    timing.seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    timings.push_back(timing);
+
+    for (const auto& operation : operations_)
+    {
+      timing.operation = operation.name;
+      timer.restart();
+      apply_(doc, operation, file);
+      timing.seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+      timings.push_back(timing);
+    }
+
+    timing.operation = "write";
+    timer.restart();
+    PhyView::writeTree(doc->tree(), getTreeOutputPath_(file).toStdString(), format_);
+    timing.seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    timings.push_back(timing);
+  }
+  catch (exception& e)
+  {
+    // Remaining operations are skipped for this file:
+    timing.seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    timing.error = e.what();
+    timings.push_back(timing);
+  }
+}
+
+void BatchRunner::apply_(shared_ptr<TreeDocument> doc, const Operation& operation, const QString& file) const
+{
+  // Commands are not kept, as there is nothing to undo:
+  unique_ptr<QUndoCommand> command;
+  const string& name = operation.name;
+  if (name == "midpoint-rooting")
+    command.reset(new MidpointRootingCommand(doc, operation.arguments[0]));
+  else if (name == "init-grafen")
+    command.reset(new InitGrafenCommand(doc));
+  else if (name == "compute-grafen")
+    command.reset(new ComputeGrafenCommand(doc, toDouble(operation, 0)));
+  else if (name == "set-lengths")
+    command.reset(new SetLengthCommand(doc, toDouble(operation, 0)));
+  else if (name == "delete-lengths")
+    command.reset(new DeleteLengthCommand(doc));
+  else if (name == "delete-support-values")
+    command.reset(new DeleteSupportValuesCommand(doc));
+  else if (name == "convert-to-clock-tree")
+    command.reset(new ConvertToClockTreeCommand(doc));
+  else if (name == "unresolve")
+    command.reset(new UnresolveUnsupportedNodesCommand(doc, toDouble(operation, 0)));
+  else if (name == "attach-data")
+  {
+    const DataTable& table = *tables_.at(operation.arguments[0]);
+    unsigned int index = 0;
+    while (table.getColumnName(index) != operation.arguments[1])
+    {
+      ++index;
+    }
+    bool useNames = operation.arguments.size() < 3 || operation.arguments[2] == "name";
+    command.reset(new AttachDataCommand(doc, table, index, useNames));
+  }
+  else if (name == "set-names-from-data")
+    command.reset(new SetNamesFromDataCommand(doc, operation.arguments[0], operation.arguments.size() > 1));
+  else if (name == "naive-asr")
+    command.reset(new NaiveAsrCommand(doc, operation.arguments));
+  else if (name == "fitch-asr")
+    command.reset(new ParsimonyAsrCommand(doc, operation.arguments));
+  else if (name == "export-image")
+  {
+    QString path = getImageOutputPath_(file);
+    bool cladogram = operation.arguments.size() > 2 && operation.arguments[2] == "cladogram";
+    exportImage_(doc, path, static_cast<int>(toDouble(operation, 0)), static_cast<int>(toDouble(operation, 1)), cladogram);
+  }
+  if (command)
+    command->redo();
+}
+
+void BatchRunner::exportImage_(shared_ptr<TreeDocument> doc, const QString& path, int width, int height, bool cladogram)
+{
+  // Widgets can only be used from the GUI thread:
+  string error;
+  QMetaObject::invokeMethod(qApp, [doc, path, width, height, cladogram, &error]() {
+    try
+    {
+      TreeCanvas canvas;
+      canvas.setTree(doc->getTree());
+      if (cladogram)
+        canvas.setTreeDrawing(CladogramPlot());
+      else
+        canvas.setTreeDrawing(PhylogramPlot());
+      ImageExportDialog::renderToPng(canvas.scene(), path, width, height, false, true);
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+  }, Qt::BlockingQueuedConnection);
+  if (!error.empty())
+    throw Exception("Image export failed: " + error);
+}
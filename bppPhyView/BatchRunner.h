@@ -0,0 +1,115 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _BATCHRUNNER_H_
+#define _BATCHRUNNER_H_
+
+#include "TreeDocument.h"
+
+// From bpp-core:
+#include <Bpp/Numeric/DataTable.h>
+
+// From Qt:
+#include <QString>
+#include <QStringList>
+
+// From the STL:
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief Apply a script of tree operations to many files, without display.
+ *
+ * A script has one operation per line, with space separated arguments.
+ * Empty lines and lines starting with '#' are ignored. Available operations are:
+ * - midpoint-rooting [criterion] ("Sum of squares" by default, or "Variance")
+ * - init-grafen
+ * - compute-grafen power
+ * - set-lengths length
+ * - delete-lengths
+ * - delete-support-values
+ * - convert-to-clock-tree
+ * - unresolve threshold
+ * - attach-data file column [id|name] [comma|tab]
+ * - set-names-from-data property [inner]
+ * - naive-asr property...
+ * - fitch-asr property...
+ * - export-image width height [phylogram|cladogram]
+ *
+ * Files are processed in parallel, each by one worker thread. The resulting trees
+ * are written in the output directory with their original file name, and images
+ * with the extension replaced by '.png'. Files which would be written to the same output
+ * file (inputs with the same name in different directories), or whose output file would
+ * be one of the input files, are refused before any processing. The time spent in each operation is written
+ * to 'timing.tsv' in the output directory. Images are rendered in the GUI thread,
+ * which must not be busy otherwise while run() is executing.
+ */
+class BatchRunner
+{
+public:
+  struct Operation
+  {
+    std::string name;
+    std::vector<std::string> arguments;
+    unsigned int line;
+  };
+
+  struct Timing
+  {
+    std::string operation;
+    double seconds;
+    std::string error;
+  };
+
+private:
+  std::vector<Operation> operations_;
+  std::string format_;
+  QString outputDir_;
+  unsigned int numberOfThreads_;
+  // Data files are read once and shared by all workers:
+  std::map<std::string, std::shared_ptr<DataTable>> tables_;
+
+public:
+  /**
+   * @brief Parse a script. Data files it refers to are read at this stage.
+   *
+   * @throw Exception If the script is not valid.
+   */
+  BatchRunner(const QString& scriptPath, const std::string& format, const QString& outputDir, unsigned int numberOfThreads);
+
+public:
+  /**
+   * @brief Process all files, and return when they are done.
+   *
+   * @return The number of files which could not be processed.
+   * @throw Exception If two files would be written to the same output file, or an input file would be overwritten.
+   */
+  unsigned int run(const QStringList& files);
+
+private:
+  QString getTreeOutputPath_(const QString& file) const;
+  QString getImageOutputPath_(const QString& file) const;
+
+  /**
+   * @throw Exception If two files have the same output file, or an output file is an input file.
+   */
+  void checkOutputPaths_(const QStringList& files) const;
+
+  void process_(const QString& file, std::vector<Timing>& timings) const;
+
+  void apply_(std::shared_ptr<TreeDocument> doc, const Operation& operation, const QString& file) const;
+
+  /**
+   * @brief Render a tree to a PNG file, in the GUI thread.
+   */
+  static void exportImage_(std::shared_ptr<TreeDocument> doc, const QString& path, int width, int height, bool cladogram);
+
+  static void checkArguments_(const Operation& operation, size_t min, size_t max);
+};
+
+#endif // _BATCHRUNNER_H_
@@ -0,0 +1,419 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "BinaryTreeFormat.h"
+#include "ValuePool.h"
+#include "TreeTraversal.h"
+
+#include <Bpp/BppString.h>
+#include <Bpp/Exceptions.h>
+#include <Bpp/Numeric/Number.h>
+
+// From Qt:
+#include <QFile>
+
+// From the STL:
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+using namespace std;
+
+const string BinaryTreeFormat::FORMAT = "PhyView binary";
+
+namespace
+{
+const char MAGIC[8] = { 'P', 'H', 'Y', 'V', 'I', 'E', 'W', 'B' };
+const uint32_t VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Property value types:
+const uint8_t STRING_VALUE = 0;
+const uint8_t DOUBLE_VALUE = 1;
+const uint8_t INT_VALUE    = 2;
+
+/**
+ * @brief The content of a section, built in memory before being written.
+ */
+class SectionBuffer
+{
+private:
+  vector<char> data_;
+
+public:
+  SectionBuffer() : data_() {}
+
+public:
+  template<class T>
+  void append(const T& value)
+  {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    data_.insert(data_.end(), bytes, bytes + sizeof(T));
+  }
+
+  /**
+   * @brief Append an array, padded to a multiple of 8 bytes.
+   */
+  template<class T>
+  void appendArray(const T* values, size_t n)
+  {
+    const char* bytes = reinterpret_cast<const char*>(values);
+    data_.insert(data_.end(), bytes, bytes + n * sizeof(T));
+    data_.resize((data_.size() + 7) / 8 * 8, 0);
+  }
+
+  template<class T>
+  void appendArray(const vector<T>& values) { appendArray(values.data(), values.size()); }
+
+  void write(ofstream& out, uint32_t tag) const
+  {
+    uint32_t reserved = 0;
+    uint64_t size = data_.size();
+    out.write(reinterpret_cast<const char*>(&tag), sizeof(tag));
+    out.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(data_.data(), static_cast<streamsize>(data_.size()));
+  }
+};
+
+/**
+ * @brief Reads arrays in place from a memory mapped section, with bounds checking.
+ */
+class SectionReader
+{
+private:
+  const char* position_;
+  const char* end_;
+
+public:
+  SectionReader(const char* begin, const char* end) : position_(begin), end_(end) {}
+
+public:
+  template<class T>
+  T read()
+  {
+    check_(sizeof(T));
+    T value;
+    memcpy(&value, position_, sizeof(T));
+    position_ += sizeof(T);
+    return value;
+  }
+
+  /**
+   * @return A pointer to an array stored in the file, which was padded to a multiple of 8 bytes.
+   */
+  template<class T>
+  const T* readArray(size_t n)
+  {
+    size_t size = (n * sizeof(T) + 7) / 8 * 8;
+    if (n > static_cast<size_t>(end_ - position_) / sizeof(T))
+      throw Exception("BinaryTreeFormat::read. Truncated file.");
+    check_(size);
+    const T* values = reinterpret_cast<const T*>(position_);
+    position_ += size;
+    return values;
+  }
+
+private:
+  void check_(size_t size) const
+  {
+    if (size > static_cast<size_t>(end_ - position_))
+      throw Exception("BinaryTreeFormat::read. Truncated file.");
+  }
+};
+
+struct Column
+{
+  vector<int32_t> nodes;
+  vector<uint32_t> strings;
+  vector<double> numbers;
+};
+}
+
+bool BinaryTreeFormat::isBinaryFile(const string& path)
+{
+  ifstream in(path.c_str(), ios::in | ios::binary);
+  char magic[sizeof(MAGIC)];
+  return in.read(magic, sizeof(magic)) && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+void BinaryTreeFormat::write(const string& path, const TreeTemplate<Node>& tree, const vector<int>& collapsedIds)
+{
+  size_t n = TreeTraversal::getNumberOfNodes(*tree.getRootNode());
+  vector<int32_t> ids, fathers;
+  vector<uint8_t> flags;
+  vector<double> lengths;
+  vector<uint64_t> nameOffsets(1, 0);
+  string names;
+  ids.reserve(n);
+  fathers.reserve(n);
+  flags.reserve(n);
+  lengths.reserve(n);
+  nameOffsets.reserve(n + 1);
+
+  // Strings are stored once, columns are keyed by property name, branch or node, and type:
+  unordered_map<string, uint32_t> stringCodes;
+  vector<string> strings;
+  auto code = [&stringCodes, &strings](const string& text) {
+    auto it = stringCodes.find(text);
+    if (it == stringCodes.end())
+    {
+      it = stringCodes.insert(make_pair(text, static_cast<uint32_t>(strings.size()))).first;
+      strings.push_back(text);
+    }
+    return it->second;
+  };
+  map<tuple<string, bool, uint8_t>, Column> columns;
+  auto addProperty = [&](int32_t index, const string& name, bool branch, const Clonable* value) {
+    Column* column = 0;
+    if (const string* text = SharedString::getText(value))
+    {
+      column = &columns[make_tuple(name, branch, STRING_VALUE)];
+      column->strings.push_back(code(*text));
+    }
+    else if (auto d = dynamic_cast<const Number<double>*>(value))
+    {
+      column = &columns[make_tuple(name, branch, DOUBLE_VALUE)];
+      column->numbers.push_back(d->getValue());
+    }
+    else if (auto i = dynamic_cast<const Number<int>*>(value))
+    {
+      column = &columns[make_tuple(name, branch, INT_VALUE)];
+      column->numbers.push_back(static_cast<double>(i->getValue()));
+    }
+    else
+      throw Exception("BinaryTreeFormat::write. Unsupported type for property " + name + ".");
+    column->nodes.push_back(index);
+  };
+
+  // Pre-order traversal with an explicit stack of (node, father index):
+  vector<pair<const Node*, int32_t>> stack(1, make_pair(tree.getRootNode(), -1));
+  while (!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    int32_t index = static_cast<int32_t>(ids.size());
+    ids.push_back(node->getId());
+    fathers.push_back(stack.back().second);
+    stack.pop_back();
+    flags.push_back(static_cast<uint8_t>((node->hasName() ? 1 : 0) | (node->hasDistanceToFather() ? 2 : 0)));
+    lengths.push_back(node->hasDistanceToFather() ? node->getDistanceToFather() : 0.);
+    if (node->hasName())
+      names += node->getName();
+    nameOffsets.push_back(names.size());
+    for (const auto& name : node->getNodePropertyNames())
+    {
+      addProperty(index, name, false, node->getNodeProperty(name));
+    }
+    for (const auto& name : node->getBranchPropertyNames())
+    {
+      addProperty(index, name, true, node->getBranchProperty(name));
+    }
+    // Push sons in reverse order so that they are written in their original order:
+    for (size_t i = node->getNumberOfSons(); i > 0; --i)
+    {
+      stack.push_back(make_pair(node->getSon(i - 1), index));
+    }
+  }
+
+  SectionBuffer nodes;
+  nodes.append(static_cast<uint64_t>(ids.size()));
+  nodes.appendArray(ids);
+  nodes.appendArray(fathers);
+  nodes.appendArray(flags);
+  nodes.appendArray(lengths);
+
+  SectionBuffer nameSection;
+  nameSection.appendArray(nameOffsets);
+  nameSection.appendArray(names.data(), names.size());
+
+  SectionBuffer properties;
+  properties.append(static_cast<uint64_t>(columns.size()));
+  for (const auto& column : columns)
+  {
+    uint8_t type = get<2>(column.first);
+    properties.append(code(get<0>(column.first)));
+    properties.append(static_cast<uint8_t>(get<1>(column.first) ? 1 : 0));
+    properties.append(type);
+    properties.append(static_cast<uint16_t>(0));
+    properties.append(static_cast<uint64_t>(column.second.nodes.size()));
+    properties.appendArray(column.second.nodes);
+    if (type == STRING_VALUE)
+      properties.appendArray(column.second.strings);
+    else
+      properties.appendArray(column.second.numbers);
+  }
+
+  // Written after the properties, which add their names to the strings:
+  SectionBuffer stringSection;
+  vector<uint64_t> stringOffsets(1, 0);
+  string stringData;
+  for (const auto& text : strings)
+  {
+    stringData += text;
+    stringOffsets.push_back(stringData.size());
+  }
+  stringSection.append(static_cast<uint64_t>(strings.size()));
+  stringSection.appendArray(stringOffsets);
+  stringSection.appendArray(stringData.data(), stringData.size());
+
+  SectionBuffer collapsed;
+  collapsed.append(static_cast<uint64_t>(collapsedIds.size()));
+  collapsed.appendArray(collapsedIds.data(), collapsedIds.size());
+
+  ofstream out(path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out)
+    throw IOException("BinaryTreeFormat::write. Cannot open file " + path);
+  out.write(MAGIC, sizeof(MAGIC));
+  out.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+  out.write(reinterpret_cast<const char*>(&BYTE_ORDER_MARK), sizeof(BYTE_ORDER_MARK));
+  nodes.write(out, NODES);
+  nameSection.write(out, NAMES);
+  stringSection.write(out, STRINGS);
+  properties.write(out, PROPERTIES);
+  collapsed.write(out, COLLAPSED);
+  if (!out)
+    throw IOException("BinaryTreeFormat::write. Error while writing file " + path);
+}
+
+BinaryTreeFormat::Content BinaryTreeFormat::read(const string& path)
+{
+  QFile file(QString::fromStdString(path));
+  if (!file.open(QIODevice::ReadOnly))
+    throw IOException("BinaryTreeFormat::read. Cannot open file " + path);
+  const char* data = reinterpret_cast<const char*>(file.map(0, file.size()));
+  if (!data)
+    throw IOException("BinaryTreeFormat::read. Cannot map file " + path);
+  SectionReader header(data, data + file.size());
+  const char* magic = header.readArray<char>(sizeof(MAGIC));
+  if (memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw Exception("BinaryTreeFormat::read. Not a PhyView binary file: " + path);
+  if (header.read<uint32_t>() != VERSION)
+    throw Exception("BinaryTreeFormat::read. Unsupported version.");
+  if (header.read<uint32_t>() != BYTE_ORDER_MARK)
+    throw Exception("BinaryTreeFormat::read. The file was written on a machine with another byte order.");
+
+  // Sections, in place:
+  map<uint32_t, SectionReader> sections;
+  const char* position = data + sizeof(MAGIC) + 8;
+  const char* end = data + file.size();
+  while (position < end)
+  {
+    SectionReader sectionHeader(position, end);
+    uint32_t tag = sectionHeader.read<uint32_t>();
+    sectionHeader.read<uint32_t>();
+    uint64_t size = sectionHeader.read<uint64_t>();
+    position += 16;
+    if (size > static_cast<uint64_t>(end - position))
+      throw Exception("BinaryTreeFormat::read. Truncated file.");
+    sections.insert(make_pair(tag, SectionReader(position, position + size)));
+    position += size;
+  }
+  if (sections.find(NODES) == sections.end() || sections.find(NAMES) == sections.end())
+    throw Exception("BinaryTreeFormat::read. Missing sections.");
+
+  SectionReader& nodeSection = sections.at(NODES);
+  size_t n = static_cast<size_t>(nodeSection.read<uint64_t>());
+  if (n == 0)
+    throw Exception("BinaryTreeFormat::read. No tree found in file.");
+  const int32_t* ids = nodeSection.readArray<int32_t>(n);
+  const int32_t* fathers = nodeSection.readArray<int32_t>(n);
+  const uint8_t* flags = nodeSection.readArray<uint8_t>(n);
+  const double* lengths = nodeSection.readArray<double>(n);
+  const uint64_t* nameOffsets = sections.at(NAMES).readArray<uint64_t>(n + 1);
+  const char* names = sections.at(NAMES).readArray<char>(static_cast<size_t>(nameOffsets[n]));
+
+  // Nodes are owned by this vector until the tree is complete:
+  vector<unique_ptr<Node>> nodes(n);
+  for (size_t i = 0; i < n; ++i)
+  {
+    if ((i == 0) != (fathers[i] < 0) || fathers[i] >= static_cast<int32_t>(i) || nameOffsets[i] > nameOffsets[i + 1])
+      throw Exception("BinaryTreeFormat::read. Corrupted data.");
+    nodes[i].reset(new Node(ids[i]));
+    if (flags[i] & 1)
+      nodes[i]->setName(string(names + nameOffsets[i], static_cast<size_t>(nameOffsets[i + 1] - nameOffsets[i])));
+    if (flags[i] & 2)
+      nodes[i]->setDistanceToFather(lengths[i]);
+    if (i > 0)
+      nodes[static_cast<size_t>(fathers[i])]->addSon(nodes[i].get());
+  }
+
+  if (sections.find(STRINGS) != sections.end() && sections.find(PROPERTIES) != sections.end())
+  {
+    SectionReader& stringSection = sections.at(STRINGS);
+    size_t numberOfStrings = static_cast<size_t>(stringSection.read<uint64_t>());
+    const uint64_t* stringOffsets = stringSection.readArray<uint64_t>(numberOfStrings + 1);
+    const char* stringData = stringSection.readArray<char>(static_cast<size_t>(stringOffsets[numberOfStrings]));
+    // Each string is allocated once, and shared by all properties with this value:
+    vector<shared_ptr<const string>> strings(numberOfStrings);
+    for (size_t i = 0; i < numberOfStrings; ++i)
+    {
+      if (stringOffsets[i] > stringOffsets[i + 1])
+        throw Exception("BinaryTreeFormat::read. Corrupted data.");
+      strings[i] = make_shared<const string>(stringData + stringOffsets[i], static_cast<size_t>(stringOffsets[i + 1] - stringOffsets[i]));
+    }
+
+    SectionReader& properties = sections.at(PROPERTIES);
+    uint64_t numberOfColumns = properties.read<uint64_t>();
+    for (uint64_t j = 0; j < numberOfColumns; ++j)
+    {
+      uint32_t name = properties.read<uint32_t>();
+      bool branch = properties.read<uint8_t>() != 0;
+      uint8_t type = properties.read<uint8_t>();
+      properties.read<uint16_t>();
+      size_t count = static_cast<size_t>(properties.read<uint64_t>());
+      if (name >= numberOfStrings || type > INT_VALUE)
+        throw Exception("BinaryTreeFormat::read. Corrupted data.");
+      const string& propertyName = *strings[name];
+      const int32_t* indices = properties.readArray<int32_t>(count);
+      const uint32_t* codes = type == STRING_VALUE ? properties.readArray<uint32_t>(count) : 0;
+      const double* numbers = type != STRING_VALUE ? properties.readArray<double>(count) : 0;
+      for (size_t k = 0; k < count; ++k)
+      {
+        if (indices[k] < 0 || static_cast<size_t>(indices[k]) >= n || (codes && codes[k] >= numberOfStrings))
+          throw Exception("BinaryTreeFormat::read. Corrupted data.");
+        Node& node = *nodes[static_cast<size_t>(indices[k])];
+        if (type == STRING_VALUE)
+        {
+          SharedString value(strings[codes[k]]);
+          if (branch)
+            node.setBranchProperty(propertyName, value);
+          else
+            node.setNodeProperty(propertyName, value);
+        }
+        else if (type == DOUBLE_VALUE)
+        {
+          if (branch)
+            node.setBranchProperty(propertyName, Number<double>(numbers[k]));
+          else
+            node.setNodeProperty(propertyName, Number<double>(numbers[k]));
+        }
+        else
+        {
+          if (branch)
+            node.setBranchProperty(propertyName, Number<int>(static_cast<int>(numbers[k])));
+          else
+            node.setNodeProperty(propertyName, Number<int>(static_cast<int>(numbers[k])));
+        }
+      }
+    }
+  }
+
+  Content content;
+  if (sections.find(COLLAPSED) != sections.end())
+  {
+    SectionReader& collapsed = sections.at(COLLAPSED);
+    size_t count = static_cast<size_t>(collapsed.read<uint64_t>());
+    const int32_t* collapsedIds = collapsed.readArray<int32_t>(count);
+    content.collapsedIds.assign(collapsedIds, collapsedIds + count);
+  }
+  // The tree owns the nodes from now on:
+  content.tree = TreeTraversal::makeTree(nodes[0].get());
+  for (auto& node : nodes)
+  {
+    node.release();
+  }
+  return content;
+}
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _BINARYTREEFORMAT_H_
+#define _BINARYTREEFORMAT_H_
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/TreeTemplate.h>
+
+// From the STL:
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief PhyView's own binary file format, for large annotated trees.
+ *
+ * A file stores the topology, names, branch lengths, node and branch properties
+ * (strings and numbers) and the ids of collapsed nodes. It is a header followed by
+ * tagged sections of arrays in native byte order, aligned on 8 bytes, so that it is
+ * read from a memory mapped file without any text parsing. Readers skip unknown
+ * sections, so that new ones can be added without changing the version.
+ *
+ * Nodes are stored in pre-order, each one with the index of its father.
+ * Property strings are stored once, and read as SharedString values.
+ */
+class BinaryTreeFormat
+{
+public:
+  static const std::string FORMAT;
+
+  struct Content
+  {
+    std::shared_ptr<TreeTemplate<Node>> tree;
+    std::vector<int> collapsedIds;
+  };
+
+private:
+  enum Section : uint32_t { NODES = 1, NAMES = 2, STRINGS = 3, PROPERTIES = 4, COLLAPSED = 5 };
+
+public:
+  /**
+   * @return true if the file starts like a PhyView binary file.
+   */
+  static bool isBinaryFile(const std::string& path);
+
+  /**
+   * @throw Exception If a property type is not supported, or the file cannot be written.
+   */
+  static void write(const std::string& path, const TreeTemplate<Node>& tree, const std::vector<int>& collapsedIds);
+
+  /**
+   * @throw Exception If the file cannot be read or is not valid.
+   */
+  static Content read(const std::string& path);
+};
+
+#endif // _BINARYTREEFORMAT_H_
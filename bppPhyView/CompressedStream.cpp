@@ -0,0 +1,307 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "CompressedStream.h"
+
+#include <Bpp/Exceptions.h>
+
+using namespace bpp;
+using namespace std;
+
+InflateStreamBuffer::InflateStreamBuffer(streambuf* source) :
+  source_(source),
+  mutex_(),
+  changed_(),
+  blocks_(),
+  current_(),
+  finished_(false),
+  stopped_(false),
+  error_(),
+  thread_()
+{
+  thread_ = thread([this]() { run_(); });
+}
+
+InflateStreamBuffer::~InflateStreamBuffer()
+{
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+InflateStreamBuffer::int_type InflateStreamBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  unique_lock<mutex> lock(mutex_);
+  changed_.wait(lock, [this]() { return !blocks_.empty() || finished_; });
+  if (blocks_.empty())
+  {
+    if (!error_.empty())
+      throw IOException("InflateStreamBuffer. " + error_);
+    return traits_type::eof();
+  }
+  current_.swap(blocks_.front());
+  blocks_.pop_front();
+  lock.unlock();
+  changed_.notify_all();
+  setg(current_.data(), current_.data(), current_.data() + current_.size());
+  return traits_type::to_int_type(*gptr());
+}
+
+bool InflateStreamBuffer::push_(vector<char>& block)
+{
+  unique_lock<mutex> lock(mutex_);
+  changed_.wait(lock, [this]() { return blocks_.size() < MAX_BLOCKS || stopped_; });
+  if (stopped_)
+    return false;
+  blocks_.push_back(vector<char>());
+  blocks_.back().swap(block);
+  lock.unlock();
+  changed_.notify_all();
+  return true;
+}
+
+void InflateStreamBuffer::run_()
+{
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+  stream.next_in = Z_NULL;
+  stream.avail_in = 0;
+  string error;
+  // 15 + 32: maximum window, gzip or zlib header detected automatically.
+  if (inflateInit2(&stream, 15 + 32) != Z_OK)
+  {
+    error = "Could not initialize decompression.";
+  }
+  else
+  {
+    vector<char> input(1 << 16);
+    vector<char> block(BLOCK_SIZE);
+    size_t blockSize = 0;
+    bool endOfInput = false;
+    bool endOfStream = false;
+    while (error.empty())
+    {
+      if (stream.avail_in == 0 && !endOfInput)
+      {
+        streamsize n = source_->sgetn(input.data(), static_cast<streamsize>(input.size()));
+        endOfInput = (n <= 0);
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = static_cast<uInt>(max<streamsize>(n, 0));
+      }
+      if (endOfStream)
+      {
+        if (stream.avail_in == 0 && endOfInput)
+          break;
+        // Another gzip member follows:
+        inflateReset(&stream);
+        endOfStream = false;
+      }
+      if (stream.avail_in == 0 && endOfInput)
+      {
+        error = "Unexpected end of compressed data.";
+        break;
+      }
+      stream.next_out = reinterpret_cast<Bytef*>(block.data() + blockSize);
+      stream.avail_out = static_cast<uInt>(block.size() - blockSize);
+      int status = inflate(&stream, Z_NO_FLUSH);
+      if (status == Z_STREAM_END)
+        endOfStream = true;
+      else if (status != Z_OK && status != Z_BUF_ERROR)
+        error = string("Invalid compressed data") + (stream.msg ? string(": ") + stream.msg : string("")) + ".";
+      blockSize = block.size() - stream.avail_out;
+      if (blockSize == block.size())
+      {
+        if (!push_(block))
+          break;
+        block.resize(BLOCK_SIZE);
+        blockSize = 0;
+      }
+    }
+    if (blockSize > 0 && error.empty())
+    {
+      block.resize(blockSize);
+      push_(block);
+    }
+    inflateEnd(&stream);
+  }
+  {
+    lock_guard<mutex> lock(mutex_);
+    error_ = error;
+    finished_ = true;
+  }
+  changed_.notify_all();
+}
+
+DeflateStreamBuffer::DeflateStreamBuffer(streambuf* sink, int level) :
+  sink_(sink),
+  stream_(),
+  input_(1 << 16),
+  output_(1 << 16),
+  finished_(false)
+{
+  stream_.zalloc = Z_NULL;
+  stream_.zfree = Z_NULL;
+  stream_.opaque = Z_NULL;
+  // 15 + 16: maximum window, with a gzip header.
+  if (deflateInit2(&stream_, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw Exception("DeflateStreamBuffer. Could not initialize compression.");
+  setp(input_.data(), input_.data() + input_.size());
+}
+
+DeflateStreamBuffer::~DeflateStreamBuffer()
+{
+  deflateEnd(&stream_);
+}
+
+DeflateStreamBuffer::int_type DeflateStreamBuffer::overflow(int_type c)
+{
+  if (finished_)
+    return traits_type::eof();
+  deflate_(Z_NO_FLUSH);
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int DeflateStreamBuffer::sync()
+{
+  // Flushing the compressor would degrade compression, data are only compressed:
+  if (!finished_)
+    deflate_(Z_NO_FLUSH);
+  return 0;
+}
+
+void DeflateStreamBuffer::finish()
+{
+  if (finished_)
+    return;
+  deflate_(Z_FINISH);
+  finished_ = true;
+  if (sink_->pubsync() != 0)
+    throw IOException("DeflateStreamBuffer::finish. Error while writing compressed data.");
+}
+
+void DeflateStreamBuffer::deflate_(int flush)
+{
+  stream_.next_in = reinterpret_cast<Bytef*>(pbase());
+  stream_.avail_in = static_cast<uInt>(pptr() - pbase());
+  int status;
+  do
+  {
+    stream_.next_out = reinterpret_cast<Bytef*>(output_.data());
+    stream_.avail_out = static_cast<uInt>(output_.size());
+    status = deflate(&stream_, flush);
+    if (status == Z_STREAM_ERROR)
+      throw IOException("DeflateStreamBuffer. Compression error.");
+    streamsize produced = static_cast<streamsize>(output_.size() - stream_.avail_out);
+    if (produced > 0 && sink_->sputn(output_.data(), produced) != produced)
+      throw IOException("DeflateStreamBuffer. Error while writing compressed data.");
+  }
+  while (stream_.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+  setp(input_.data(), input_.data() + input_.size());
+}
+
+Compression::Type Compression::detect(const string& path)
+{
+  ifstream file(path.c_str(), ios::in | ios::binary);
+  unsigned char magic[4] = { 0, 0, 0, 0 };
+  file.read(reinterpret_cast<char*>(magic), 4);
+  if (file.gcount() >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    return GZIP;
+  if (file.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+    return ZSTD;
+  return NONE;
+}
+
+bool Compression::isCompressedName(const string& path)
+{
+  return path.size() > 3 && path.compare(path.size() - 3, 3, ".gz") == 0;
+}
+
+void Compression::checkSupported(Type type, const string& path)
+{
+  if (type == ZSTD)
+    throw Exception("Zstandard compressed files can not be read, decompress " + path + " with zstd -d, or compress it with gzip.");
+}
+
+CompressedInputFile::CompressedInputFile(const string& path) :
+  istream(0),
+  file_(),
+  type_(Compression::detect(path)),
+  inflate_()
+{
+  Compression::checkSupported(type_, path);
+  file_.open(path.c_str(), ios::in | ios::binary);
+  if (!file_)
+    throw IOException("Cannot open file " + path);
+  if (type_ == Compression::GZIP)
+  {
+    inflate_.reset(new InflateStreamBuffer(file_.rdbuf()));
+    rdbuf(inflate_.get());
+  }
+  else
+  {
+    rdbuf(file_.rdbuf());
+  }
+  exceptions(ios::badbit);
+}
+
+CompressedOutputFile::CompressedOutputFile(const string& path, bool compressed) :
+  ostream(0),
+  path_(path),
+  file_(path.c_str(), ios::out | ios::binary | ios::trunc),
+  deflate_()
+{
+  if (!file_)
+    throw IOException("Cannot create file " + path);
+  if (compressed)
+  {
+    deflate_.reset(new DeflateStreamBuffer(file_.rdbuf()));
+    rdbuf(deflate_.get());
+  }
+  else
+  {
+    rdbuf(file_.rdbuf());
+  }
+}
+
+CompressedOutputFile::~CompressedOutputFile()
+{
+  try
+  {
+    close();
+  }
+  catch (exception&)
+  {}
+}
+
+void CompressedOutputFile::close()
+{
+  if (!file_.is_open())
+    return;
+  flush();
+  bool failed = fail();
+  try
+  {
+    if (deflate_)
+      deflate_->finish();
+  }
+  catch (exception&)
+  {
+    failed = true;
+  }
+  file_.close();
+  if (failed || !file_)
+    throw IOException("Error while writing file " + path_);
+}
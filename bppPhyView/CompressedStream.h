@@ -0,0 +1,199 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _COMPRESSEDSTREAM_H_
+#define _COMPRESSEDSTREAM_H_
+
+// From the STL:
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+/**
+ * @brief A stream buffer decompressing gzip data read from another one.
+ *
+ * Data are decompressed in a thread of their own, a few blocks ahead of the reader,
+ * so that decompression and parsing overlap. Concatenated gzip members are read as
+ * a single stream, as gunzip does. Errors, such as truncated data, are thrown as
+ * IOException by underflow(), and reach the reader if its stream has the badbit
+ * exception set.
+ */
+class InflateStreamBuffer :
+  public std::streambuf
+{
+private:
+  static const size_t BLOCK_SIZE = 1 << 18;
+  static const size_t MAX_BLOCKS = 4;
+
+  std::streambuf* source_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::deque<std::vector<char>> blocks_;
+  std::vector<char> current_;
+  bool finished_;
+  bool stopped_;
+  std::string error_;
+  std::thread thread_;
+
+public:
+  explicit InflateStreamBuffer(std::streambuf* source);
+
+  virtual ~InflateStreamBuffer();
+
+private:
+  InflateStreamBuffer(const InflateStreamBuffer&);
+  InflateStreamBuffer& operator=(const InflateStreamBuffer&);
+
+protected:
+  int_type underflow();
+
+private:
+  void run_();
+
+  /**
+   * @return false if the reader is gone.
+   */
+  bool push_(std::vector<char>& block);
+};
+
+/**
+ * @brief A stream buffer writing gzip data to another one.
+ *
+ * The gzip trailer is only written by finish().
+ */
+class DeflateStreamBuffer :
+  public std::streambuf
+{
+private:
+  std::streambuf* sink_;
+  z_stream stream_;
+  std::vector<char> input_;
+  std::vector<char> output_;
+  bool finished_;
+
+public:
+  /**
+   * @throw Exception If compression cannot be initialized.
+   */
+  DeflateStreamBuffer(std::streambuf* sink, int level = Z_DEFAULT_COMPRESSION);
+
+  virtual ~DeflateStreamBuffer();
+
+private:
+  DeflateStreamBuffer(const DeflateStreamBuffer&);
+  DeflateStreamBuffer& operator=(const DeflateStreamBuffer&);
+
+public:
+  /**
+   * @brief Compress the pending data and write the end of the gzip stream.
+   *
+   * @throw IOException If the data cannot be written.
+   */
+  void finish();
+
+protected:
+  int_type overflow(int_type c);
+
+  int sync();
+
+private:
+  void deflate_(int flush);
+};
+
+/**
+ * @brief Compression of tree and data files.
+ *
+ * Input files are recognized by their first bytes, whatever their name. Output
+ * files are compressed when their name ends with ".gz".
+ */
+class Compression
+{
+public:
+  enum Type { NONE, GZIP, ZSTD };
+
+public:
+  /**
+   * @return The compression of a file, from its first bytes.
+   */
+  static Type detect(const std::string& path);
+
+  /**
+   * @return true if a file written to this path should be compressed.
+   */
+  static bool isCompressedName(const std::string& path);
+
+  /**
+   * @throw Exception If files of this type cannot be read.
+   */
+  static void checkSupported(Type type, const std::string& path);
+};
+
+/**
+ * @brief A file read as text, decompressed on the fly if needed.
+ *
+ * The badbit exception is set, so that decompression errors reach the reader.
+ */
+class CompressedInputFile :
+  public std::istream
+{
+private:
+  std::ifstream file_;
+  Compression::Type type_;
+  std::unique_ptr<InflateStreamBuffer> inflate_;
+
+public:
+  /**
+   * @throw IOException If the file cannot be opened.
+   * @throw Exception If the file is compressed in an unsupported format.
+   */
+  explicit CompressedInputFile(const std::string& path);
+
+public:
+  bool isCompressed() const { return type_ != Compression::NONE; }
+};
+
+/**
+ * @brief A file written as text, compressed on the fly if requested.
+ */
+class CompressedOutputFile :
+  public std::ostream
+{
+private:
+  std::string path_;
+  std::ofstream file_;
+  std::unique_ptr<DeflateStreamBuffer> deflate_;
+
+public:
+  /**
+   * @param path The file.
+   * @param compressed Whether to write gzip data.
+   * @throw IOException If the file cannot be created.
+   */
+  CompressedOutputFile(const std::string& path, bool compressed);
+
+  /**
+   * @brief Write the end of the file, if close() was not called. Errors are ignored.
+   */
+  virtual ~CompressedOutputFile();
+
+public:
+  /**
+   * @brief Write the pending data and close the file.
+   *
+   * @throw IOException If the file could not be written.
+   */
+  void close();
+};
+
+#endif // _COMPRESSEDSTREAM_H_
@@ -0,0 +1,214 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "LevelOfDetail.h"
+
+// From bpp-core:
+#include <Bpp/Graphics/GraphicDevice.h>
+#include <Bpp/Graphics/RGBColor.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Graphics/PhylogramPlot.h>
+
+// From the STL:
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+size_t LevelOfDetailTreeDrawingListener::countRows_(const TreeLayout& layout, size_t maxLeaves) const
+{
+  size_t rows = 0;
+  size_t i = 0;
+  while (i < layout.getNumberOfNodes())
+  {
+    if (layout.getNumberOfLeaves(i) <= maxLeaves && expandedByUser_.find(layout.getId(i)) == expandedByUser_.end())
+    {
+      // Collapsed subtree, or leaf:
+      ++rows;
+      i += layout.getSubtreeSize(i);
+    }
+    else
+    {
+      if (layout.getSubtreeSize(i) == 1)
+        ++rows;
+      ++i;
+    }
+  }
+  return rows;
+}
+
+size_t LevelOfDetailTreeDrawingListener::getMaxRows_(double drawingHeight) const
+{
+  const TreeDrawing& td = canvas_->treeDrawing();
+  const TreeDrawingSettings& settings = td.getDisplaySettings();
+  double rowHeight = settings.drawLeafNames ? max(1., static_cast<double>(settings.fontLeafNames.getSize())) : 1.;
+  double height = drawingHeight * td.getYUnit() * canvas_->transform().m22();
+  return max(static_cast<size_t>(1), static_cast<size_t>(height / rowHeight));
+}
+
+unordered_map<int, size_t> LevelOfDetailTreeDrawingListener::cut_(const TreeLayout& layout, size_t maxRows) const
+{
+  // Smallest subtrees to collapse so that all rows fit. The number of rows decreases with their size:
+  size_t low = 1;
+  size_t high = layout.getNumberOfLeaves(0);
+  while (low < high)
+  {
+    size_t middle = low + (high - low) / 2;
+    if (countRows_(layout, middle) <= maxRows)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+
+  unordered_map<int, size_t> wanted;
+  if (low > 1)
+  {
+    size_t i = 0;
+    while (i < layout.getNumberOfNodes())
+    {
+      if (layout.getNumberOfLeaves(i) <= low && expandedByUser_.find(layout.getId(i)) == expandedByUser_.end())
+      {
+        if (layout.getSubtreeSize(i) > 1)
+          wanted[layout.getId(i)] = i;
+        i += layout.getSubtreeSize(i);
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+  return wanted;
+}
+
+void LevelOfDetailTreeDrawingListener::update()
+{
+  if (updating_ || !isEnabled() || !document_->hasTree() || !canvas_->treeDrawing().hasTree())
+    return;
+  pending_.clear();
+  const TreeLayout& layout = document_->getLayout();
+  TreeDrawing& td = canvas_->treeDrawing();
+
+  // Subtrees expanded by the user since the last update must stay so:
+  for (auto it = collapsed_.begin(); it != collapsed_.end(); )
+  {
+    if (!td.isNodeCollapsed(it->first))
+    {
+      expandedByUser_.insert(it->first);
+      it = collapsed_.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  unordered_map<int, size_t> wanted = cut_(layout, getMaxRows_(td.getHeight()));
+
+  bool changed = false;
+  for (const auto& node : collapsed_)
+  {
+    if (wanted.find(node.first) == wanted.end())
+    {
+      td.collapseNode(node.first, false);
+      changed = true;
+    }
+  }
+  for (auto it = wanted.begin(); it != wanted.end(); )
+  {
+    if (collapsed_.find(it->first) != collapsed_.end())
+    {
+      ++it;
+    }
+    else if (td.isNodeCollapsed(it->first))
+    {
+      // Collapsed by the user, not ours:
+      it = wanted.erase(it);
+    }
+    else
+    {
+      td.collapseNode(it->first, true);
+      changed = true;
+      ++it;
+    }
+  }
+  collapsed_.swap(wanted);
+
+  if (changed)
+  {
+    updating_ = true;
+    canvas_->redraw();
+    updating_ = false;
+  }
+}
+
+void LevelOfDetailTreeDrawingListener::invalidate()
+{
+  collapsed_.clear();
+  expandedByUser_.clear();
+  pending_.clear();
+  if (!isEnabled() || !document_->hasTree())
+    return;
+  // The new tree is not laid out by the drawing yet, which gives one unit of height per leaf:
+  const TreeLayout& layout = document_->getLayout();
+  pending_ = cut_(layout, getMaxRows_(static_cast<double>(layout.getNumberOfLeaves(0))));
+}
+
+void LevelOfDetailTreeDrawingListener::beforeDrawTree(const DrawTreeEvent& event)
+{
+  if (pending_.empty())
+    return;
+  TreeDrawing& td = canvas_->treeDrawing();
+  for (const auto& node : pending_)
+  {
+    td.collapseNode(node.first, true);
+  }
+  collapsed_.swap(pending_);
+  pending_.clear();
+}
+
+void LevelOfDetailTreeDrawingListener::clear()
+{
+  if (collapsed_.empty())
+    return;
+  TreeDrawing& td = canvas_->treeDrawing();
+  for (const auto& node : collapsed_)
+  {
+    td.collapseNode(node.first, false);
+  }
+  collapsed_.clear();
+  updating_ = true;
+  canvas_->redraw();
+  updating_ = false;
+}
+
+void LevelOfDetailTreeDrawingListener::enable(bool tf)
+{
+  TreeDrawingListenerAdapter::enable(tf);
+  if (tf)
+    update();
+  else
+    clear();
+}
+
+void LevelOfDetailTreeDrawingListener::afterDrawNode(const DrawNodeEvent& event)
+{
+  auto it = collapsed_.find(event.getNodeId());
+  if (it == collapsed_.end())
+    return;
+  const TreeDrawing* td = event.getTreeDrawing();
+  GraphicDevice* gd = event.getGraphicDevice();
+  const Cursor& cursor = event.getCursor();
+  // Draw a bar from the node to its deepest leaf:
+  const TreeLayout& layout = document_->getLayout();
+  double length = dynamic_cast<const PhylogramPlot*>(td) ? layout.getHeight(it->second) : static_cast<double>(layout.getDepth(it->second));
+  double width = length * td->getXUnit();
+  double height = max(1., td->getYUnit() * 0.8);
+  double x = cursor.getHPos() == GraphicDevice::TEXT_HORIZONTAL_RIGHT ? cursor.getX() - width : cursor.getX();
+  RGBColor fill = gd->getCurrentFillColor();
+  gd->setCurrentFillColor(RGBColor(190, 190, 190));
+  gd->drawRect(x, cursor.getY() - height / 2., width, height, GraphicDevice::FILL_FILLED);
+  gd->setCurrentFillColor(fill);
+}
@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _LEVELOFDETAIL_H_
+#define _LEVELOFDETAIL_H_
+
+#include "TreeDocument.h"
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Graphics/TreeDrawingListener.h>
+
+// From bpp-qt:
+#include <Bpp/Qt/Tree/TreeCanvas.h>
+
+// From the STL:
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief Level-of-detail rendering for large trees.
+ *
+ * Subtrees which would be drawn on less than a row are collapsed, so that the number of
+ * rows, and hence of scene items, is bounded by the size of the drawing whatever the
+ * size of the tree. A row is one pixel high, or the size of the leaf names font when
+ * they are displayed, so that drawn labels are always readable. Collapsed subtrees are
+ * drawn as bars spanning their depth. The cut is recomputed each time the drawing
+ * changes, so that detail comes back when the drawing is enlarged.
+ *
+ * Only the nodes collapsed by this listener are uncollapsed by it: nodes collapsed by
+ * the user are left untouched, and subtrees expanded by the user stay expanded.
+ * Subtree extents are read from the layout of the document, shared by all its windows.
+ */
+class LevelOfDetailTreeDrawingListener :
+  public TreeDrawingListenerAdapter
+{
+private:
+  std::shared_ptr<TreeDocument> document_;
+  TreeCanvas* canvas_;
+  bool updating_;
+
+  // Nodes collapsed by this listener, with their preorder index:
+  std::unordered_map<int, size_t> collapsed_;
+  std::unordered_set<int> expandedByUser_;
+  // Nodes to collapse before the first draw of a new tree:
+  std::unordered_map<int, size_t> pending_;
+
+public:
+  LevelOfDetailTreeDrawingListener(std::shared_ptr<TreeDocument> document, TreeCanvas* canvas) :
+    TreeDrawingListenerAdapter(false),
+    document_(document),
+    canvas_(canvas),
+    updating_(false),
+    collapsed_(),
+    expandedByUser_(),
+    pending_()
+  {}
+
+  LevelOfDetailTreeDrawingListener* clone() const { return new LevelOfDetailTreeDrawingListener(*this); }
+
+public:
+  /**
+   * @brief Recompute which subtrees are collapsed, and redraw if this changed.
+   */
+  void update();
+
+  /**
+   * @brief Must be called before the tree of the canvas is set again, which resets collapsed nodes.
+   *
+   * The subtrees to collapse are computed from the layout of the document, and collapsed
+   * when the new tree starts to be drawn, so that it is never drawn in full.
+   */
+  void invalidate();
+
+  /**
+   * @brief Uncollapse all nodes collapsed by this listener.
+   */
+  void clear();
+
+  void enable(bool tf);
+
+  /**
+   * @return true if the node was collapsed by this listener rather than by the user.
+   */
+  bool hasCollapsed(int id) const { return collapsed_.find(id) != collapsed_.end(); }
+
+  void beforeDrawTree(const DrawTreeEvent& event);
+
+  void afterDrawNode(const DrawNodeEvent& event);
+
+private:
+  /**
+   * @param drawingHeight The height of the drawing, in units of the drawing.
+   * @return The number of rows which can be drawn.
+   */
+  size_t getMaxRows_(double drawingHeight) const;
+
+  /**
+   * @return The smallest subtrees to collapse so that at most maxRows rows are drawn, with their preorder index.
+   */
+  std::unordered_map<int, size_t> cut_(const TreeLayout& layout, size_t maxRows) const;
+
+  /**
+   * @return The number of rows drawn if all subtrees with at most maxLeaves leaves are collapsed.
+   */
+  size_t countRows_(const TreeLayout& layout, size_t maxLeaves) const;
+};
+
+#endif // _LEVELOFDETAIL_H_
@@ -0,0 +1,333 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "MultiTreeFile.h"
+#include "TreeLoader.h"
+#include "TreeTraversal.h"
+
+#include <Bpp/Exceptions.h>
+#include <Bpp/Text/TextTools.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Io/IoTreeFactory.h>
+
+// From the STL:
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+/**
+ * @return The first word of a statement, in lower case.
+ */
+string firstWord(const string& text)
+{
+  size_t begin = 0;
+  while (begin < text.size() && isspace(static_cast<unsigned char>(text[begin])))
+    ++begin;
+  size_t end = begin;
+  while (end < text.size() && !isspace(static_cast<unsigned char>(text[end])) && text[end] != '=')
+    ++end;
+  return TextTools::toLower(text.substr(begin, end - begin));
+}
+
+/**
+ * @brief Remove the quotes around a Nexus label.
+ */
+string unquote(const string& label)
+{
+  string text = TextTools::removeSurroundingWhiteSpaces(label);
+  if (text.size() >= 2 && text.front() == '\'' && text.back() == '\'')
+  {
+    string result;
+    for (size_t i = 1; i + 1 < text.size(); ++i)
+    {
+      result += text[i];
+      if (text[i] == '\'' && text[i + 1] == '\'')
+        ++i;
+    }
+    return result;
+  }
+  return text;
+}
+}
+
+RangeStreamBuffer::int_type RangeStreamBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  if (remaining_ == 0)
+    return traits_type::eof();
+  streamsize n = source_->sgetn(buffer_.data(), static_cast<streamsize>(min<uint64_t>(remaining_, buffer_.size())));
+  if (n <= 0)
+    return traits_type::eof();
+  remaining_ -= static_cast<uint64_t>(n);
+  fetched_ += static_cast<uint64_t>(n);
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+shared_ptr<TreeTemplate<Node>> MultiTreeFile::scan(istream& in)
+{
+  bool nexus = (format_ == IOTreeFactory::NEXUS_FORMAT);
+  if (!nexus && format_ != IOTreeFactory::NEWICK_FORMAT && format_ != IOTreeFactory::NHX_FORMAT)
+    throw Exception("MultiTreeFile::scan. Format " + format_ + " is not supported.");
+  ranges_.clear();
+  names_.clear();
+  translation_.clear();
+  recentlyUsed_.clear();
+  cache_.clear();
+
+  // Counts the bytes read, by the scan and by the parser of the first tree:
+  RangeStreamBuffer buffer(in.rdbuf());
+  istream stream(&buffer);
+  stream.exceptions(ios::badbit);
+  shared_ptr<TreeTemplate<Node>> first;
+
+  // Only the beginning of Nexus statements is kept, to recognize them, but the
+  // translation table is kept as a whole:
+  const size_t headSize = 256;
+  string head;
+  bool translating = false;
+  bool blank = true;
+  int comment = 0;
+  bool quoted = false;
+  uint64_t start = 0, equal = 0, position = 0;
+  const int eof = streambuf::traits_type::eof();
+  int ci;
+  while ((ci = buffer.sgetc()) != eof)
+  {
+    char c = static_cast<char>(ci);
+    position = buffer.getPosition();
+    if (ranges_.empty() && comment == 0 && !quoted)
+    {
+      // The first tree is parsed from the stream, up to its ';':
+      bool newick = !nexus && blank && c != ';' && c != '[' && !isspace(static_cast<unsigned char>(c));
+      string word = nexus && c == '=' && equal == 0 ? firstWord(head) : "";
+      if (newick || word == "tree" || word == "utree")
+      {
+        if (nexus)
+        {
+          buffer.sbumpc();
+          head += c;
+          equal = position + 1;
+        }
+        else
+        {
+          start = position;
+        }
+        first = TreeLoader::readTree(stream, nexus ? IOTreeFactory::NEWICK_FORMAT : format_);
+        if (first)
+        {
+          endStatement_(head, start, equal, buffer.getPosition());
+          translate_(*first);
+        }
+        head.clear();
+        translating = false;
+        blank = true;
+        start = buffer.getPosition();
+        equal = 0;
+        continue;
+      }
+    }
+    buffer.sbumpc();
+    if (comment > 0)
+    {
+      if (c == '[')
+        ++comment;
+      else if (c == ']')
+        --comment;
+      continue;
+    }
+    if (quoted)
+    {
+      if (c == '\'')
+        quoted = false;
+    }
+    else if (c == '[')
+    {
+      ++comment;
+      continue;
+    }
+    else if (c == '\'')
+    {
+      quoted = true;
+    }
+    else if (c == ';')
+    {
+      if (!blank)
+        endStatement_(head, start, equal, position);
+      head.clear();
+      translating = false;
+      blank = true;
+      start = position + 1;
+      equal = 0;
+      continue;
+    }
+    else if (c == '=' && equal == 0)
+    {
+      equal = position + 1;
+    }
+    if (blank && isspace(static_cast<unsigned char>(c)))
+    {
+      start = position + 1;
+      continue;
+    }
+    blank = false;
+    if (nexus && (translating || head.size() < headSize))
+    {
+      head += c;
+      if (head.size() == headSize || isspace(static_cast<unsigned char>(c)))
+        translating = (firstWord(head) == "translate");
+    }
+  }
+  if (!blank && !nexus)
+    endStatement_(head, start, equal, buffer.getPosition());
+  return first;
+}
+
+void MultiTreeFile::endStatement_(const string& head, uint64_t start, uint64_t equal, uint64_t end)
+{
+  if (format_ != IOTreeFactory::NEXUS_FORMAT)
+  {
+    ranges_.push_back(make_pair(start, end));
+    names_.push_back("");
+    return;
+  }
+  string word = firstWord(head);
+  if (word == "translate")
+  {
+    readTranslation_(head);
+  }
+  else if ((word == "tree" || word == "utree") && equal > 0)
+  {
+    ranges_.push_back(make_pair(equal, end));
+    // tree [*] name = ..., comments are not in the head:
+    size_t i = head.find('=');
+    string declaration;
+    if (i != string::npos)
+      declaration = TextTools::removeSurroundingWhiteSpaces(head.substr(word.size(), i - word.size()));
+    if (!declaration.empty() && declaration[0] == '*')
+      declaration = declaration.substr(1);
+    names_.push_back(unquote(declaration));
+  }
+}
+
+void MultiTreeFile::readTranslation_(const string& statement)
+{
+  // translate key label, key label, ...
+  string text = statement.substr(string("translate").size());
+  size_t begin = 0;
+  bool quoted = false;
+  for (size_t i = 0; i <= text.size(); ++i)
+  {
+    if (i < text.size() && text[i] == '\'')
+      quoted = !quoted;
+    if (i == text.size() || (text[i] == ',' && !quoted))
+    {
+      string pair = TextTools::removeSurroundingWhiteSpaces(text.substr(begin, i - begin));
+      size_t space = pair.find_first_of(" \t\r\n");
+      if (space != string::npos)
+        translation_[pair.substr(0, space)] = unquote(pair.substr(space + 1));
+      begin = i + 1;
+    }
+  }
+}
+
+shared_ptr<const TreeTemplate<Node>> MultiTreeFile::getTree(size_t i)
+{
+  if (ranges_.empty())
+    throw Exception("MultiTreeFile::getTree. No tree in file " + path_ + ".");
+  if (i >= ranges_.size())
+    throw IndexOutOfBoundsException("MultiTreeFile::getTree.", i, 0, ranges_.size() - 1);
+  auto it = cache_.find(i);
+  if (it != cache_.end())
+  {
+    recentlyUsed_.splice(recentlyUsed_.begin(), recentlyUsed_, it->second.second);
+    return it->second.first;
+  }
+  shared_ptr<const TreeTemplate<Node>> tree = readTree_(i);
+  if (cacheSize_ == 0)
+    return tree;
+  if (cache_.size() >= cacheSize_)
+  {
+    cache_.erase(recentlyUsed_.back());
+    recentlyUsed_.pop_back();
+  }
+  recentlyUsed_.push_front(i);
+  cache_[i] = make_pair(tree, recentlyUsed_.begin());
+  return tree;
+}
+
+shared_ptr<const TreeTemplate<Node>> MultiTreeFile::readTree_(size_t i)
+{
+  uint64_t start = ranges_[i].first;
+  uint64_t size = ranges_[i].second - start;
+  if (!file_ || (file_->isCompressed() && filePosition_ > start))
+  {
+    file_.reset(new CompressedInputFile(path_));
+    filePosition_ = 0;
+  }
+  file_->clear();
+  if (file_->isCompressed())
+    file_->ignore(static_cast<streamsize>(start - filePosition_));
+  else
+    file_->seekg(static_cast<streamoff>(start));
+
+  // The tree is parsed from the file, within its range:
+  RangeStreamBuffer buffer(file_->rdbuf(), size);
+  istream in(&buffer);
+  in.exceptions(ios::badbit);
+  shared_ptr<TreeTemplate<Node>> tree;
+  try
+  {
+    // Comments before the tree, such as [&U] or [&R] in Nexus files:
+    const int eof = streambuf::traits_type::eof();
+    int c;
+    while ((c = buffer.sgetc()) != eof && (isspace(c) || c == '['))
+    {
+      if (c == '[')
+      {
+        while ((c = buffer.sbumpc()) != eof && c != ']')
+        {}
+      }
+      else
+      {
+        buffer.sbumpc();
+      }
+    }
+    bool nexus = (format_ == IOTreeFactory::NEXUS_FORMAT);
+    tree = TreeLoader::readTree(in, nexus ? IOTreeFactory::NEWICK_FORMAT : format_);
+  }
+  catch (...)
+  {
+    file_.reset();
+    throw;
+  }
+  filePosition_ = start + buffer.getFetched();
+  if (buffer.getFetched() != size)
+  {
+    file_.reset();
+    throw IOException("MultiTreeFile::getTree. File " + path_ + " was modified.");
+  }
+  if (!tree)
+    throw Exception("MultiTreeFile::getTree. No tree at index " + TextTools::toString(i) + ".");
+  translate_(*tree);
+  return tree;
+}
+
+void MultiTreeFile::translate_(TreeTemplate<Node>& tree) const
+{
+  if (translation_.empty())
+    return;
+  for (Node* node : TreeTraversal::postOrder(*tree.getRootNode()))
+  {
+    if (!node->hasName())
+      continue;
+    auto it = translation_.find(node->getName());
+    if (it != translation_.end())
+      node->setName(it->second);
+  }
+}
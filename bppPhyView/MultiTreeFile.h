@@ -0,0 +1,160 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _MULTITREEFILE_H_
+#define _MULTITREEFILE_H_
+
+#include "CompressedStream.h"
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/TreeTemplate.h>
+
+// From the STL:
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief A stream buffer reading at most a given number of bytes from another one.
+ *
+ * No byte beyond the range is requested from the source, so that it can be read
+ * further from where the range ends. The bytes read are counted, so that a parser
+ * reading from the buffer can be followed.
+ */
+class RangeStreamBuffer :
+  public std::streambuf
+{
+private:
+  std::streambuf* source_;
+  uint64_t remaining_;
+  uint64_t fetched_;
+  std::vector<char> buffer_;
+
+public:
+  /**
+   * @param source The stream buffer to read from, at its current position.
+   * @param size The number of bytes to read at most, unbounded by default.
+   */
+  RangeStreamBuffer(std::streambuf* source, uint64_t size = std::numeric_limits<uint64_t>::max(), size_t bufferSize = 1 << 16) :
+    source_(source),
+    remaining_(size),
+    fetched_(0),
+    buffer_(bufferSize)
+  {}
+
+public:
+  /**
+   * @return The number of bytes requested from the source.
+   */
+  uint64_t getFetched() const { return fetched_; }
+
+  /**
+   * @return The number of bytes read from this buffer.
+   */
+  uint64_t getPosition() const { return fetched_ - static_cast<uint64_t>(egptr() - gptr()); }
+
+protected:
+  int_type underflow();
+};
+
+/**
+ * @brief A file with several trees, such as bootstrap or MCMC samples, read on demand.
+ *
+ * The file is scanned once to record the byte range of each tree, and the first tree
+ * is parsed while scanning, so that files with a single tree are only read once. In Newick and NHX
+ * files, trees are the statements ended by ';'; in Nexus files, they are the 'tree'
+ * statements, and the 'translate' statement gives the names of their leaves. Quoted
+ * labels and comments in square brackets are skipped while scanning.
+ *
+ * A tree is only parsed when it is requested, and the most recently used ones are
+ * kept in a cache. The file is never loaded as a whole. Instances are not thread safe.
+ *
+ * Compressed files can not be read at an offset: they are decompressed from the
+ * position of the last tree read, or from their start to read a previous tree.
+ */
+class MultiTreeFile
+{
+private:
+  std::string path_;
+  std::string format_;
+  std::vector<std::pair<uint64_t, uint64_t>> ranges_;
+  std::vector<std::string> names_;
+  std::map<std::string, std::string> translation_;
+  size_t cacheSize_;
+  std::list<size_t> recentlyUsed_;
+  std::unordered_map<size_t, std::pair<std::shared_ptr<const TreeTemplate<Node>>, std::list<size_t>::iterator>> cache_;
+  std::unique_ptr<CompressedInputFile> file_;
+  uint64_t filePosition_;
+
+public:
+  /**
+   * @param path The file.
+   * @param format The format of the file, as in IOTreeFactory.
+   * @param cacheSize The number of parsed trees to keep.
+   */
+  MultiTreeFile(const std::string& path, const std::string& format, size_t cacheSize = 32) :
+    path_(path),
+    format_(format),
+    ranges_(),
+    names_(),
+    translation_(),
+    cacheSize_(cacheSize),
+    recentlyUsed_(),
+    cache_(),
+    file_(),
+    filePosition_(0)
+  {}
+
+public:
+  /**
+   * @brief Index the trees of the file, and parse the first one from the stream.
+   *
+   * The first tree is not kept in the cache: it is handed over to the caller.
+   *
+   * @param in A stream on the content of the file, read from its beginning.
+   * @return The first tree of the file, or a null pointer if it has none.
+   * @throw Exception If the format is not supported, or the first tree cannot be read.
+   */
+  std::shared_ptr<TreeTemplate<Node>> scan(std::istream& in);
+
+  const std::string& getPath() const { return path_; }
+
+  const std::string& getFormat() const { return format_; }
+
+  size_t getNumberOfTrees() const { return ranges_.size(); }
+
+  /**
+   * @return The name of a tree in a Nexus file, or an empty string.
+   */
+  const std::string& getTreeName(size_t i) const { return names_[i]; }
+
+  /**
+   * @brief Get a tree, parsing it if it is not in the cache.
+   *
+   * @throw Exception If the file has no tree, or the tree cannot be read.
+   * @throw IndexOutOfBoundsException If there is no tree i.
+   */
+  std::shared_ptr<const TreeTemplate<Node>> getTree(size_t i);
+
+private:
+  std::shared_ptr<const TreeTemplate<Node>> readTree_(size_t i);
+
+  void endStatement_(const std::string& head, uint64_t start, uint64_t equal, uint64_t end);
+
+  void readTranslation_(const std::string& statement);
+
+  void translate_(TreeTemplate<Node>& tree) const;
+};
+
+#endif // _MULTITREEFILE_H_
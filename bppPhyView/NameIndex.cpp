@@ -0,0 +1,228 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "NameIndex.h"
+
+#include "ValuePool.h"
+
+#include <Bpp/Exceptions.h>
+
+// From Qt:
+#include <QRegularExpression>
+
+// From the STL:
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+string NameIndex::toKey_(const string& text)
+{
+  string key(text);
+  for (auto& c : key)
+  {
+    c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  }
+  return key;
+}
+
+void NameIndex::clear()
+{
+  texts_.clear();
+  values_.clear();
+  sortedKeys_.clear();
+  grams_.clear();
+  properties_.clear();
+  propertyIds_.clear();
+  versions_.clear();
+  numberOfOccurrences_ = 0;
+  numberOfBuiltOccurrences_ = 0;
+  built_ = false;
+}
+
+void NameIndex::build(const Node& root)
+{
+  clear();
+  properties_.push_back("");
+  vector<const Node*> stack(1, &root);
+  while (!stack.empty())
+  {
+    const Node* node = stack.back();
+    stack.pop_back();
+    add_(*node, 0);
+    for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+    {
+      stack.push_back(node->getSon(i));
+    }
+  }
+  numberOfBuiltOccurrences_ = numberOfOccurrences_;
+  built_ = true;
+}
+
+void NameIndex::update(const Node& node)
+{
+  if (!built_)
+    return;
+  add_(node, ++versions_[node.getId()]);
+  if (numberOfOccurrences_ > 2 * numberOfBuiltOccurrences_)
+    compact_();
+}
+
+void NameIndex::add_(const Node& node, uint32_t version)
+{
+  Occurrence occurrence;
+  occurrence.nodeId = node.getId();
+  occurrence.version = version;
+  if (node.hasName())
+  {
+    occurrence.property = 0;
+    add_(node.getName(), occurrence);
+  }
+  for (const auto& property : node.getNodePropertyNames())
+  {
+    const string* value = SharedString::getText(node.getNodeProperty(property));
+    if (!value)
+      continue;
+    auto it = propertyIds_.find(property);
+    if (it == propertyIds_.end())
+    {
+      it = propertyIds_.insert(make_pair(property, static_cast<uint32_t>(properties_.size()))).first;
+      properties_.push_back(property);
+    }
+    occurrence.property = it->second;
+    add_(*value, occurrence);
+  }
+}
+
+void NameIndex::add_(const string& text, const Occurrence& occurrence)
+{
+  ++numberOfOccurrences_;
+  auto it = texts_.find(text);
+  if (it != texts_.end())
+  {
+    values_[it->second].occurrences.push_back(occurrence);
+    return;
+  }
+  uint32_t index = static_cast<uint32_t>(values_.size());
+  it = texts_.insert(make_pair(text, index)).first;
+  Value value;
+  value.text = &it->first;
+  string key = toKey_(text);
+  value.position = sortedKeys_.insert(make_pair(key, index));
+  value.occurrences.push_back(occurrence);
+  // Each gram is listed once per distinct text:
+  vector<uint32_t> grams;
+  for (size_t n = 1; n <= 3; ++n)
+  {
+    for (size_t i = 0; i + n <= key.size(); ++i)
+    {
+      grams.push_back(gram_(key, i, n));
+    }
+  }
+  sort(grams.begin(), grams.end());
+  grams.erase(unique(grams.begin(), grams.end()), grams.end());
+  for (auto gram : grams)
+  {
+    grams_[gram].push_back(index);
+  }
+  values_.push_back(std::move(value));
+}
+
+void NameIndex::compact_()
+{
+  // Only the current occurrences are kept, and texts which no longer occur are dropped:
+  vector<pair<string, vector<Occurrence>>> values;
+  values.reserve(values_.size());
+  for (auto& value : values_)
+  {
+    vector<Occurrence> occurrences;
+    for (const auto& occurrence : value.occurrences)
+    {
+      if (occurrence.version == getVersion_(occurrence.nodeId))
+        occurrences.push_back(occurrence);
+    }
+    if (!occurrences.empty())
+      values.push_back(make_pair(*value.text, std::move(occurrences)));
+  }
+  texts_.clear();
+  values_.clear();
+  sortedKeys_.clear();
+  grams_.clear();
+  numberOfOccurrences_ = 0;
+  for (auto& value : values)
+  {
+    for (const auto& occurrence : value.second)
+    {
+      add_(value.first, occurrence);
+    }
+  }
+  numberOfBuiltOccurrences_ = numberOfOccurrences_;
+}
+
+vector<NameIndex::Match> NameIndex::search(const string& query, Mode mode, size_t maxResults) const
+{
+  vector<Match> matches;
+  // Adds the current occurrences of a text, returns true when there are enough matches:
+  auto addMatches = [this, &matches, maxResults](const Value& value) {
+    for (const auto& occurrence : value.occurrences)
+    {
+      if (occurrence.version != getVersion_(occurrence.nodeId))
+        continue;
+      Match match;
+      match.nodeId = occurrence.nodeId;
+      match.property = properties_[occurrence.property];
+      match.text = *value.text;
+      matches.push_back(match);
+      if (matches.size() == maxResults)
+        return true;
+    }
+    return false;
+  };
+  if (query.empty() || maxResults == 0)
+    return matches;
+  string key = toKey_(query);
+
+  if (mode == PREFIX)
+  {
+    for (auto it = sortedKeys_.lower_bound(key);
+         it != sortedKeys_.end() && it->first.compare(0, key.size(), key) == 0;
+         ++it)
+    {
+      if (addMatches(values_[it->second]))
+        break;
+    }
+  }
+  else if (mode == SUBSTRING)
+  {
+    // Candidates are taken from the rarest gram of the query, then checked:
+    size_t n = min(key.size(), static_cast<size_t>(3));
+    const vector<uint32_t>* candidates = 0;
+    for (size_t i = 0; i + n <= key.size(); ++i)
+    {
+      auto it = grams_.find(gram_(key, i, n));
+      if (it == grams_.end())
+        return matches;
+      if (!candidates || it->second.size() < candidates->size())
+        candidates = &it->second;
+    }
+    for (auto index : *candidates)
+    {
+      const Value& value = values_[index];
+      if (value.position->first.find(key) != string::npos && addMatches(value))
+        break;
+    }
+  }
+  else
+  {
+    QRegularExpression regex(QString::fromStdString(query), QRegularExpression::CaseInsensitiveOption);
+    if (!regex.isValid())
+      throw Exception("NameIndex::search. Invalid regular expression: " + regex.errorString().toStdString());
+    for (const auto& value : values_)
+    {
+      if (regex.match(QString::fromStdString(*value.text)).hasMatch() && addMatches(value))
+        break;
+    }
+  }
+  return matches;
+}
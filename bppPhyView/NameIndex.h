@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _NAMEINDEX_H_
+#define _NAMEINDEX_H_
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+
+// From the STL:
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief A case insensitive text index over node names and string node properties.
+ *
+ * Each distinct text is indexed once, with the nodes where it occurs, so that values
+ * repeated over many nodes, such as the categorical annotations shared through the
+ * value pool, cost a single key. Prefix queries use a sorted map of the keys, substring
+ * queries use the posting lists of the 1 to 3 character grams of each distinct key,
+ * and regular expressions are matched once per distinct text.
+ * The index is updated node by node: the previous occurrences of an updated node are
+ * outdated by its version number, and the index is compacted when the occurrences
+ * added by updates outnumber the ones it was built with.
+ */
+class NameIndex
+{
+public:
+  enum Mode { PREFIX, SUBSTRING, REGEX };
+
+  struct Match
+  {
+    int nodeId;
+    // Empty for node names:
+    std::string property;
+    std::string text;
+  };
+
+private:
+  struct Occurrence
+  {
+    int nodeId;
+    // Index in properties_, 0 for node names:
+    uint32_t property;
+    uint32_t version;
+  };
+
+  struct Value
+  {
+    // The text is the key in texts_, the lower case key the one in sortedKeys_:
+    const std::string* text;
+    std::multimap<std::string, uint32_t>::iterator position;
+    std::vector<Occurrence> occurrences;
+  };
+
+  std::unordered_map<std::string, uint32_t> texts_;
+  std::vector<Value> values_;
+  std::multimap<std::string, uint32_t> sortedKeys_;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> grams_;
+  std::vector<std::string> properties_;
+  std::unordered_map<std::string, uint32_t> propertyIds_;
+  // Only nodes updated since the index was built have a version:
+  std::unordered_map<int, uint32_t> versions_;
+  size_t numberOfOccurrences_;
+  size_t numberOfBuiltOccurrences_;
+  bool built_;
+
+public:
+  NameIndex() :
+    texts_(),
+    values_(),
+    sortedKeys_(),
+    grams_(),
+    properties_(),
+    propertyIds_(),
+    versions_(),
+    numberOfOccurrences_(0),
+    numberOfBuiltOccurrences_(0),
+    built_(false)
+  {}
+
+public:
+  bool isBuilt() const { return built_; }
+
+  /**
+   * @brief Index all nodes of a (sub)tree.
+   */
+  void build(const Node& root);
+
+  /**
+   * @brief Forget everything. The index has to be built again before use.
+   */
+  void clear();
+
+  /**
+   * @brief Index a node again after its name or properties have changed.
+   */
+  void update(const Node& node);
+
+  /**
+   * @return At most maxResults matches, in no particular order.
+   * @throw Exception If the query is not a valid regular expression.
+   */
+  std::vector<Match> search(const std::string& query, Mode mode, size_t maxResults) const;
+
+  /**
+   * @return The number of distinct texts, some of which may no longer occur until the index is compacted.
+   */
+  size_t getNumberOfValues() const { return values_.size(); }
+
+private:
+  void add_(const Node& node, uint32_t version);
+
+  void add_(const std::string& text, const Occurrence& occurrence);
+
+  uint32_t getVersion_(int nodeId) const
+  {
+    auto it = versions_.find(nodeId);
+    return it == versions_.end() ? 0 : it->second;
+  }
+
+  void compact_();
+
+  static std::string toKey_(const std::string& text);
+
+  /**
+   * @return A code for the n characters (1 to 3) at position i in key.
+   */
+  static uint32_t gram_(const std::string& key, size_t i, size_t n)
+  {
+    uint32_t code = static_cast<uint32_t>(n) << 24;
+    for (size_t j = 0; j < n; ++j)
+    {
+      code |= static_cast<uint32_t>(static_cast<unsigned char>(key[i + j])) << (8 * (n - 1 - j));
+    }
+    return code;
+  }
+};
+
+#endif // _NAMEINDEX_H_
@@ -0,0 +1,249 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "NewickStreamReader.h"
+#include "TreeTraversal.h"
+
+#include <Bpp/Exceptions.h>
+#include <Bpp/Numeric/Number.h>
+#include <Bpp/Text/TextTools.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Io/Nhx.h>
+#include <Bpp/Phyl/Tree/TreeTools.h>
+
+// From the STL:
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+bool toNumber(const string& text, double& value)
+{
+  if (text.empty())
+    return false;
+  char* end = 0;
+  errno = 0;
+  value = strtod(text.c_str(), &end);
+  return errno == 0 && *end == '\0';
+}
+}
+
+shared_ptr<TreeTemplate<Node>> NewickStreamReader::readTree(istream& in) const
+{
+  streambuf* buffer = in.rdbuf();
+  const int eof = streambuf::traits_type::eof();
+  uint64_t position = 0;
+  auto error = [&position](const string& message) {
+    return IOException("NewickStreamReader::readTree. " + message + " at character " + TextTools::toString(position) + ".");
+  };
+
+  // The inner nodes whose ')' was not read yet:
+  vector<Node*> open;
+  // The node the next label, length or comment belongs to, if any:
+  Node* current = 0;
+  Node* root = 0;
+  vector<pair<Node*, string>> annotations;
+  int nextId = 0;
+  bool closed = false; // Whether current is an inner node, which has a label of its own.
+  string label;
+  bool quoted = false;
+  bool ended = false;
+
+  // Owns the nodes until the tree is built. Nodes do not delete their sons:
+  unique_ptr<Node, void (*)(Node*)> guard(0, [](Node* node) {
+    if (node)
+    {
+      for (Node* n : TreeTraversal::postOrder(*node))
+      {
+        delete n;
+      }
+    }
+  });
+
+  auto newLeaf = [&]() {
+    Node* leaf = new Node(nextId++);
+    if (open.empty())
+    {
+      if (root)
+        throw error("Several trees without separator");
+      root = leaf;
+      guard.reset(root);
+    }
+    else
+    {
+      open.back()->addSon(leaf);
+    }
+    current = leaf;
+    closed = false;
+  };
+
+  // Label read before a ':', a ',', a ')', a comment or the end of the tree:
+  auto endLabel = [&]() {
+    if (label.empty() && !quoted)
+      return;
+    string text = quoted ? label : TextTools::removeSurroundingWhiteSpaces(label);
+    if (!current)
+      newLeaf();
+    double value;
+    if (closed && !quoted && toNumber(text, value))
+      current->setBranchProperty(TreeTools::BOOTSTRAP, Number<double>(value));
+    else if (!text.empty() || quoted)
+      current->setName(text);
+    label.clear();
+    quoted = false;
+  };
+
+  int c;
+  while (!ended && (c = buffer->sbumpc()) != eof)
+  {
+    ++position;
+    char ch = static_cast<char>(c);
+    switch (ch)
+    {
+    case '(':
+    {
+      if (current || !label.empty() || quoted)
+        throw error("Unexpected '('");
+      Node* node = new Node();
+      if (open.empty())
+      {
+        if (root)
+          throw error("Several trees without separator");
+        root = node;
+        guard.reset(root);
+      }
+      else
+      {
+        open.back()->addSon(node);
+      }
+      open.push_back(node);
+      break;
+    }
+    case ',':
+    case ')':
+      endLabel();
+      if (open.empty())
+        throw error(string("Unexpected '") + ch + "'");
+      if (!current)
+        newLeaf(); // Empty leaf, as in (,).
+      if (ch == ')')
+      {
+        current = open.back();
+        open.pop_back();
+        current->setId(nextId++);
+        closed = true;
+      }
+      else
+      {
+        current = 0;
+      }
+      break;
+    case ':':
+    {
+      endLabel();
+      if (!current)
+        newLeaf();
+      string length;
+      while ((c = buffer->sgetc()) != eof && !strchr(",);[", c))
+      {
+        length += static_cast<char>(c);
+        buffer->sbumpc();
+        ++position;
+      }
+      double value;
+      if (!toNumber(TextTools::removeSurroundingWhiteSpaces(length), value))
+        throw error("Invalid branch length '" + length + "'");
+      current->setDistanceToFather(value);
+      break;
+    }
+    case '[':
+    {
+      endLabel();
+      string comment(1, ch);
+      int depth = 1;
+      while (depth > 0 && (c = buffer->sbumpc()) != eof)
+      {
+        ++position;
+        if (c == '[')
+          ++depth;
+        else if (c == ']')
+          --depth;
+        comment += static_cast<char>(c);
+      }
+      if (depth > 0)
+        throw error("Unterminated comment");
+      if (nhx_ && comment.compare(0, 6, "[&&NHX") == 0)
+      {
+        if (!current)
+          newLeaf();
+        annotations.push_back(make_pair(current, comment));
+      }
+      break;
+    }
+    case '\'':
+    {
+      if (!label.empty() || quoted)
+        throw error("Unexpected quote");
+      // Doubled quotes stand for quotes in the label:
+      while ((c = buffer->sbumpc()) != eof)
+      {
+        ++position;
+        if (c == '\'')
+        {
+          if (buffer->sgetc() != '\'')
+            break;
+          buffer->sbumpc();
+          ++position;
+        }
+        label += static_cast<char>(c);
+      }
+      if (c == eof)
+        throw error("Unterminated quote");
+      quoted = true;
+      break;
+    }
+    case ';':
+      ended = true;
+      break;
+    default:
+      if (isspace(static_cast<unsigned char>(ch)))
+      {
+        // Only spaces within labels are kept:
+        if (!label.empty() && !quoted)
+          label += ' ';
+      }
+      else if (quoted)
+      {
+        throw error("Unexpected character after quote");
+      }
+      else
+      {
+        label += ch;
+      }
+    }
+  }
+  // The last tree of a stream may lack its ';':
+  endLabel();
+  if (!root)
+    return shared_ptr<TreeTemplate<Node>>();
+  if (!open.empty())
+    throw error("Missing ')'");
+  guard.release();
+  shared_ptr<TreeTemplate<Node>> tree = TreeTraversal::makeTree(root);
+  if (!annotations.empty())
+  {
+    Nhx nhx;
+    for (auto& annotation : annotations)
+    {
+      nhx.setNodeProperties(*annotation.first, annotation.second);
+    }
+  }
+  return tree;
+}
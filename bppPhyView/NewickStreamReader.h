@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _NEWICKSTREAMREADER_H_
+#define _NEWICKSTREAMREADER_H_
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/TreeTemplate.h>
+
+// From the STL:
+#include <istream>
+#include <memory>
+#include <string>
+
+using namespace bpp;
+
+/**
+ * @brief Read Newick and NHX trees with an explicit stack, whatever their depth.
+ *
+ * The stream is read character by character from its buffer, and the tree is built
+ * while reading, without copying its description into a string first. Reading stops
+ * after the first ';', so that the next tree of the stream can be read by another call.
+ *
+ * Trees are built as by the readers of bpp: leaves get the names, lengths are set as
+ * distances to fathers, numeric labels of inner nodes are read as bootstrap values and
+ * node ids are assigned in post-order. In addition, labels may be quoted, and inner
+ * labels which are not numbers are read as names. Comments are ignored, except NHX
+ * tags when reading NHX.
+ */
+class NewickStreamReader
+{
+private:
+  bool nhx_;
+
+public:
+  /**
+   * @param nhx Read NHX tags, [&&NHX:...], as properties.
+   */
+  explicit NewickStreamReader(bool nhx = false) :
+    nhx_(nhx)
+  {}
+
+public:
+  /**
+   * @return The tree read, or a null pointer if the stream contains no tree.
+   * @throw IOException If the description of the tree is not valid.
+   */
+  std::shared_ptr<TreeTemplate<Node>> readTree(std::istream& in) const;
+};
+
+#endif // _NEWICKSTREAMREADER_H_
@@ -0,0 +1,179 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "NodeTableModel.h"
+#include "ValuePool.h"
+
+#include <Bpp/Numeric/Number.h>
+
+// From bpp-qt:
+#include <Bpp/Qt/QtTools.h>
+
+// From the STL:
+#include <algorithm>
+
+using namespace std;
+
+const int NodeTableModel::ID_COLUMN             = 0;
+const int NodeTableModel::NAME_COLUMN           = 1;
+const int NodeTableModel::LENGTH_COLUMN         = 2;
+const int NodeTableModel::FIRST_PROPERTY_COLUMN = 3;
+
+NodeTableModel::NodeTableModel(std::shared_ptr<TreeDocument> document, QObject* parent) :
+  QAbstractTableModel(parent),
+  document_(document),
+  nodes_(),
+  rows_(),
+  nodeProperties_(),
+  branchProperties_()
+{
+  reset();
+}
+
+void NodeTableModel::reset()
+{
+  beginResetModel();
+  nodes_ = TreeTraversal::postOrder(document_->tree().rootNode());
+  rows_.clear();
+  for (size_t i = 0; i < nodes_.size(); ++i)
+  {
+    rows_[nodes_[i]->getId()] = static_cast<int>(i);
+  }
+  nodeProperties_.clear();
+  branchProperties_.clear();
+  nodeProperties_ = document_->getPropertyStore().getColumnNames();
+  const set<string>& branchProperties = document_->getSummary().getBranchPropertyNames();
+  branchProperties_.assign(branchProperties.begin(), branchProperties.end());
+  endResetModel();
+}
+
+bool NodeTableModel::hasColumn_(const string& property) const
+{
+  return find(nodeProperties_.begin(), nodeProperties_.end(), property) != nodeProperties_.end()
+         || find(branchProperties_.begin(), branchProperties_.end(), property) != branchProperties_.end();
+}
+
+void NodeTableModel::update(const TreeChange& change)
+{
+  if (change.has(TreeChange::TOPOLOGY | TreeChange::PROPERTIES_REMOVED))
+  {
+    reset();
+    return;
+  }
+  for (const auto& property : change.getProperties())
+  {
+    if (!hasColumn_(property))
+    {
+      reset();
+      return;
+    }
+  }
+  const auto& ids = change.getNodeIds();
+  if (ids.empty() || nodes_.empty())
+    return;
+  int lastColumn = columnCount() - 1;
+  // Beyond this, a single signal is cheaper than one per row:
+  if (ids.size() > 1000)
+  {
+    emit dataChanged(index(0, 0), index(rowCount() - 1, lastColumn));
+    return;
+  }
+  for (int id : ids)
+  {
+    auto it = rows_.find(id);
+    if (it != rows_.end())
+      emit dataChanged(index(it->second, 0), index(it->second, lastColumn));
+  }
+}
+
+int NodeTableModel::rowCount(const QModelIndex& parent) const
+{
+  return parent.isValid() ? 0 : static_cast<int>(nodes_.size());
+}
+
+int NodeTableModel::columnCount(const QModelIndex& parent) const
+{
+  return parent.isValid() ? 0 : FIRST_PROPERTY_COLUMN + static_cast<int>(nodeProperties_.size() + branchProperties_.size());
+}
+
+QVariant NodeTableModel::toVariant_(const Clonable* property)
+{
+  if (auto str = SharedString::getText(property))
+    return QtTools::toQt(*str);
+  if (auto num = dynamic_cast<const Number<double>*>(property))
+    return num->getValue();
+  return QVariant();
+}
+
+QVariant NodeTableModel::data(const QModelIndex& index, int role) const
+{
+  if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::EditRole))
+    return QVariant();
+  const Node* node = nodes_[static_cast<size_t>(index.row())];
+  int column = index.column();
+  if (column == ID_COLUMN)
+    return node->getId();
+  if (column == NAME_COLUMN)
+    return node->hasName() ? QtTools::toQt(node->getName()) : QVariant();
+  if (column == LENGTH_COLUMN)
+    return node->hasDistanceToFather() ? QVariant(node->getDistanceToFather()) : QVariant();
+  size_t i = static_cast<size_t>(column - FIRST_PROPERTY_COLUMN);
+  if (i < nodeProperties_.size())
+  {
+    // Node properties are read from their column when possible:
+    const PropertyStore& store = document_->getPropertyStore();
+    if (!store.hasColumn(nodeProperties_[i]))
+      return QVariant();
+    const PropertyColumn& values = store.getColumn(nodeProperties_[i]);
+    int id = node->getId();
+    if (!values.hasValue(id))
+      return QVariant();
+    if (values.getType() == PropertyColumn::STRING)
+      return QtTools::toQt(values.getText(id));
+    if (values.getType() == PropertyColumn::NUMBER)
+      return values.getNumber(id);
+    return toVariant_(node->getNodeProperty(nodeProperties_[i]));
+  }
+  i -= nodeProperties_.size();
+  return node->hasBranchProperty(branchProperties_[i]) ? toVariant_(node->getBranchProperty(branchProperties_[i])) : QVariant();
+}
+
+QVariant NodeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+  if (role != Qt::DisplayRole)
+    return QVariant();
+  if (orientation == Qt::Vertical)
+    return section + 1;
+  if (section == ID_COLUMN)
+    return tr("Id");
+  if (section == NAME_COLUMN)
+    return tr("Name");
+  if (section == LENGTH_COLUMN)
+    return tr("Branch length");
+  size_t i = static_cast<size_t>(section - FIRST_PROPERTY_COLUMN);
+  if (i < nodeProperties_.size())
+    return QtTools::toQt(nodeProperties_[i]);
+  i -= nodeProperties_.size();
+  if (i < branchProperties_.size())
+    return QtTools::toQt(branchProperties_[i]);
+  return QVariant();
+}
+
+Qt::ItemFlags NodeTableModel::flags(const QModelIndex& index) const
+{
+  Qt::ItemFlags flags = QAbstractTableModel::flags(index);
+  // Branch properties are read only:
+  if (index.isValid() && (index.column() == NAME_COLUMN || index.column() == LENGTH_COLUMN || isNodePropertyColumn(index.column())))
+    flags |= Qt::ItemIsEditable;
+  return flags;
+}
+
+bool NodeTableModel::setData(const QModelIndex& index, const QVariant& value, int role)
+{
+  if (!index.isValid() || role != Qt::EditRole || !(flags(index) & Qt::ItemIsEditable))
+    return false;
+  // The tree is modified by a command, which will refresh the views:
+  emit nodeEdited(getNodeId(index.row()), index.column(), value.toString());
+  return true;
+}
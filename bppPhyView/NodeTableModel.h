@@ -0,0 +1,85 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _NODETABLEMODEL_H_
+#define _NODETABLEMODEL_H_
+
+#include "TreeDocument.h"
+
+// From Qt:
+#include <QAbstractTableModel>
+
+// From the STL:
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief A table model showing the nodes of a document, one per row.
+ *
+ * Columns are the node id, name, branch length, then all node and branch properties.
+ * Cells are computed on request from the tree of the document, so that only the
+ * visible ones are ever built. Edits are not applied directly but reported with
+ * the nodeEdited() signal, so that they can be turned into undoable commands.
+ */
+class NodeTableModel :
+  public QAbstractTableModel
+{
+  Q_OBJECT
+
+public:
+  static const int ID_COLUMN;
+  static const int NAME_COLUMN;
+  static const int LENGTH_COLUMN;
+  static const int FIRST_PROPERTY_COLUMN;
+
+private:
+  std::shared_ptr<TreeDocument> document_;
+  std::vector<Node*> nodes_;
+  std::unordered_map<int, int> rows_;
+  std::vector<std::string> nodeProperties_;
+  std::vector<std::string> branchProperties_;
+
+public:
+  NodeTableModel(std::shared_ptr<TreeDocument> document, QObject* parent = 0);
+
+  virtual ~NodeTableModel() {}
+
+public:
+  /**
+   * @brief Refresh the list of nodes and properties after the tree has changed.
+   */
+  void reset();
+
+  /**
+   * @brief Refresh only the rows affected by a change.
+   *
+   * The model is reset if the change alters the topology or the set of property columns.
+   */
+  void update(const TreeChange& change);
+
+  int getNodeId(int row) const { return nodes_[static_cast<size_t>(row)]->getId(); }
+
+  bool isNodePropertyColumn(int column) const
+  {
+    return column >= FIRST_PROPERTY_COLUMN && column < FIRST_PROPERTY_COLUMN + static_cast<int>(nodeProperties_.size());
+  }
+
+  int rowCount(const QModelIndex& parent = QModelIndex()) const;
+  int columnCount(const QModelIndex& parent = QModelIndex()) const;
+  QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+  QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+  Qt::ItemFlags flags(const QModelIndex& index) const;
+  bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole);
+
+signals:
+  void nodeEdited(int nodeId, int column, const QString& value);
+
+private:
+  bool hasColumn_(const std::string& property) const;
+
+  static QVariant toVariant_(const Clonable* property);
+};
+
+#endif // _NODETABLEMODEL_H_
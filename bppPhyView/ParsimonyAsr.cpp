@@ -0,0 +1,321 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "ParsimonyAsr.h"
+#include "ValuePool.h"
+
+#include <Bpp/Exceptions.h>
+#include <Bpp/Text/TextTools.h>
+
+// From the STL:
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+using namespace std;
+
+ParsimonyAsr::ParsimonyAsr(const Node& root) :
+  nodes_(),
+  sonsOffsets_(),
+  sons_()
+{
+  // Pre-order without recursion, which would overflow the stack on deep trees:
+  vector<size_t> fathers;
+  vector< pair<const Node*, size_t> > stack(1, make_pair(&root, static_cast<size_t>(0)));
+  while (!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    fathers.push_back(stack.back().second);
+    stack.pop_back();
+    size_t index = nodes_.size();
+    nodes_.push_back(node);
+    for (size_t i = node->getNumberOfSons(); i > 0; --i)
+    {
+      stack.push_back(make_pair(node->getSon(i - 1), index));
+    }
+  }
+
+  // Sons are grouped by father, in pre-order:
+  size_t n = nodes_.size();
+  sonsOffsets_.assign(n + 1, 0);
+  for (size_t i = 1; i < n; ++i)
+  {
+    ++sonsOffsets_[fathers[i] + 1];
+  }
+  for (size_t i = 0; i < n; ++i)
+  {
+    sonsOffsets_[i + 1] += sonsOffsets_[i];
+  }
+  sons_.resize(n > 0 ? n - 1 : 0);
+  vector<size_t> next(sonsOffsets_.begin(), sonsOffsets_.end() - 1);
+  for (size_t i = 1; i < n; ++i)
+  {
+    sons_[next[fathers[i]]++] = i;
+  }
+}
+
+vector<int> ParsimonyAsr::encode(const string& property, vector<string>& alphabet) const
+{
+  unordered_map<string, int> codes;
+  for (size_t i = 0; i < alphabet.size(); ++i)
+  {
+    codes[alphabet[i]] = static_cast<int>(i);
+  }
+  vector<int> observed(nodes_.size(), -1);
+  for (size_t i = 0; i < nodes_.size(); ++i)
+  {
+    if (!nodes_[i]->hasNodeProperty(property))
+      continue;
+    const string* value = SharedString::getText(nodes_[i]->getNodeProperty(property));
+    if (!value || value->empty())
+      continue;
+    auto it = codes.find(*value);
+    if (it == codes.end())
+    {
+      it = codes.insert(make_pair(*value, static_cast<int>(alphabet.size()))).first;
+      alphabet.push_back(*value);
+    }
+    observed[i] = it->second;
+  }
+  return observed;
+}
+
+vector<int> ParsimonyAsr::encode(const PropertyColumn& column, vector<string>& alphabet) const
+{
+  if (column.getType() != PropertyColumn::STRING)
+    throw Exception("ParsimonyAsr::encode. Not a string property.");
+  const vector<string>& texts = column.getTexts();
+  // -2 for texts not seen yet, -1 for empty ones. Texts no longer used must not enter the alphabet.
+  vector<int> translation(texts.size(), -2);
+  unordered_map<string, int> codes;
+  for (size_t i = 0; i < alphabet.size(); ++i)
+  {
+    codes[alphabet[i]] = static_cast<int>(i);
+  }
+  vector<int> observed(nodes_.size(), -1);
+  for (size_t i = 0; i < nodes_.size(); ++i)
+  {
+    int32_t code = column.getCode(nodes_[i]->getId());
+    if (code < 0)
+      continue;
+    int& state = translation[static_cast<size_t>(code)];
+    if (state == -2)
+    {
+      const string& text = texts[static_cast<size_t>(code)];
+      if (text.empty())
+        state = -1;
+      else
+      {
+        auto it = codes.insert(make_pair(text, static_cast<int>(alphabet.size()))).first;
+        if (it->second == static_cast<int>(alphabet.size()))
+          alphabet.push_back(text);
+        state = it->second;
+      }
+    }
+    observed[i] = state;
+  }
+  return observed;
+}
+
+unsigned int ParsimonyAsr::fitch(const vector<int>& observed, size_t numberOfStates, vector<int>& states) const
+{
+  size_t n = nodes_.size();
+  states.assign(n, -1);
+  if (numberOfStates == 0 || n == 0)
+    return 0;
+  size_t w = (numberOfStates + 63) / 64;
+  vector<uint64_t> sets(n * w, 0);
+  vector<uint64_t> all(w, ~static_cast<uint64_t>(0));
+  if (numberOfStates % 64 != 0)
+    all[w - 1] = (static_cast<uint64_t>(1) << (numberOfStates % 64)) - 1;
+  vector<unsigned int> counts;
+  unsigned int score = 0;
+
+  // First pass, sons before their father:
+  for (size_t i = n; i > 0; --i)
+  {
+    size_t k = i - 1;
+    uint64_t* set = &sets[k * w];
+    size_t first = sonsOffsets_[k], last = sonsOffsets_[k + 1];
+    if (observed[k] >= 0)
+    {
+      set[observed[k] / 64] = static_cast<uint64_t>(1) << (observed[k] % 64);
+      for (size_t s = first; s < last; ++s)
+      {
+        if (!hasState_(&sets[sons_[s] * w], observed[k]))
+          ++score;
+      }
+    }
+    else if (first == last)
+    {
+      copy(all.begin(), all.end(), set);
+    }
+    else if (last - first == 2)
+    {
+      const uint64_t* a = &sets[sons_[first] * w];
+      const uint64_t* b = &sets[sons_[first + 1] * w];
+      uint64_t any = 0;
+      for (size_t j = 0; j < w; ++j)
+      {
+        set[j] = a[j] & b[j];
+        any |= set[j];
+      }
+      if (!any)
+      {
+        for (size_t j = 0; j < w; ++j)
+        {
+          set[j] = a[j] | b[j];
+        }
+        ++score;
+      }
+    }
+    else
+    {
+      // Keep the states found in most sons:
+      counts.assign(numberOfStates, 0);
+      for (size_t s = first; s < last; ++s)
+      {
+        const uint64_t* sonSet = &sets[sons_[s] * w];
+        for (size_t x = 0; x < numberOfStates; ++x)
+        {
+          counts[x] += hasState_(sonSet, static_cast<int>(x));
+        }
+      }
+      unsigned int max = *max_element(counts.begin(), counts.end());
+      for (size_t x = 0; x < numberOfStates; ++x)
+      {
+        if (counts[x] == max)
+          set[x / 64] |= static_cast<uint64_t>(1) << (x % 64);
+      }
+      score += static_cast<unsigned int>(last - first) - max;
+    }
+  }
+
+  // Second pass, fathers before their sons: keep the state of the father when possible.
+  states[0] = firstState_(&sets[0], w);
+  for (size_t k = 0; k < n; ++k)
+  {
+    for (size_t s = sonsOffsets_[k]; s < sonsOffsets_[k + 1]; ++s)
+    {
+      size_t son = sons_[s];
+      const uint64_t* set = &sets[son * w];
+      states[son] = hasState_(set, states[k]) ? states[k] : firstState_(set, w);
+    }
+  }
+  return score;
+}
+
+double ParsimonyAsr::sankoff(const vector<int>& observed, const vector<double>& costs, vector<int>& states) const
+{
+  size_t n = nodes_.size();
+  size_t m = static_cast<size_t>(sqrt(static_cast<double>(costs.size())) + 0.5);
+  if (m * m != costs.size())
+    throw Exception("ParsimonyAsr::sankoff. The cost matrix is not square.");
+  states.assign(n, -1);
+  if (m == 0 || n == 0)
+    return 0.;
+  const double inf = numeric_limits<double>::infinity();
+  vector<double> scores(n * m, 0.);
+
+  // First pass, sons before their father:
+  for (size_t i = n; i > 0; --i)
+  {
+    size_t k = i - 1;
+    double* score = &scores[k * m];
+    for (size_t s = sonsOffsets_[k]; s < sonsOffsets_[k + 1]; ++s)
+    {
+      const double* sonScore = &scores[sons_[s] * m];
+      int state = observed[sons_[s]];
+      for (size_t x = 0; x < m; ++x)
+      {
+        const double* row = &costs[x * m];
+        // Only the observed state of a son has a finite score:
+        if (state >= 0 && static_cast<size_t>(state) < m)
+        {
+          score[x] += row[state] + sonScore[state];
+          continue;
+        }
+        double best = inf;
+        for (size_t y = 0; y < m; ++y)
+        {
+          best = min(best, row[y] + sonScore[y]);
+        }
+        score[x] += best;
+      }
+    }
+    if (observed[k] >= 0)
+    {
+      if (static_cast<size_t>(observed[k]) >= m)
+        throw Exception("ParsimonyAsr::sankoff. A state is missing from the cost matrix.");
+      for (size_t x = 0; x < m; ++x)
+      {
+        if (x != static_cast<size_t>(observed[k]))
+          score[x] = inf;
+      }
+    }
+  }
+
+  // Second pass, fathers before their sons:
+  states[0] = static_cast<int>(min_element(scores.begin(), scores.begin() + static_cast<ptrdiff_t>(m)) - scores.begin());
+  double total = scores[static_cast<size_t>(states[0])];
+  for (size_t k = 0; k < n; ++k)
+  {
+    const double* row = &costs[static_cast<size_t>(states[k]) * m];
+    for (size_t s = sonsOffsets_[k]; s < sonsOffsets_[k + 1]; ++s)
+    {
+      size_t son = sons_[s];
+      const double* sonScore = &scores[son * m];
+      size_t best = 0;
+      for (size_t y = 1; y < m; ++y)
+      {
+        if (row[y] + sonScore[y] < row[best] + sonScore[best])
+          best = y;
+      }
+      states[son] = static_cast<int>(best);
+    }
+  }
+  return total;
+}
+
+void ParsimonyAsr::readCostMatrix(const DataTable& table, vector<string>& alphabet, vector<double>& costs)
+{
+  size_t m = table.getNumberOfColumns();
+  if (table.getNumberOfRows() != m)
+    throw Exception("ParsimonyAsr::readCostMatrix. The cost matrix is not square.");
+  alphabet = table.getColumnNames();
+  for (size_t i = 0; i < m; ++i)
+  {
+    if (table.getRowName(i) != alphabet[i])
+      throw Exception("ParsimonyAsr::readCostMatrix. Row " + table.getRowName(i) + " does not match column " + alphabet[i] + ".");
+  }
+  costs.resize(m * m);
+  for (size_t i = 0; i < m; ++i)
+  {
+    for (size_t j = 0; j < m; ++j)
+    {
+      const string& value = table(i, j);
+      if (!TextTools::isDecimalNumber(value))
+        throw Exception("ParsimonyAsr::readCostMatrix. Invalid cost: " + value + ".");
+      costs[i * m + j] = TextTools::toDouble(value);
+    }
+  }
+}
+
+int ParsimonyAsr::firstState_(const uint64_t* set, size_t numberOfWords)
+{
+  for (size_t j = 0; j < numberOfWords; ++j)
+  {
+    if (set[j])
+    {
+      int x = 0;
+      while (!((set[j] >> x) & 1))
+      {
+        ++x;
+      }
+      return static_cast<int>(j * 64) + x;
+    }
+  }
+  return -1;
+}
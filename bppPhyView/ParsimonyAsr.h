@@ -0,0 +1,113 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _PARSIMONYASR_H_
+#define _PARSIMONYASR_H_
+
+#include "PropertyStore.h"
+
+// From bpp-core:
+#include <Bpp/Numeric/DataTable.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+
+// From the STL:
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief Maximum parsimony reconstruction of ancestral states of categorical node properties.
+ *
+ * The tree is flattened once into arrays, in pre-order, so that both passes of the
+ * algorithms are plain loops, forward or backward. States are coded as integers:
+ * Fitch's algorithm stores state sets as bitsets of 64-bit words, Sankoff's algorithm
+ * stores one cost per node and state.
+ *
+ * Once constructed, an instance is only read, so several variables may be reconstructed
+ * in parallel as long as the tree is not modified.
+ */
+class ParsimonyAsr
+{
+private:
+  std::vector<const Node*> nodes_;
+  // Sons of node i are sons_[sonsOffsets_[i]] to sons_[sonsOffsets_[i + 1] - 1]:
+  std::vector<size_t> sonsOffsets_;
+  std::vector<size_t> sons_;
+
+public:
+  explicit ParsimonyAsr(const Node& root);
+
+public:
+  size_t getNumberOfNodes() const { return nodes_.size(); }
+
+  /**
+   * @return The ith node in pre-order. The root is node 0.
+   */
+  const Node& getNode(size_t i) const { return *nodes_[i]; }
+
+  bool isLeaf(size_t i) const { return sonsOffsets_[i] == sonsOffsets_[i + 1]; }
+
+  /**
+   * @brief Code the values of a string node property as integers.
+   *
+   * @param property The property to read.
+   * @param alphabet The states, in the order of their codes. States not already
+   * in the alphabet are appended to it.
+   * @return The code of the state of each node, -1 if it has no value.
+   */
+  std::vector<int> encode(const std::string& property, std::vector<std::string>& alphabet) const;
+
+  /**
+   * @brief Code the values of a string property from its column, translating each distinct value once.
+   */
+  std::vector<int> encode(const PropertyColumn& column, std::vector<std::string>& alphabet) const;
+
+  /**
+   * @brief Fitch's algorithm (Hartigan's generalization for multifurcations).
+   *
+   * Nodes with an observed state keep it, whether they are leaves or not.
+   *
+   * @param observed The code of each node state, -1 if missing.
+   * @param numberOfStates The size of the alphabet.
+   * @param states [out] The reconstructed state of each node.
+   * @return The parsimony score.
+   */
+  unsigned int fitch(const std::vector<int>& observed, size_t numberOfStates, std::vector<int>& states) const;
+
+  /**
+   * @brief Sankoff's algorithm, with arbitrary transition costs.
+   *
+   * @param observed The code of each node state, -1 if missing.
+   * @param costs The cost matrix, row by row: costs[i * n + j] is the cost of a change from state i to state j.
+   * @param states [out] The reconstructed state of each node.
+   * @return The parsimony score.
+   */
+  double sankoff(const std::vector<int>& observed, const std::vector<double>& costs, std::vector<int>& states) const;
+
+  /**
+   * @brief Read a cost matrix for Sankoff's algorithm.
+   *
+   * Rows and columns must be named with the states, in the same order.
+   *
+   * @param table The matrix.
+   * @param alphabet [out] The states.
+   * @param costs [out] The costs, row by row.
+   * @throw Exception If the matrix is not square, rows and columns differ, or a cost is not a number.
+   */
+  static void readCostMatrix(const DataTable& table, std::vector<std::string>& alphabet, std::vector<double>& costs);
+
+private:
+  static int firstState_(const uint64_t* set, size_t numberOfWords);
+
+  static bool hasState_(const uint64_t* set, int state)
+  {
+    return (set[state / 64] >> (state % 64)) & 1;
+  }
+};
+
+#endif // _PARSIMONYASR_H_
@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "PerformancePanel.h"
+#include "Profiler.h"
+
+// From Qt:
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QVBoxLayout>
+
+// From the STL:
+#include <exception>
+
+using namespace std;
+
+PerformancePanel::PerformancePanel(QWidget* parent) :
+  QWidget(parent),
+  records_(new QTableWidget(0, 4)),
+  memory_(new QLabel()),
+  clear_(new QPushButton(tr("Clear"))),
+  export_(new QPushButton(tr("Export trace..."))),
+  timer_(),
+  revision_(0)
+{
+  records_->setHorizontalHeaderLabels(QStringList() << tr("Operation") << tr("Type") << tr("Time (ms)") << tr("Memory (MB)"));
+  records_->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+  records_->verticalHeader()->setVisible(false);
+  records_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  records_->setSelectionBehavior(QAbstractItemView::SelectRows);
+  connect(clear_, &QPushButton::clicked, this, &PerformancePanel::clearRecords);
+  connect(export_, &QPushButton::clicked, this, &PerformancePanel::exportTrace);
+  connect(&timer_, &QTimer::timeout, this, &PerformancePanel::refresh);
+
+  QHBoxLayout* buttons = new QHBoxLayout;
+  buttons->addWidget(memory_);
+  buttons->addStretch();
+  buttons->addWidget(clear_);
+  buttons->addWidget(export_);
+  QVBoxLayout* layout = new QVBoxLayout;
+  layout->addWidget(records_);
+  layout->addLayout(buttons);
+  setLayout(layout);
+}
+
+void PerformancePanel::showEvent(QShowEvent* event)
+{
+  QWidget::showEvent(event);
+  refresh();
+  timer_.start(500);
+}
+
+void PerformancePanel::hideEvent(QHideEvent* event)
+{
+  QWidget::hideEvent(event);
+  timer_.stop();
+}
+
+void PerformancePanel::refresh()
+{
+  memory_->setText(tr("Resident memory: %1 MB").arg(static_cast<double>(Profiler::getMemoryUsage()) / 1048576., 0, 'f', 1));
+  unsigned long revision = Profiler::instance().getRevision();
+  if (revision == revision_)
+    return;
+  revision_ = revision;
+  vector<Profiler::Record> records = Profiler::instance().getRecentRecords();
+  records_->setRowCount(static_cast<int>(records.size()));
+  for (size_t i = 0; i < records.size(); ++i)
+  {
+    const Profiler::Record& record = records[records.size() - 1 - i];
+    int row = static_cast<int>(i);
+    records_->setItem(row, 0, new QTableWidgetItem(QString::fromStdString(record.name)));
+    records_->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(record.category)));
+    QTableWidgetItem* time = new QTableWidgetItem(QString::number(static_cast<double>(record.duration) / 1000., 'f', 1));
+    time->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    records_->setItem(row, 2, time);
+    QTableWidgetItem* memory = new QTableWidgetItem(QString::number(static_cast<double>(record.memoryDelta) / 1048576., 'f', 1));
+    memory->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    records_->setItem(row, 3, memory);
+  }
+}
+
+void PerformancePanel::clearRecords()
+{
+  Profiler::instance().clear();
+  refresh();
+}
+
+void PerformancePanel::exportTrace()
+{
+  QString path = QFileDialog::getSaveFileName(this, tr("Export trace"), QString(), tr("Chrome trace files (*.json)"));
+  if (path.isEmpty())
+    return;
+  try
+  {
+    Profiler::instance().writeTrace(path.toStdString());
+  }
+  catch (exception& e)
+  {
+    QMessageBox::critical(this, tr("Ouch..."), tr("Error when writing trace:\n") + tr(e.what()));
+  }
+}
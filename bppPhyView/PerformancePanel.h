@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _PERFORMANCEPANEL_H_
+#define _PERFORMANCEPANEL_H_
+
+// From Qt:
+#include <QLabel>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QWidget>
+
+/**
+ * @brief Shows the most recent operations timed by the profiler, newest first.
+ *
+ * The list is refreshed twice a second while the panel is visible.
+ */
+class PerformancePanel :
+  public QWidget
+{
+  Q_OBJECT
+
+private:
+  QTableWidget* records_;
+  QLabel* memory_;
+  QPushButton* clear_;
+  QPushButton* export_;
+  QTimer timer_;
+  unsigned long revision_;
+
+public:
+  PerformancePanel(QWidget* parent = 0);
+
+protected:
+  void showEvent(QShowEvent* event);
+  void hideEvent(QHideEvent* event);
+
+private slots:
+  void refresh();
+  void clearRecords();
+  void exportTrace();
+};
+
+#endif // _PERFORMANCEPANEL_H_
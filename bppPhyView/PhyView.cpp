@@ -5,6 +5,12 @@
 #include "PhyView.h"
 #include "TreeSubWindow.h"
 #include "TreeDocument.h"
+#include "PngWriter.h"
+#include "ParsimonyAsr.h"
+#include "BinaryTreeFormat.h"
+#include "CompressedStream.h"
+#include "Profiler.h"
+#include "TreeTraversal.h"
 
 #include <QApplication>
 #include <QtGui>
@@ -20,6 +26,9 @@
 #include <QMenuBar>
 #include <QInputDialog>
 #include <QGraphicsTextItem>
+#include <QStatusBar>
+#include <QLabel>
+#include <QProgressDialog>
 
 #include <Bpp/Qt/QtGraphicDevice.h>
 
@@ -29,7 +38,10 @@
 #include <Bpp/Phyl/Io/Nhx.h>
 #include <Bpp/Phyl/Graphics/PhylogramPlot.h>
 
-#include <fstream>
+#include <algorithm>
+#include <future>
+#include <cstdint>
+#include <unordered_map>
 
 using namespace std;
 using namespace bpp;
@@ -52,8 +64,8 @@ MouseActionListener::MouseActionListener(PhyView* phyview) :
 TranslateNameChooser::TranslateNameChooser(PhyView* phyview) :
   QDialog(phyview), phyview_(phyview), fileDialog_(new QFileDialog(this))
 {
-  fileFilters_ << "Coma separated columns (*.txt *.csv)"
-               << "Tab separated columns (*.txt *.csv)";
+  fileFilters_ << "Coma separated columns (*.txt *.csv *.txt.gz *.csv.gz)"
+               << "Tab separated columns (*.txt *.csv *.txt.gz *.csv.gz)";
   fileDialog_->setNameFilters(fileFilters_);
   fileDialog_->setOptions(QFileDialog::DontUseNativeDialog);
   hasHeader_ = new QCheckBox(tr("File has header line"));
@@ -81,9 +93,9 @@ void TranslateNameChooser::translateTree(TreeTemplate<Node>& tree)
     string sep = ",";
     if (fileDialog_->selectedNameFilter() == fileFilters_[1])
       sep = "\t";
-    ifstream file(path[0].toStdString().c_str(), ios::in);
     try
     {
+      CompressedInputFile file(path[0].toStdString());
       auto table = DataTable::read(file, sep, hasHeader_->isChecked());
 
       // Clean button groups:
@@ -137,8 +149,7 @@ NamesFromDataDialog::NamesFromDataDialog(PhyView* phyview) :
 void NamesFromDataDialog::setNamesFromData()
 {
   variableCol_->clear();
-  vector<string> names;
-  TreeTemplateTools::getNodePropertyNames(phyview_->getActiveDocument()->tree().rootNode(), names);
+  vector<string> names = phyview_->getActiveDocument()->getPropertyStore().getColumnNames();
   if (names.size() == 0) {
     QMessageBox::critical(this, tr("No data available"), tr("Associate data to the tree\nto enable node (re)naming."));
     return;
@@ -185,20 +196,48 @@ void DataLoader::load(const DataTable& data)
   if (exec() == QDialog::Accepted)
   {
     unsigned int index = static_cast<unsigned int>(indexCol_->currentIndex());
-    phyview_->submitCommand(new AttachDataCommand(phyview_->getActiveDocument(), data, index, nameIndex_->isChecked()));
+    AttachDataCommand* cmd = new AttachDataCommand(phyview_->getActiveDocument(), data, index, nameIndex_->isChecked());
+    QString report;
+    if (cmd->getUnmatchedKeys().size() > 0)
+      report += tr("%1 key(s) do not match any node: ").arg(cmd->getUnmatchedKeys().size()) + summarizeKeys_(cmd->getUnmatchedKeys()) + "\n";
+    if (cmd->getDuplicatedKeys().size() > 0)
+      report += tr("%1 key(s) are duplicated, the last row was used: ").arg(cmd->getDuplicatedKeys().size()) + summarizeKeys_(cmd->getDuplicatedKeys()) + "\n";
+    phyview_->submitCommand(cmd);
+    if (!report.isEmpty())
+      QMessageBox::warning(this, tr("Data attached with warnings"), report);
   }
 }
 
+QString DataLoader::summarizeKeys_(const vector<string>& keys, size_t max)
+{
+  QStringList lst;
+  for (size_t i = 0; i < keys.size() && i < max; ++i)
+  {
+    lst.append(QtTools::toQt(keys[i]));
+  }
+  QString text = lst.join(", ");
+  if (keys.size() > max)
+    text += ", ...";
+  return text;
+}
+
 AsrDialog::AsrDialog(PhyView* phyview) :
   QDialog(phyview), phyview_(phyview)
 {
   QFormLayout* layout = new QFormLayout;
-  variableCol_ = new QComboBox;
+  // Several variables can be reconstructed at once:
+  variables_   = new QListWidget;
+  variables_->setSelectionMode(QAbstractItemView::ExtendedSelection);
+  selectAll_   = new QPushButton(tr("Select all"));
+  connect(selectAll_, &QPushButton::clicked, variables_, &QListWidget::selectAll);
   asrMethod_   = new QComboBox;
   asrMethod_->addItem(QString("Naive ASR"));
+  asrMethod_->addItem(QString("Fitch parsimony"));
+  asrMethod_->addItem(QString("Sankoff parsimony (cost matrix)"));
   ok_          = new QPushButton(tr("Ok"));
   cancel_      = new QPushButton(tr("Cancel"));
-  layout->addRow(tr("Variable"), variableCol_);
+  layout->addRow(tr("Variables"), variables_);
+  layout->addRow(QString(), selectAll_);
   layout->addRow(tr("Method"), asrMethod_);
   layout->addRow(cancel_, ok_);
   connect(ok_, &QPushButton::clicked, this, &AsrDialog::accept);
@@ -208,24 +247,51 @@ AsrDialog::AsrDialog(PhyView* phyview) :
 
 void AsrDialog::asr()
 {
-  variableCol_->clear();
-  vector<string> names;
-  TreeTemplateTools::getNodePropertyNames(phyview_->getActiveDocument()->tree().rootNode(), names);
+  variables_->clear();
+  vector<string> names = phyview_->getActiveDocument()->getPropertyStore().getColumnNames();
   if (names.size() == 0) {
-    QMessageBox::critical(this, tr("No data available"), tr("Associate data to the tree\nto enable automatic collapsing of nodes."));
+    QMessageBox::critical(this, tr("No data available"), tr("Associate data to the tree\nto enable ancestral state reconstruction."));
     return;
   }
   for (const auto& name : names)
   {
-    variableCol_->addItem(QtTools::toQt(name));
+    variables_->addItem(QtTools::toQt(name));
   }
+  variables_->setCurrentRow(0);
   if (exec() == QDialog::Accepted)
   {
-    auto propertyName = variableCol_->currentText().toStdString();
-    TreeCanvas& tc = phyview_->getActiveSubWindow()->treeCanvas();
-    auto x = dynamic_cast<const TreeTemplate<Node>&>(tc.tree());
-    //So far, only the naive ASR is supported.
-    phyview_->submitCommand(new NaiveAsrCommand(phyview_->getActiveDocument(), propertyName));
+    vector<string> propertyNames;
+    for (int i = 0; i < variables_->count(); ++i)
+    {
+      if (variables_->item(i)->isSelected())
+        propertyNames.push_back(variables_->item(i)->text().toStdString());
+    }
+    if (propertyNames.empty())
+      return;
+    try
+    {
+      if (asrMethod_->currentIndex() == 0)
+        phyview_->submitCommand(new NaiveAsrCommand(phyview_->getActiveDocument(), propertyNames));
+      else if (asrMethod_->currentIndex() == 1)
+        phyview_->submitCommand(new ParsimonyAsrCommand(phyview_->getActiveDocument(), propertyNames));
+      else
+      {
+        // The matrix has states as row and column names:
+        QString path = QFileDialog::getOpenFileName(this, tr("Cost matrix"), QString(), tr("Comma separated values (*.csv *.txt)"));
+        if (path.isEmpty())
+          return;
+        CompressedInputFile file(path.toStdString());
+        auto table = DataTable::read(file, ",", true, 0);
+        vector<string> alphabet;
+        vector<double> costs;
+        ParsimonyAsr::readCostMatrix(*table, alphabet, costs);
+        phyview_->submitCommand(new ParsimonyAsrCommand(phyview_->getActiveDocument(), propertyNames, alphabet, costs));
+      }
+    }
+    catch (exception& e)
+    {
+      QMessageBox::critical(this, tr("Ancestral state reconstruction failed"), QtTools::toQt(e.what()));
+    }
   }
 }
 
@@ -241,13 +307,14 @@ ImageExportDialog::ImageExportDialog(PhyView* phyview) :
   connect(browse_, &QPushButton::clicked, this, &ImageExportDialog::chosePath);
   layout->addWidget(browse_, 1, 2);
 
+  // Large sizes are only practical in PNG, which is written band by band:
   height_ = new QSpinBox;
-  height_->setRange(100, 10000);
+  height_->setRange(100, 100000);
   layout->addWidget(new QLabel(tr("Height:")), 2, 1);
   layout->addWidget(height_, 2, 2);
 
   width_ = new QSpinBox;
-  width_->setRange(100, 10000);
+  width_->setRange(100, 100000);
   layout->addWidget(new QLabel(tr("Width:")), 3, 1);
   layout->addWidget(width_, 3, 2);
 
@@ -288,12 +355,16 @@ void ImageExportDialog::chosePath()
   }
 }
 
+const int ImageExportDialog::MAX_BAND_SIZE = 16 << 20;
+
 void ImageExportDialog::process(QGraphicsScene* scene)
 {
   if (ok_->isEnabled())
   {
+    ProfileProbe probe("Export image", "io");
     QStringList path = imageFileDialog_->selectedFiles();
     int i = imageFileFilters_.indexOf(imageFileDialog_->selectedNameFilter());
+    QByteArray imageFormat = QImageWriter::supportedImageFormats()[i];
     // Chose the correct format according to options:
     QImage::Format format = QImage::Format_RGB32;
     QBrush bckBrush = scene->backgroundBrush();
@@ -307,16 +378,48 @@ void ImageExportDialog::process(QGraphicsScene* scene)
       if (bckBrush == Qt::NoBrush)
         scene->setBackgroundBrush(Qt::white);
     }
-    QImage image(width_->value(), height_->value(), format);
-    QPainter painter;
-    painter.begin(&image);
-    if (keepAspectRatio_->isChecked())
-      scene->render(&painter);
+    if (imageFormat.toLower() == "png")
+    {
+      int height = height_->value();
+      QProgressDialog progress(tr("Exporting image..."), tr("Cancel"), 0, height, this);
+      progress.setWindowModality(Qt::WindowModal);
+      progress.setMinimumDuration(500);
+      bool completed = false;
+      try
+      {
+        completed = renderToPng(scene, path[0], width_->value(), height, transparent_->isChecked(), keepAspectRatio_->isChecked(),
+            [&progress](int rows) {
+              progress.setValue(rows);
+              return !progress.wasCanceled();
+            });
+      }
+      catch (...)
+      {
+        scene->setBackgroundBrush(bckBrush);
+        QFile::remove(path[0]);
+        throw;
+      }
+      if (!completed)
+        QFile::remove(path[0]);
+    }
     else
-      scene->render(&painter, QRectF(), QRectF(), Qt::IgnoreAspectRatio);
-    painter.end();
+    {
+      QImage image(width_->value(), height_->value(), format);
+      if (image.isNull())
+      {
+        scene->setBackgroundBrush(bckBrush);
+        throw Exception("Image is too large to be exported in this format, use PNG instead.");
+      }
+      QPainter painter;
+      painter.begin(&image);
+      if (keepAspectRatio_->isChecked())
+        scene->render(&painter);
+      else
+        scene->render(&painter, QRectF(), QRectF(), Qt::IgnoreAspectRatio);
+      painter.end();
+      image.save(path[0], imageFormat);
+    }
     scene->setBackgroundBrush(bckBrush);
-    image.save(path[0], QImageWriter::supportedImageFormats()[i]);
   }
   else
   {
@@ -324,6 +427,61 @@ void ImageExportDialog::process(QGraphicsScene* scene)
   }
 }
 
+bool ImageExportDialog::renderToPng(
+    QGraphicsScene* scene,
+    const QString& path,
+    int width,
+    int height,
+    bool transparent,
+    bool keepAspectRatio,
+    const std::function<bool (int)>& progress)
+{
+  // Where the scene lands in the image, as QGraphicsScene::render places it:
+  QRectF source = scene->sceneRect();
+  QRectF target(0, 0, width, height);
+  if (keepAspectRatio && !source.isEmpty())
+  {
+    QSizeF size = source.size().scaled(target.size(), Qt::KeepAspectRatio);
+    target = QRectF((width - size.width()) / 2., (height - size.height()) / 2., size.width(), size.height());
+  }
+  double xScale = source.width() > 0 ? target.width() / source.width() : 1.;
+  double yScale = source.height() > 0 ? target.height() / source.height() : 1.;
+
+  // Memory is bounded by the size of two bands, whatever the size of the image:
+  int bandHeight = max(1, min(height, MAX_BAND_SIZE / (4 * width)));
+  PngWriter writer(path.toStdString(), static_cast<unsigned int>(width), static_cast<unsigned int>(height), transparent);
+  // The scene can only be painted from this thread, so a band is compressed in the background while the next one is rendered:
+  future<void> pending;
+  for (int y = 0; y < height; y += bandHeight)
+  {
+    int rows = min(bandHeight, height - y);
+    QImage band(width, rows, transparent ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    band.fill(transparent ? Qt::transparent : Qt::white);
+    QRectF area = target.intersected(QRectF(0, y, width, rows));
+    if (!area.isEmpty())
+    {
+      QRectF from(
+          source.x() + (area.x() - target.x()) / xScale,
+          source.y() + (area.y() - target.y()) / yScale,
+          area.width() / xScale,
+          area.height() / yScale);
+      QPainter painter(&band);
+      scene->render(&painter, area.translated(0, -y), from, Qt::IgnoreAspectRatio);
+    }
+    if (pending.valid())
+      pending.get();
+    pending = async(launch::async, [&writer, band]() { writer.write(band); });
+    if (progress && !progress(y + rows))
+    {
+      pending.get();
+      return false;
+    }
+  }
+  pending.get();
+  writer.close();
+  return true;
+}
+
 
 TypeNumberDialog::TypeNumberDialog(PhyView* phyview, const string& what, unsigned int min, unsigned int max) :
   QDialog(phyview)
@@ -346,14 +504,16 @@ CollapseDialog::CollapseDialog(PhyView* phyview) :
   QDialog(phyview), phyview_(phyview)
 {
   QFormLayout* layout = new QFormLayout;
-  variableCol_     = new QComboBox;
+  // Clades may be collapsed on several variables at once:
+  variables_       = new QListWidget;
+  variables_->setSelectionMode(QAbstractItemView::ExtendedSelection);
   allowMissing_    = new QCheckBox(tr("Allow missing data"));
   missingDataText_ = new QLineEdit();
   missingDataText_->setEnabled(false);
   connect(allowMissing_, &QCheckBox::checkStateChanged, missingDataText_, [this](){ missingDataText_->setEnabled(!missingDataText_->isEnabled()); });
   ok_              = new QPushButton(tr("Ok"));
   cancel_          = new QPushButton(tr("Cancel"));
-  layout->addRow(tr("Variable"), variableCol_);
+  layout->addRow(tr("Variables"), variables_);
   layout->addRow(tr(""), allowMissing_);
   layout->addRow(tr("Missing data text:"), missingDataText_);
   layout->addRow(cancel_, ok_);
@@ -364,79 +524,115 @@ CollapseDialog::CollapseDialog(PhyView* phyview) :
 
 void CollapseDialog::collapse()
 {
-  variableCol_->clear();
-  vector<string> names;
-  TreeTemplateTools::getNodePropertyNames(phyview_->getActiveDocument()->tree().rootNode(), names);
+  variables_->clear();
+  vector<string> names = phyview_->getActiveDocument()->getPropertyStore().getColumnNames();
   if (names.size() == 0) {
     QMessageBox::critical(this, tr("No data available"), tr("Associate data to the tree\nto enable automatic collapsing of nodes."));
     return;
   }
   for (const auto& name : names)
   {
-    variableCol_->addItem(QtTools::toQt(name));
+    variables_->addItem(QtTools::toQt(name));
   }
+  variables_->setCurrentRow(0);
   if (exec() == QDialog::Accepted)
   {
-    string propertyName = variableCol_->currentText().toStdString();
+    vector<string> propertyNames;
+    for (int i = 0; i < variables_->count(); ++i)
+    {
+      if (variables_->item(i)->isSelected())
+        propertyNames.push_back(variables_->item(i)->text().toStdString());
+    }
+    if (propertyNames.empty())
+      return;
     bool allowMissingData = allowMissing_->isChecked();
     string naString = missingDataText_->text().toStdString();
     TreeCanvas& tc = phyview_->getActiveSubWindow()->treeCanvas();
-    bool isMonophyletic;
-    scan_(tc, dynamic_cast<const TreeTemplate<Node>&>(tc.tree()).rootNode(), propertyName, isMonophyletic, allowMissingData, naString);
+    auto ids = findMonophyleticNodes_(phyview_->getActiveDocument()->tree().rootNode(), propertyNames, allowMissingData, naString);
+    // All nodes are collapsed before the tree is drawn again:
+    auto& td = tc.treeDrawing();
+    for (auto id : ids)
+    {
+      td.collapseNode(id, true);
+    }
     tc.redraw();
   }
 }
 
-std::string CollapseDialog::scan_(
-    TreeCanvas& tc,
-    const Node& node,
-    const string& propertyName,
-    bool& isMonophyletic,
+vector<int> CollapseDialog::findMonophyleticNodes_(
+    const Node& root,
+    const vector<string>& propertyNames,
     bool allowMissingData,
     const string& naString)
 {
-  if (node.isLeaf()) {
-    isMonophyletic = false;
-    if (node.hasNodeProperty(propertyName)) {
-      string state = dynamic_cast<const BppString*>(node.getNodeProperty(propertyName))->toSTL();
-      if (state != naString) isMonophyletic = true;
-      return state;
-    } else {
-      return naString;
-    }
-  } else {
-    vector<string> states(node.getNumberOfSons());
-    //We first call the function recursively on all subtrees:
-    isMonophyletic = true;
-    for (size_t i = 0; i < node.getNumberOfSons(); ++i) {
-      bool test;
-      states[i] = scan_(tc, node.son(i), propertyName, test, allowMissingData, naString);
-      isMonophyletic = isMonophyletic && test;
+  // Nodes in pre-order, without recursion:
+  vector<const Node*> nodes;
+  vector<size_t> fathers;
+  vector< pair<const Node*, size_t> > stack(1, make_pair(&root, static_cast<size_t>(0)));
+  while (!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    fathers.push_back(stack.back().second);
+    stack.pop_back();
+    size_t index = nodes.size();
+    nodes.push_back(node);
+    for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+    {
+      stack.push_back(make_pair(node->getSon(i), index));
     }
-    string state;
-    bool first = true;
-    for (size_t i = 0; i < node.getNumberOfSons(); ++i) {
-      if (states[i] == naString) {
-	if (!allowMissingData) {
-          isMonophyletic = false;
-          return naString;
-	} // else check next subtree
-      } else {
-	if (first) {
-          state = states[i];
-	  first = false;
-	} else {
-          if (states[i] != state) {
-            isMonophyletic = false;
-	    return naString;
-	  }// same state, proceed
-	}
-      } 
+  }
+
+  // Leaf states are interned as integers. With several variables, each combination of the states of
+  // the first j + 1 variables gets its own code, numbered in the map of level j.
+  const int none = -2;     // No leaf with data below this node.
+  const int conflict = -1; // Leaves below this node have different states.
+  vector<int> states(nodes.size(), none);
+  vector< unordered_map<string, int> > codes(propertyNames.size());
+  vector< unordered_map<uint64_t, int> > combinations(propertyNames.size());
+  for (size_t k = 0; k < nodes.size(); ++k)
+  {
+    const Node& node = *nodes[k];
+    if (!node.isLeaf())
+      continue;
+    int state = 0;
+    for (size_t j = 0; j < propertyNames.size() && state >= 0; ++j)
+    {
+      const string* value = node.hasNodeProperty(propertyNames[j]) ? SharedString::getText(node.getNodeProperty(propertyNames[j])) : 0;
+      if (!value || *value == naString)
+      {
+        state = allowMissingData ? none : conflict;
+        break;
+      }
+      int code = codes[j].insert(make_pair(*value, static_cast<int>(codes[j].size()))).first->second;
+      if (j == 0)
+        state = code;
+      else
+      {
+        uint64_t key = (static_cast<uint64_t>(state) << 32) | static_cast<uint32_t>(code);
+        state = combinations[j].insert(make_pair(key, static_cast<int>(combinations[j].size()))).first->second;
+      }
     }
-    if (isMonophyletic)
-      tc.collapseNode(node.getId(), true);
-    return state;  
+    states[k] = state;
+  }
+
+  // Sons come after their father in pre-order, so a backward pass sees all sons before their father:
+  vector<int> ids;
+  for (size_t k = nodes.size(); k > 1; --k)
+  {
+    size_t i = k - 1;
+    if (!nodes[i]->isLeaf() && states[i] >= 0)
+      ids.push_back(nodes[i]->getId());
+    int& father = states[fathers[i]];
+    if (states[i] == none)
+      continue;
+    if (father == none)
+      father = states[i];
+    else if (father != states[i])
+      father = conflict;
   }
+  if (!root.isLeaf() && states[0] >= 0)
+    ids.push_back(root.getId());
+  return ids;
 }
 
 
@@ -513,7 +709,7 @@ void MouseActionListener::mousePressEvent(QMouseEvent* event)
     else if (action == "Sample subtree")
     {
       Node* n = phyview_->getActiveDocument()->tree().getNode(nodeId);
-      TypeNumberDialog dial(phyview_, "Sample size", 1u, TreeTemplateTools::getNumberOfLeaves(*n));
+      TypeNumberDialog dial(phyview_, "Sample size", 1u, TreeTraversal::getNumberOfLeaves(*n));
       if (dial.exec() == QDialog::Accepted)
       {
         unsigned int size = dial.getValue();
@@ -526,23 +722,22 @@ void MouseActionListener::mousePressEvent(QMouseEvent* event)
     }
     else if (action == "Copy subtree")
     {
-      Node* subtree = TreeTemplateTools::cloneSubtree<Node>(*phyview_->getActiveDocument()->tree().getNode(nodeId));
-      unique_ptr< TreeTemplate<Node>> tt(new TreeTemplate<Node>(subtree));
-      phyview_->createNewDocument(tt.get());
+      Node* subtree = TreeTraversal::cloneSubtree(*phyview_->getActiveDocument()->tree().getNode(nodeId));
+      phyview_->createNewDocument(TreeTraversal::makeTree(subtree));
     }
     else if (action == "Cut subtree")
     {
-      Node* subtree = TreeTemplateTools::cloneSubtree<Node>(*phyview_->getActiveDocument()->tree().getNode(nodeId));
-      unique_ptr< TreeTemplate<Node>> tt(new TreeTemplate<Node>(subtree));
+      Node* subtree = TreeTraversal::cloneSubtree(*phyview_->getActiveDocument()->tree().getNode(nodeId));
+      auto tree = TreeTraversal::makeTree(subtree);
       phyview_->submitCommand(new DeleteSubtreeCommand(phyview_->getActiveDocument(), nodeId));
-      phyview_->createNewDocument(tt.get());
+      phyview_->createNewDocument(tree);
     }
     else if (action == "Insert on node")
     {
       auto tree = phyview_->pickTree();
       if (tree)
       {
-        Node* subtree = TreeTemplateTools::cloneSubtree<Node>(*tree->getRootNode());
+        Node* subtree = TreeTraversal::cloneSubtree(*tree->getRootNode());
         phyview_->submitCommand(new InsertSubtreeAtNodeCommand(phyview_->getActiveDocument(), nodeId, subtree));
       }
     }
@@ -551,13 +746,13 @@ void MouseActionListener::mousePressEvent(QMouseEvent* event)
       auto tree = phyview_->pickTree();
       if (tree)
       {
-        Node* subtree = TreeTemplateTools::cloneSubtree<Node>(*tree->getRootNode());
+        Node* subtree = TreeTraversal::cloneSubtree(*tree->getRootNode());
         phyview_->submitCommand(new InsertSubtreeOnBranchCommand(phyview_->getActiveDocument(), nodeId, subtree));
       }
     }
     else if (action == "Show associated data")
     {
-      phyview_->updateDataViewer(phyview_->getActiveDocument()->tree(), nodeId);
+      phyview_->updateDataViewer(phyview_->getActiveDocument(), nodeId);
     }
   }
 }
@@ -650,17 +845,26 @@ void PhyView::initGui_()
   addDockWidget(Qt::RightDockWidgetArea, dataViewerDockWidget_);
   dataViewerDockWidget_->setVisible(false);
 
+  // Performance panel:
+  performancePanel_ = new PerformancePanel();
+  performanceDockWidget_ = new QDockWidget(tr("Performance"));
+  performanceDockWidget_->setWidget(performancePanel_);
+  performanceDockWidget_->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea | Qt::BottomDockWidgetArea);
+  addDockWidget(Qt::BottomDockWidgetArea, performanceDockWidget_);
+  performanceDockWidget_->setVisible(false);
+
   // Other stuff...
   treeFileDialog_ = new QFileDialog(this, "Tree File");
-  treeFileFilters_ << "Newick files (*.dnd *.tre *.tree *.nwk *.newick *.phy *.txt)"
-                   << "Nexus files (*.nx *.nex *.nexus)"
-                   << "Nhx files (*.nhx)";
+  treeFileFilters_ << "Newick files (*.dnd *.tre *.tree *.nwk *.newick *.phy *.txt *.gz)"
+                   << "Nexus files (*.nx *.nex *.nexus *.gz)"
+                   << "Nhx files (*.nhx *.nhx.gz)"
+                   << "PhyView binary files (*.bpv)";
   treeFileDialog_->setNameFilters(treeFileFilters_);
   treeFileDialog_->setOption(QFileDialog::DontConfirmOverwrite, false);
 
   dataFileDialog_ = new QFileDialog(this, "Data File");
-  dataFileFilters_ << "Coma separated columns (*.txt *.csv)"
-                   << "Tab separated columns (*.txt *.csv)";
+  dataFileFilters_ << "Coma separated columns (*.txt *.csv *.txt.gz *.csv.gz)"
+                   << "Tab separated columns (*.txt *.csv *.txt.gz *.csv.gz)";
   dataFileDialog_->setNameFilters(dataFileFilters_);
 
   imageExportDialog_ = new ImageExportDialog(this);
@@ -677,6 +881,15 @@ void PhyView::initGui_()
   collapseDialog_ = new CollapseDialog(this);
   
   asrDialog_ = new AsrDialog(this);
+
+  treeLoader_ = new TreeLoader(this);
+  connect(treeLoader_, &TreeLoader::treeLoaded, this, &PhyView::treeLoaded);
+  connect(treeLoader_, &TreeLoader::multiTreeFileLoaded, this, &PhyView::multiTreeFileLoaded);
+  connect(treeLoader_, &TreeLoader::loadFailed, this, &PhyView::treeLoadFailed);
+
+  hibernationTimer_.setInterval(60 * 1000);
+  connect(&hibernationTimer_, &QTimer::timeout, this, &PhyView::hibernateIdleWindows);
+  hibernationTimer_.start();
 }
 
 void PhyView::createDisplayPanel_()
@@ -710,10 +923,14 @@ void PhyView::createDisplayPanel_()
   QVBoxLayout* collapseLayout = new QVBoxLayout;
   uncollapseAll_ = new QPushButton(tr("Uncollapse all"));
   autoCollapse_ = new QPushButton(tr("Auto collapse"));
+  levelOfDetail_ = new QCheckBox(tr("Collapse unreadable subtrees"));
+  levelOfDetail_->setChecked(true);
   collapseLayout->addWidget(uncollapseAll_);
   collapseLayout->addWidget(autoCollapse_);
+  collapseLayout->addWidget(levelOfDetail_);
   connect(uncollapseAll_, &QPushButton::clicked, this, &PhyView::uncollapseAll);
   connect(autoCollapse_, &QPushButton::clicked, this, &PhyView::autoCollapse);
+  connect(levelOfDetail_, &QCheckBox::toggled, this, &PhyView::setLevelOfDetail);
   collapseOptions->setLayout(collapseLayout);
 
   QVBoxLayout* layout = new QVBoxLayout;
@@ -745,7 +962,7 @@ void PhyView::createStatsPanel_()
 {
   statsPanel_ = new QWidget(this);
   QVBoxLayout* statsLayout = new QVBoxLayout;
-  statsBox_ = new TreeStatisticsBox;
+  statsBox_ = new TreeSummaryBox;
   statsLayout->addWidget(statsBox_);
   QPushButton* update = new QPushButton(tr("Update"));
   connect(update, &QPushButton::clicked, this, &PhyView::updateStatistics);
@@ -952,9 +1169,24 @@ void PhyView::createSearchPanel_()
   QVBoxLayout* searchLayout = new QVBoxLayout;
 
   searchText_ = new QLineEdit();
-  connect(searchText_, &QLineEdit::returnPressed, this, &PhyView::searchText);
+  searchText_->setClearButtonEnabled(true);
+  connect(searchText_, &QLineEdit::textChanged, this, &PhyView::searchText);
+  // The index is built when the search field is entered, rather than on the first keystroke:
+  connect(qApp, &QApplication::focusChanged, this, [this](QWidget* old, QWidget* now) {
+    if (now == searchText_)
+      prepareSearch();
+  });
   searchLayout->addWidget(searchText_);
 
+  // Same order as NameIndex::Mode:
+  searchMode_ = new QComboBox();
+  searchMode_->addItem(tr("Starts with"));
+  searchMode_->addItem(tr("Contains"));
+  searchMode_->addItem(tr("Regular expression"));
+  searchMode_->setCurrentIndex(1);
+  connect(searchMode_, &QComboBox::currentIndexChanged, this, &PhyView::searchText);
+  searchLayout->addWidget(searchMode_);
+
   searchResults_ = new QListWidget();
   searchResults_->setSelectionMode(QAbstractItemView::SingleSelection);
   connect(searchResults_, &QListWidget::itemClicked, this, &PhyView::searchResultSelected);
@@ -1022,6 +1254,11 @@ void PhyView::createActions_()
   redoAction_ = manager_.createRedoAction(this);
   undoAction_->setShortcut(QKeySequence("Ctrl+Z"));
   redoAction_->setShortcut(QKeySequence("Shift+Ctrl+Z"));
+  connect(&manager_, &QUndoGroup::indexChanged, this, &PhyView::updateStatusBar);
+
+  undoMemoryLimitAction_ = new QAction(tr("Undo memory &limit..."), this);
+  undoMemoryLimitAction_->setStatusTip(tr("Set the memory used by the undo history of the current tree before it is moved to disk"));
+  connect(undoMemoryLimitAction_, &QAction::triggered, this, &PhyView::setUndoMemoryLimit);
 }
 
 
@@ -1039,6 +1276,8 @@ void PhyView::createMenus_()
   editMenu_ = menuBar()->addMenu(tr("&Edit"));
   editMenu_->addAction(undoAction_);
   editMenu_->addAction(redoAction_);
+  editMenu_->addSeparator();
+  editMenu_->addAction(undoMemoryLimitAction_);
 
   viewMenu_ = menuBar()->addMenu(tr("&View"));
   viewMenu_->addAction(statsDockWidget_->toggleViewAction());
@@ -1049,6 +1288,7 @@ void PhyView::createMenus_()
   viewMenu_->addAction(dataDockWidget_->toggleViewAction());
   viewMenu_->addAction(dataViewerDockWidget_->toggleViewAction());
   viewMenu_->addAction(searchDockWidget_->toggleViewAction());
+  viewMenu_->addAction(performanceDockWidget_->toggleViewAction());
   viewMenu_->addAction(cascadeWinAction_);
   viewMenu_->addAction(tileWinAction_);
 
@@ -1061,6 +1301,8 @@ void PhyView::createMenus_()
 
 void PhyView::createStatusBar_()
 {
+  undoMemoryLabel_ = new QLabel;
+  statusBar()->addPermanentWidget(undoMemoryLabel_);
   updateStatusBar();
 }
 
@@ -1071,17 +1313,33 @@ void PhyView::closeEvent(QCloseEvent* event)
 
 
 std::shared_ptr<TreeDocument> PhyView::createNewDocument(Tree* tree)
+{
+  const TreeTemplate<Node>* treeTemplate = dynamic_cast<const TreeTemplate<Node>*>(tree);
+  return createNewDocument(treeTemplate ? TreeTraversal::cloneTree(*treeTemplate) : TreeTraversal::adoptTree(new TreeTemplate<Node>(*tree)));
+}
+
+std::shared_ptr<TreeDocument> PhyView::createNewDocument(std::shared_ptr<TreeTemplate<Node>> tree)
+{
+  return createWindow_(tree, true)->getDocument();
+}
+
+TreeSubWindow* PhyView::createWindow_(std::shared_ptr<TreeTemplate<Node>> tree, bool show)
 {
   auto doc = std::make_shared<TreeDocument>();
-  doc->setTree(*tree);
+  doc->setTree(tree);
   manager_.addStack(&doc->getUndoStack());
   TreeSubWindow* subWindow = new TreeSubWindow(this, doc, treeControlers_->selectedTreeDrawing());
+  subWindow->setLevelOfDetail(levelOfDetail_->isChecked());
   mdiArea_->addSubWindow(subWindow);
-  treeControlers_->applyOptions(subWindow->treeCanvas());
-  subWindow->show();
-  setCurrentSubWindow(subWindow);
-  updateTreesTable();
-  return doc;
+  // There must be an active window:
+  if (show || !mdiArea_->currentSubWindow())
+  {
+    // The drawing is built, with the current options, when the window is shown:
+    subWindow->show();
+    setCurrentSubWindow(subWindow);
+  }
+  addTreesTableRow(subWindow);
+  return subWindow;
 }
 
 
@@ -1111,34 +1369,56 @@ QList<std::shared_ptr<TreeDocument>> PhyView::getDocuments()
 
 void PhyView::readTree(const QString& path, const string& format)
 {
-  unique_ptr<ITree> treeReader(ioTreeFactory_.createReader(format));
-  try
-  {
-    unique_ptr<Tree> tree(treeReader->readTree(path.toStdString()));
-    auto doc = createNewDocument(tree.get());
-    doc->setFile(path.toStdString(), format);
-    saveAction_->setEnabled(true);
-    saveAsAction_->setEnabled(true);
-    closeAction_->setEnabled(true);
-    exportAction_->setEnabled(true);
-    printAction_->setEnabled(true);
-    // We need to remove and add action again for menu to be updated :s
-    fileMenu_->removeAction(saveAction_);
-    fileMenu_->removeAction(saveAsAction_);
-    fileMenu_->removeAction(closeAction_);
-    fileMenu_->removeAction(exportAction_);
-    fileMenu_->removeAction(printAction_);
-    fileMenu_->insertAction(exitAction_, saveAction_);
-    fileMenu_->insertAction(exitAction_, saveAsAction_);
-    fileMenu_->insertAction(exitAction_, closeAction_);
-    fileMenu_->insertAction(exitAction_, exportAction_);
-    fileMenu_->insertAction(exitAction_, printAction_);
-    updateTreesTable();
-  }
-  catch (Exception& e)
+  treeLoader_->load(path, format);
+}
+
+void PhyView::treeLoaded(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree, const std::vector<int>& collapsedIds)
+{
+  openLoadedTree_(path, format, tree)->collapseNodes(collapsedIds);
+}
+
+TreeSubWindow* PhyView::openLoadedTree_(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree)
+{
+  // When many files are opened at once, the windows of the last ones are only listed in the Trees panel:
+  const int maxShownWindows = 10;
+  int shownWindows = 0;
+  for (auto* window : mdiArea_->subWindowList())
   {
-    QMessageBox::critical(this, tr("Ouch..."), tr("Error when reading file:\n") + tr(e.what()));
+    if (window->isVisible())
+      ++shownWindows;
   }
+  TreeSubWindow* subWindow = createWindow_(tree, !treeLoader_->isLoading() || shownWindows < maxShownWindows);
+  subWindow->getDocument()->setFile(path.toStdString(), format);
+  updateTreesTableRow(subWindow);
+  saveAction_->setEnabled(true);
+  saveAsAction_->setEnabled(true);
+  closeAction_->setEnabled(true);
+  exportAction_->setEnabled(true);
+  printAction_->setEnabled(true);
+  // We need to remove and add action again for menu to be updated :s
+  fileMenu_->removeAction(saveAction_);
+  fileMenu_->removeAction(saveAsAction_);
+  fileMenu_->removeAction(closeAction_);
+  fileMenu_->removeAction(exportAction_);
+  fileMenu_->removeAction(printAction_);
+  fileMenu_->insertAction(exitAction_, saveAction_);
+  fileMenu_->insertAction(exitAction_, saveAsAction_);
+  fileMenu_->insertAction(exitAction_, closeAction_);
+  fileMenu_->insertAction(exitAction_, exportAction_);
+  fileMenu_->insertAction(exitAction_, printAction_);
+  return subWindow;
+}
+
+void PhyView::multiTreeFileLoaded(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree, std::shared_ptr<MultiTreeFile> trees)
+{
+  TreeSubWindow* subWindow = openLoadedTree_(path, format, tree);
+  subWindow->getDocument()->setMultiTreeFile(trees);
+  subWindow->updateTreeBrowser();
+}
+
+void PhyView::treeLoadFailed(const QString& path, const QString& message)
+{
+  QMessageBox::critical(this, tr("Ouch..."), tr("Error when reading file %1:\n").arg(path) + message);
 }
 
 
@@ -1153,6 +1433,8 @@ void PhyView::openTree()
       format = IOTreeFactory::NEXUS_FORMAT;
     else if (treeFileDialog_->selectedNameFilter() == treeFileFilters_[2])
       format = IOTreeFactory::NHX_FORMAT;
+    else if (treeFileDialog_->selectedNameFilter() == treeFileFilters_[3])
+      format = BinaryTreeFormat::FORMAT;
     readTree(path[0], format);
   }
 }
@@ -1163,17 +1445,20 @@ void PhyView::setCurrentSubWindow(TreeSubWindow* tsw)
   clearSearchResults();
   if (tsw)
   {
-    statsBox_->updateTree(tsw->tree());
+    tsw->ensureView();
+    statsBox_->showSummary(tsw->getDocument()->getSummary());
     treeControlers_->setTreeCanvas(tsw->getTreeCanvas());
     treeControlers_->actualizeOptions();
     manager_.setActiveStack(&tsw->getDocument()->getUndoStack());
   }
+  updateStatusBar();
+  // The window may have been drawn again:
+  if (tsw)
+    updateTreesTableRow(tsw);
   // Update selection in tree table:
-  updateTreesTable(); // We need this here as some windows may have been closed.
-  QList<QMdiSubWindow*> lst = mdiArea_->subWindowList();
-  for (int i = 0; i < lst.size(); ++i)
+  for (int i = 0; i < treesTableWindows_.size(); ++i)
   {
-    if (lst[i] == mdiArea_->activeSubWindow())
+    if (treesTableWindows_[i] == mdiArea_->activeSubWindow())
     {
       treesTable_->setRangeSelected(QTableWidgetSelectionRange(i, 0, i, 1), true);
     }
@@ -1189,20 +1474,51 @@ bool PhyView::saveTree()
   auto doc = getActiveDocument();
   if (doc->getFilePath() == "")
     return saveTreeAs();
-  string format = doc->getFileFormat();
-  shared_ptr<OTree> treeWriter = ioTreeFactory_.createWriter(format);
+  // Writing a single tree would replace all the trees of the file:
+  if (doc->hasMultiTreeFile() && doc->getFilePath() == doc->getMultiTreeFile()->getPath())
+    return saveTreeAs();
+  try
+  {
+    writeTree(doc->tree(), doc->getFilePath(), doc->getFileFormat(), getActiveSubWindow()->getCollapsedNodes());
+  }
+  catch (exception& e)
+  {
+    QMessageBox::critical(this, tr("Ouch..."), tr("Error when writing file:\n") + tr(e.what()));
+    return false;
+  }
+  return true;
+}
+
+void PhyView::writeTree(const TreeTemplate<Node>& tree, const string& path, const string& format, const vector<int>& collapsedIds)
+{
+  ProfileProbe probe("Write " + FileTools::getFileName(path), "io");
+  if (format == BinaryTreeFormat::FORMAT)
+  {
+    // Binary files are memory mapped when read:
+    if (Compression::isCompressedName(path))
+      throw Exception("PhyView binary files can not be compressed.");
+    BinaryTreeFormat::write(path, tree, collapsedIds);
+    return;
+  }
+  IOTreeFactory ioTreeFactory;
+  shared_ptr<OTree> treeWriter = ioTreeFactory.createWriter(format);
+  auto streamWriter = dynamic_pointer_cast<AbstractOTree>(treeWriter);
+  if (!streamWriter)
+    throw Exception("Format " + format + " can not be written to a stream.");
+  CompressedOutputFile out(path, Compression::isCompressedName(path));
   auto nhx = dynamic_pointer_cast<Nhx>(treeWriter);
   if (nhx)
   {
-    TreeTemplate<Node> treeCopy(doc->tree());
+    TreeTemplate<Node> treeCopy(tree);
+    ValuePool::toBppStrings(treeCopy.rootNode());
     nhx->changeNamesToTags(treeCopy.rootNode());
-    treeWriter->writeTree(treeCopy, doc->getFilePath(), true);
+    streamWriter->writeTree(treeCopy, out);
   }
   else
   {
-    treeWriter->writeTree(doc->tree(), doc->getFilePath(), true);
+    streamWriter->writeTree(tree, out);
   }
-  return true;
+  out.close();
 }
 
 bool PhyView::saveTreeAs()
@@ -1217,7 +1533,15 @@ bool PhyView::saveTreeAs()
       format = IOTreeFactory::NEXUS_FORMAT;
     else if (treeFileDialog_->selectedNameFilter() == treeFileFilters_[2])
       format = IOTreeFactory::NHX_FORMAT;
+    else if (treeFileDialog_->selectedNameFilter() == treeFileFilters_[3])
+      format = BinaryTreeFormat::FORMAT;
+    if (doc->hasMultiTreeFile() && path[0].toStdString() == doc->getMultiTreeFile()->getPath())
+    {
+      QMessageBox::critical(this, tr("Ouch..."), tr("This file contains several trees, and can not be replaced by a single one."));
+      return false;
+    }
     doc->setFile(path[0].toStdString(), format);
+    updateTreesTableRow(getActiveSubWindow());
     return saveTree();
   }
   return false;
@@ -1253,38 +1577,69 @@ void PhyView::closeTree()
     exportAction_->setDisabled(true);
     saveAction_->setDisabled(true);
   }
-  updateTreesTable();
 }
 
-void PhyView::updateTreesTable()
+void PhyView::addTreesTableRow(TreeSubWindow* tsw)
 {
-  // Update tree list:
-  treesTable_->clearSelection();
-  treesTable_->clearContents();
-  QList<QMdiSubWindow*> lst = mdiArea_->subWindowList();
-  treesTable_->setRowCount(lst.size());
-  for (int i = 0; i < lst.size(); ++i)
-  {
-    auto doc = dynamic_cast<TreeSubWindow*>(lst[i])->getDocument();
-    string docName = doc->getName();
-    if (docName == "")
-      docName = "Tree#" + TextTools::toString(i + 1);
-    treesTable_->setItem(i, 0, new QTableWidgetItem(QtTools::toQt(docName)));
-    treesTable_->setItem(i, 1, new QTableWidgetItem(QtTools::toQt(TextTools::toString<unsigned int>(doc->getTree()->getNumberOfLeaves()))));
-  }
+  int row = treesTable_->rowCount();
+  treesTable_->insertRow(row);
+  treesTableWindows_.push_back(tsw);
+  treesTable_->setItem(row, 0, new QTableWidgetItem());
+  treesTable_->setItem(row, 1, new QTableWidgetItem());
+  updateTreesTableRow(tsw);
+  updateTreesTableSize(tsw);
 }
 
-void PhyView::updateDataViewer(const TreeTemplate<Node>& tree, int nodeId)
+void PhyView::updateTreesTableRow(TreeSubWindow* tsw)
+{
+  int row = treesTableWindows_.indexOf(tsw);
+  if (row < 0)
+    return;
+  string docName = tsw->getDocument()->getName();
+  if (docName == "")
+    docName = "Tree#" + TextTools::toString(row + 1);
+  QTableWidgetItem* item = treesTable_->item(row, 0);
+  item->setText(QtTools::toQt(docName));
+  // Not drawn yet, or hibernated:
+  QFont font = item->font();
+  font.setItalic(!tsw->hasView());
+  item->setFont(font);
+  item->setToolTip(tsw->hasView() ? QString() : tr("Not drawn, select to show"));
+}
+
+void PhyView::updateTreesTableSize(TreeSubWindow* tsw)
+{
+  int row = treesTableWindows_.indexOf(tsw);
+  if (row < 0)
+    return;
+  treesTable_->item(row, 1)->setText(QtTools::toQt(TextTools::toString(tsw->getDocument()->getSummary().getNumberOfLeaves())));
+}
+
+void PhyView::removeTreesTableRow(TreeSubWindow* tsw)
+{
+  int row = treesTableWindows_.indexOf(tsw);
+  if (row < 0)
+    return;
+  treesTable_->removeRow(row);
+  treesTableWindows_.removeAt(row);
+}
+
+void PhyView::updateDataViewer(std::shared_ptr<TreeDocument> doc, int nodeId)
 {
   dataViewerTable_->clearSelection();
   dataViewerTable_->clearContents();
-  const auto& node = *tree.getNode(nodeId);
+  auto ids = TreeTraversal::getNodesId(*doc->getNode(nodeId));
   
+  // Only properties with a value in the subtree are shown:
+  const PropertyStore& store = doc->getPropertyStore();
   vector<string> propertyNames;
-  TreeTemplateTools::getNodePropertyNames(node, propertyNames);
+  for (const auto& name : store.getColumnNames())
+  {
+    const PropertyColumn& column = store.getColumn(name);
+    if (any_of(ids.begin(), ids.end(), [&column](int id) { return column.hasValue(id); }))
+      propertyNames.push_back(name);
+  }
   dataViewerTable_->setColumnCount(propertyNames.size());
-
-  auto ids = TreeTemplateTools::getNodesId(node);
   dataViewerTable_->setRowCount(ids.size());
   
   QStringList colHeader, rowHeader;
@@ -1295,16 +1650,19 @@ void PhyView::updateDataViewer(const TreeTemplate<Node>& tree, int nodeId)
   for (size_t i = 0; i < propertyNames.size(); ++i)
   {
     colHeader.append(QString(propertyNames[i].c_str()));
-    map<int, const Clonable*> properties;
-    TreeTemplateTools::getNodeProperties(node, propertyNames[i], properties);
+    const PropertyColumn& column = store.getColumn(propertyNames[i]);
     for (size_t j = 0; j < ids.size(); ++j)
     {
-      auto property = properties[ids[j]];
-      if (property)
-      {
-        dataViewerTable_->setItem(j, i, new QTableWidgetItem(
-			      QtTools::toQt(dynamic_cast<const BppString*>(property)->toSTL())));
-      }
+      if (!column.hasValue(ids[j]))
+        continue;
+      QString text;
+      if (column.getType() == PropertyColumn::STRING)
+        text = QtTools::toQt(column.getText(ids[j]));
+      else if (column.getType() == PropertyColumn::NUMBER)
+        text = QString::number(column.getNumber(ids[j]));
+      else if (auto str = SharedString::getText(doc->getNode(ids[j])->getNodeProperty(propertyNames[i])))
+        text = QtTools::toQt(*str);
+      dataViewerTable_->setItem(j, i, new QTableWidgetItem(text));
     }
   }
   dataViewerTable_->setHorizontalHeaderLabels(colHeader);
@@ -1333,6 +1691,32 @@ void PhyView::about()
 
 void PhyView::updateStatusBar()
 {
+  if (!hasActiveDocument())
+  {
+    undoMemoryLabel_->clear();
+    return;
+  }
+  const UndoHistory& history = getActiveDocument()->getUndoHistory();
+  undoMemoryLabel_->setText(tr("Undo: %1 MB in memory, %2 MB on disk (limit %3 MB)")
+      .arg(static_cast<double>(history.getMemoryUsage()) / 1048576., 0, 'f', 1)
+      .arg(static_cast<double>(history.getDiskUsage()) / 1048576., 0, 'f', 1)
+      .arg(static_cast<qulonglong>(history.getMemoryLimit() / 1048576)));
+}
+
+void PhyView::setUndoMemoryLimit()
+{
+  if (!hasActiveDocument())
+    return;
+  UndoHistory& history = getActiveDocument()->getUndoHistory();
+  bool ok;
+  int limit = QInputDialog::getInt(this, tr("Undo memory limit"), tr("Memory limit (MB):"),
+      static_cast<int>(history.getMemoryLimit() / 1048576), 1, 1048576, 64, &ok);
+  if (ok)
+  {
+    history.setMemoryLimit(static_cast<size_t>(limit) * 1048576);
+    history.enforceMemoryLimit(0);
+    updateStatusBar();
+  }
 }
 
 void PhyView::setLengths()
@@ -1419,16 +1803,26 @@ void PhyView::uncollapseAll()
 {
   if (hasActiveDocument())
   {
-    auto ids = getActiveDocument()->tree().getNodesId();
+    auto ids = TreeTraversal::getNodesId(getActiveDocument()->tree().rootNode());
     TreeCanvas& tc = getActiveSubWindow()->treeCanvas();
     auto& td = tc.treeDrawing();
     for (const auto& id : ids) {
       td.collapseNode(id, false);
     }
+    getActiveSubWindow()->levelOfDetail().invalidate();
     tc.redraw();
   }
 }
 
+void PhyView::setLevelOfDetail(bool yn)
+{
+  QList<QMdiSubWindow*> lst = mdiArea_->subWindowList();
+  for (int i = 0; i < lst.size(); ++i)
+  {
+    dynamic_cast<TreeSubWindow*>(lst[i])->setLevelOfDetail(yn);
+  }
+}
+
 void PhyView::autoCollapse()
 {
   if (hasActiveDocument())
@@ -1442,7 +1836,7 @@ void PhyView::controlerTakesAction()
   QList<QMdiSubWindow*> lst = mdiArea_->subWindowList();
   for (int i = 0; i < lst.size(); ++i)
   {
-    dynamic_cast<TreeSubWindow*>(lst[i])->treeCanvas().redraw();
+    dynamic_cast<TreeSubWindow*>(lst[i])->requestRedraw();
   }
 }
 
@@ -1455,9 +1849,16 @@ void PhyView::attachData()
     string sep = ",";
     if (dataFileDialog_->selectedNameFilter() == dataFileFilters_[1])
       sep = "\t";
-    ifstream file(path[0].toStdString().c_str(), ios::in);
-    auto table = DataTable::read(file, sep);
-    dataLoader_->load(*table);
+    try
+    {
+      CompressedInputFile file(path[0].toStdString());
+      auto table = DataTable::read(file, sep);
+      dataLoader_->load(*table);
+    }
+    catch (exception& e)
+    {
+      QMessageBox::critical(this, tr("Ouch..."), tr("Error when reading table:\n") + tr(e.what()));
+    }
   }
 }
 
@@ -1473,7 +1874,14 @@ void PhyView::saveData()
       if (dataFileDialog_->selectedNameFilter() == dataFileFilters_[1])
         sep = "\t";
 
-      getActiveSubWindow()->writeTableToFile(path[0].toStdString(), sep);
+      try
+      {
+        getActiveSubWindow()->writeTableToFile(path[0].toStdString(), sep);
+      }
+      catch (exception& e)
+      {
+        QMessageBox::critical(this, tr("Ouch..."), tr("Error when writing file:\n") + tr(e.what()));
+      }
     }
   }
 }
@@ -1493,8 +1901,7 @@ void PhyView::removeData()
 {
   if (hasActiveDocument())
   {
-    vector<string> tmp;
-    TreeTemplateTools::getNodePropertyNames(getActiveDocument()->tree().rootNode(), tmp);
+    vector<string> tmp = getActiveDocument()->getPropertyStore().getColumnNames();
     if (tmp.size() == 0)
     {
       QMessageBox::information(this, tr("Warning"), tr("No removable data is attached to this tree."), QMessageBox::Cancel);
@@ -1516,8 +1923,7 @@ void PhyView::renameData()
 {
   if (hasActiveDocument())
   {
-    vector<string> tmp;
-    TreeTemplateTools::getNodePropertyNames(getActiveDocument()->tree().rootNode(), tmp);
+    vector<string> tmp = getActiveDocument()->getPropertyStore().getColumnNames();
     if (tmp.size() == 0)
     {
       QMessageBox::information(this, tr("Warning"), tr("No data which can be renamed is attached to this tree."), QMessageBox::Cancel);
@@ -1568,24 +1974,86 @@ void PhyView::ancestralStateReconstruction()
 
 
 
-void PhyView::searchText()
+void PhyView::prepareSearch()
 {
-  if (!getActiveSubWindow())
+  TreeSubWindow* tsw = getActiveSubWindow();
+  if (!tsw || !tsw->getDocument()->hasTree())
     return;
-  getActiveSubWindow()->treeCanvas().redraw();
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  tsw->getDocument()->getNameIndex();
+  QApplication::restoreOverrideCursor();
+}
+
+void PhyView::searchText()
+{
   clearSearchResults();
-  QList<QGraphicsTextItem*> results = getActiveSubWindow()->treeCanvas().searchText(searchText_->text());
-  for (int i = 0; i < results.size(); ++i)
+  if (!getActiveSubWindow() || searchText_->text().isEmpty())
+    return;
+  TreeSubWindow* tsw = getActiveSubWindow();
+  vector<NameIndex::Match> matches;
+  try
   {
-    searchResults_->addItem(results[i]->toPlainText());
-    searchResultsItems_.append(results[i]);
-    results[i]->setDefaultTextColor(Qt::red);
+    // More results would not be browsable anyway:
+    matches = tsw->getDocument()->getNameIndex().search(
+        searchText_->text().toStdString(), static_cast<NameIndex::Mode>(searchMode_->currentIndex()), 1000);
+  }
+  catch (Exception& e)
+  {
+    statusBar()->showMessage(QtTools::toQt(e.what()), 3000);
+    return;
+  }
+  QSet<QString> highlighted;
+  for (const auto& match : matches)
+  {
+    QString text = QtTools::toQt(match.text);
+    if (match.property.empty())
+      searchResults_->addItem(tr("%1 (node %2)").arg(text).arg(match.nodeId));
+    else
+      searchResults_->addItem(tr("%1 = %2 (node %3)").arg(QtTools::toQt(match.property)).arg(text).arg(match.nodeId));
+    // Only names are drawn:
+    QList<QGraphicsTextItem*> labels;
+    if (match.property.empty())
+      labels = tsw->findLabels(text);
+    searchResultsItems_.append(labels.isEmpty() ? 0 : labels[0]);
+    if (highlighted.contains(text))
+      continue;
+    highlighted.insert(text);
+    for (auto* label : labels)
+    {
+      highlightedItems_.append(qMakePair(QPointer<QGraphicsTextItem>(label), label->defaultTextColor()));
+      label->setDefaultTextColor(Qt::red);
+    }
+  }
+}
+
+void PhyView::hibernateIdleWindows()
+{
+  const qint64 delay = 10 * 60 * 1000;
+  QMdiSubWindow* current = mdiArea_->currentSubWindow();
+  bool covered = current && current->isMaximized();
+  for (auto* window : mdiArea_->subWindowList())
+  {
+    TreeSubWindow* tsw = dynamic_cast<TreeSubWindow*>(window);
+    if (!tsw->hasView())
+      continue;
+    if (window == current || (window->isVisible() && !window->isMinimized() && !covered))
+    {
+      // Still viewed:
+      tsw->ensureView();
+    }
+    else if (tsw->getIdleTime() >= delay)
+    {
+      tsw->hibernate();
+      updateTreesTableRow(tsw);
+    }
   }
 }
 
 void PhyView::searchResultSelected()
 {
-  getActiveSubWindow()->treeCanvas().ensureVisible(searchResultsItems_[searchResults_->currentRow()]);
+  int row = searchResults_->currentRow();
+  if (row >= 0 && row < searchResultsItems_.size() && searchResultsItems_[row])
+    getActiveSubWindow()->treeCanvas().ensureVisible(searchResultsItems_[row]);
 }
 
 void PhyView::activateSelectedDocument()
@@ -1593,7 +2061,9 @@ void PhyView::activateSelectedDocument()
   if (treesTable_->selectedItems().size() > 0)
   {
     int index = treesTable_->selectedItems()[0]->row();
-    mdiArea_->setActiveSubWindow(mdiArea_->subWindowList()[index]);
+    // Windows of documents opened in bulk are hidden until they are selected:
+    treesTableWindows_[index]->show();
+    mdiArea_->setActiveSubWindow(treesTableWindows_[index]);
     mdiArea_->activeSubWindow()->showNormal();
     mdiArea_->activeSubWindow()->raise();
   }
@@ -1610,14 +2080,15 @@ std::shared_ptr<TreeTemplate<Node>> PhyView::pickTree()
     QString text = QtTools::toQt(documents[i]->getName());
     if (text == "")
       text = "(unknown)";
-    vector<string> leaves = documents[i]->tree().getLeavesNames();
-    text += QtTools::toQt(" " + TextTools::toString(leaves.size()) + " leaves ");
+    const TreeSummary& summary = documents[i]->getSummary();
+    text += QtTools::toQt(" " + TextTools::toString(summary.getNumberOfLeaves()) + " leaves ");
 
-    for (unsigned int j = 0; j < min(static_cast < unsigned int > (leaves.size()), 5u); ++j)
+    const vector<string>& leaves = summary.getFirstLeavesNames();
+    for (size_t j = 0; j < leaves.size(); ++j)
     {
       text += QtTools::toQt(", " + leaves[j]);
     }
-    if (leaves.size() >= 5)
+    if (summary.getNumberOfLeaves() > leaves.size())
       text += "...";
     // treeList_->addItem(text);
     items << text;
@@ -1633,71 +2104,3 @@ std::shared_ptr<TreeTemplate<Node>> PhyView::pickTree()
   else
     return 0;
 }
-
-
-// This class is necessary to reimplement the notify method, in order to catch any foreign exception.
-class PhyViewApplication :
-  public QApplication
-{
-public:
-  PhyViewApplication(int& argc, char* argv[]) :
-    QApplication(argc, argv) {}
-
-public:
-  bool notify(QObject* receiver_, QEvent* event_)
-  {
-    try
-    {
-      return QApplication::notify(receiver_, event_);
-    }
-    catch (std::exception& ex)
-    {
-      std::cerr << "std::exception was caught" << std::endl;
-      std::cerr << ex.what() << endl;
-      QMessageBox msgBox;
-      msgBox.setText(ex.what());
-      msgBox.exec();
-    }
-    return false;
-  }
-};
-
-int main(int argc, char* argv[])
-{
-  PhyViewApplication app(argc, argv);
-
-  PhyView* phyview = new PhyView();
-  phyview->show();
-
-  // Parse command line arguments:
-  QStringList args = app.arguments();
-  string format = IOTreeFactory::NEWICK_FORMAT;
-  // QTextCodec* codec = QTextCodec::codecForLocale(); Not supported in Qt5...
-  for (int i = 1; i < args.size(); ++i)
-  {
-    if (args[i] == "--nhx")
-    {
-      format = IOTreeFactory::NHX_FORMAT;
-    }
-    else if (args[i] == "--nexus")
-    {
-      format = IOTreeFactory::NEWICK_FORMAT;
-    }
-    else if (args[i] == "--newick")
-    {
-      format = IOTreeFactory::NEWICK_FORMAT;
-      // } else if (args[i] == "--enc") {
-      //  if (i == args.size() - 1) {
-      //    cerr << "You must specify a text encoding after --enc tag." << endl;
-      //    exit(1);
-      //  }
-      //  ++i;
-      //  codec = QTextCodec::codecForName(args[i].toStdString().c_str());
-    }
-    else
-    {
-      phyview->readTree(args[i], format);
-    }
-  }
-  return app.exec();
-}
@@ -3,7 +3,10 @@
 // SPDX-License-Identifier: CECILL-2.1
 
 #include "TreeSubWindow.h"
+#include "TreeLoader.h"
 #include "TreeCommands.h"
+#include "PerformancePanel.h"
+#include "TreeSummaryBox.h"
 
 // From Qt:
 #include <QWidget>
@@ -17,6 +20,10 @@
 #include <QRadioButton>
 #include <QPrinter>
 #include <QPrintDialog>
+#include <QTableWidget>
+#include <QGraphicsTextItem>
+#include <QPointer>
+#include <QTimer>
 
 class QAction;
 class QLabel;
@@ -25,7 +32,6 @@ class QLabel;
 #include <Bpp/Phyl/Io/IoTreeFactory.h>
 #include <Bpp/Qt/Tree/TreeCanvas.h>
 #include <Bpp/Qt/Tree/TreeCanvasControlers.h>
-#include <Bpp/Qt/Tree/TreeStatisticsBox.h>
 
 using namespace bpp;
 
@@ -117,7 +123,7 @@ public:
   void load(const DataTable& data);
 
 private:
-  void addProperties_(Node* node, const DataTable& data);
+  static QString summarizeKeys_(const std::vector<std::string>& keys, size_t max = 10);
 };
 
 
@@ -128,8 +134,9 @@ class AsrDialog :
 
 private:
   PhyView* phyview_;
-  QComboBox* variableCol_, * asrMethod_;
-  QPushButton* ok_, * cancel_;
+  QListWidget* variables_;
+  QComboBox* asrMethod_;
+  QPushButton* selectAll_, * ok_, * cancel_;
 
 public:
   AsrDialog(PhyView* phyview);
@@ -162,8 +169,27 @@ public:
 public:
   void process(QGraphicsScene* scene);
 
+  /**
+   * @brief Render a scene into a PNG file band by band, with bounded memory.
+   *
+   * @param progress Called with the number of rows written so far, returns false to cancel.
+   * @return false if the export was cancelled.
+   * @throw Exception If the file could not be written.
+   */
+  static bool renderToPng(
+      QGraphicsScene* scene,
+      const QString& path,
+      int width,
+      int height,
+      bool transparent,
+      bool keepAspectRatio,
+      const std::function<bool (int)>& progress = std::function<bool (int)>());
+
 public slots:
   void chosePath();
+
+private:
+  static const int MAX_BAND_SIZE;
 };
 
 
@@ -193,7 +219,7 @@ class CollapseDialog :
 
 private:
   PhyView* phyview_;
-  QComboBox* variableCol_;
+  QListWidget* variables_;
   QCheckBox* allowMissing_;
   QLineEdit* missingDataText_;
   QPushButton* ok_, * cancel_;
@@ -207,14 +233,18 @@ public:
   void collapse();
   
 private:
-  std::string scan_(
-      TreeCanvas& tc,
-      const Node& node,
-      const std::string& propertyName,
-      bool& isMonophyletic,
+  /**
+   * @brief Find the clades whose leaves all have the same values for all the given properties.
+   *
+   * @param allowMissingData If true, leaves without a value (or with naString) are ignored,
+   * otherwise no clade containing them is returned.
+   * @return The ids of the inner nodes of these clades, nested ones included.
+   */
+  static std::vector<int> findMonophyleticNodes_(
+      const Node& root,
+      const std::vector<std::string>& propertyNames,
       bool allowMissingData,
-      const string& naString = "NA");
-  
+      const std::string& naString = "NA");
 };
 
 
@@ -243,6 +273,7 @@ private:
   QAction* aboutQtAction_;
   QAction* undoAction_;
   QAction* redoAction_;
+  QAction* undoMemoryLimitAction_;
 
   QUndoGroup manager_;
 
@@ -251,12 +282,11 @@ private:
   QStringList treeFileFilters_;
   QFileDialog* dataFileDialog_;
   QStringList dataFileFilters_;
-  IOTreeFactory ioTreeFactory_;
   QPrinter* printer_;
   QPrintDialog* printDialog_;
   TreeCanvasControlers* treeControlers_;
   QWidget* displayPanel_;
-  TreeStatisticsBox* statsBox_;
+  TreeSummaryBox* statsBox_;
   QWidget* treesPanel_;
   QWidget* statsPanel_;
   QWidget* brlenPanel_;
@@ -270,8 +300,9 @@ private:
   QDockWidget* displayDockWidget_;
   QDockWidget* undoDockWidget_;
 
-  // Trees:
+  // Trees, one row per window, in the order they were added:
   QTableWidget* treesTable_;
+  QList<TreeSubWindow*> treesTableWindows_;
 
   // Branch lengths operations:
   QDockWidget* brlenDockWidget_;
@@ -300,6 +331,7 @@ private:
   QPushButton* asr_;
   QPushButton* uncollapseAll_;
   QPushButton* autoCollapse_;
+  QCheckBox* levelOfDetail_;
 
   //Data viewing:
   QDockWidget* dataViewerDockWidget_;
@@ -308,8 +340,13 @@ private:
   // Searching:
   QDockWidget* searchDockWidget_;
   QLineEdit*   searchText_;
+  QComboBox*   searchMode_;
   QListWidget* searchResults_;
 
+  // Performance:
+  QDockWidget* performanceDockWidget_;
+  PerformancePanel* performancePanel_;
+
   LabelCollapsedNodesTreeDrawingListener collapsedNodesListener_;
 
   TranslateNameChooser* translateNameChooser_;
@@ -324,7 +361,16 @@ private:
   
   ImageExportDialog* imageExportDialog_;
 
-  QList<QGraphicsTextItem*> searchResultsItems_;
+  TreeLoader* treeLoader_;
+
+  // The label of each search result in the drawing, if it is shown, and the highlighted labels with their original color.
+  // Labels are deleted when the tree is redrawn.
+  QList< QPointer<QGraphicsTextItem> > searchResultsItems_;
+  QList< QPair<QPointer<QGraphicsTextItem>, QColor> > highlightedItems_;
+
+  QLabel* undoMemoryLabel_;
+
+  QTimer hibernationTimer_;
 
 public:
   PhyView();
@@ -356,6 +402,16 @@ public:
 
   std::shared_ptr<TreeDocument> createNewDocument(Tree* tree);
 
+  std::shared_ptr<TreeDocument> createNewDocument(std::shared_ptr<TreeTemplate<Node>> tree);
+
+  /**
+   * @brief Apply the settings of the drawing controls to a new canvas.
+   */
+  void applyDrawingOptions(TreeCanvas& canvas)
+  {
+    treeControlers_->applyOptions(canvas);
+  }
+
   MouseActionListener* getMouseActionListener()
   {
     return new MouseActionListener(this);
@@ -367,8 +423,20 @@ public:
 
   void controlerTakesAction();
 
+  /**
+   * @brief Load a tree file in the background. A new document is created once the tree is ready.
+   */
   void readTree(const QString& path, const string& format);
 
+  /**
+   * @brief Write a tree to a file. With NHX, node properties are written as tags.
+   *
+   * Text formats are compressed with gzip when the name of the file ends with ".gz".
+   *
+   * @param collapsedIds Nodes to save as collapsed, only with the binary format.
+   */
+  static void writeTree(const TreeTemplate<Node>& tree, const string& path, const string& format, const vector<int>& collapsedIds = vector<int>());
+
   std::shared_ptr<TreeTemplate<Node>> pickTree();
 
   void checkLastWindow()
@@ -379,20 +447,49 @@ public:
     {
       treesTable_->clearContents();
       treesTable_->setRowCount(0);
+      treesTableWindows_.clear();
     }
   }
 
+  /**
+   * @brief Add the row of a new window to the trees table.
+   */
+  void addTreesTableRow(TreeSubWindow* tsw);
+
+  /**
+   * @brief Show the name of the document of a window, and whether the window is drawn.
+   */
+  void updateTreesTableRow(TreeSubWindow* tsw);
+
+  /**
+   * @brief Show the number of leaves of the tree of a window, after its topology has changed.
+   */
+  void updateTreesTableSize(TreeSubWindow* tsw);
+
+  /**
+   * @brief Remove the row of a window being closed.
+   */
+  void removeTreesTableRow(TreeSubWindow* tsw);
+
 protected:
   void closeEvent(QCloseEvent* event);
 
 public slots:
-  void updateTreesTable();
   void clearSearchResults()
   {
     searchResults_->clear();
     searchResultsItems_.clear();
+    for (auto& item : highlightedItems_)
+    {
+      if (item.first)
+        item.first->setDefaultTextColor(item.second);
+    }
+    highlightedItems_.clear();
   }
-  void updateDataViewer(const TreeTemplate<Node>& tree, int nodeId);
+  void updateDataViewer(std::shared_ptr<TreeDocument> doc, int nodeId);
+  void treeLoaded(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree, const std::vector<int>& collapsedIds);
+  void multiTreeFileLoaded(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree, std::shared_ptr<MultiTreeFile> trees);
+  void treeLoadFailed(const QString& path, const QString& message);
 
 private slots:
   void openTree();
@@ -405,6 +502,7 @@ private slots:
   void about();
   void aboutBpp();
   void updateStatusBar();
+  void setUndoMemoryLimit();
   void setCurrentSubWindow(TreeSubWindow* tsw);
   void setCurrentSubWindow(QMdiSubWindow* msw)
   {
@@ -414,7 +512,11 @@ private slots:
 
   void updateStatistics()
   {
-    statsBox_->updateTree(*getActiveDocument()->getTree());
+    auto doc = getActiveDocument();
+    if (doc)
+      statsBox_->showSummary(doc->getSummary());
+    else
+      statsBox_->clear();
   }
   void setLengths();
   void initLengthsGrafen();
@@ -428,6 +530,7 @@ private slots:
   void setNamesFromData();
   void uncollapseAll();
   void autoCollapse();
+  void setLevelOfDetail(bool yn);
 
   void attachData();
   void saveData();
@@ -437,10 +540,19 @@ private slots:
   void duplicateDownSelection();
   void snapData();
   void ancestralStateReconstruction();
+  /**
+   * @brief Build the search index of the active document, if it is not built yet.
+   */
+  void prepareSearch();
   void searchText();
   void searchResultSelected();
   void activateSelectedDocument();
 
+  /**
+   * @brief Free the drawings of the windows which have not been viewed for a while, and are not visible.
+   */
+  void hibernateIdleWindows();
+
 private:
   void initGui_();
   void createActions_();
@@ -455,6 +567,14 @@ private:
   void createDataPanel_();
   void createDataViewerPanel_();
   void createSearchPanel_();
+
+  /**
+   * @param show Whether to show and activate the window. Hidden windows are listed in the
+   * Trees panel, and only get a drawing when they are shown.
+   */
+  TreeSubWindow* createWindow_(std::shared_ptr<TreeTemplate<Node>> tree, bool show);
+
+  TreeSubWindow* openLoadedTree_(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree);
 };
 
 
@@ -0,0 +1,459 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "PhyView.h"
+#include "TreeCommands.h"
+#include "TreeDocument.h"
+#include "TreeLoader.h"
+#include "NodeTableModel.h"
+#include "BinaryTreeFormat.h"
+
+#include <Bpp/BppString.h>
+#include <Bpp/Numeric/DataTable.h>
+#include <Bpp/Numeric/Number.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Graphics/PhylogramPlot.h>
+#include <Bpp/Phyl/Io/IoTreeFactory.h>
+#include <Bpp/Phyl/Tree/TreeTemplateTools.h>
+#include <Bpp/Phyl/Tree/TreeTools.h>
+
+// From bpp-qt:
+#include <Bpp/Qt/Tree/TreeCanvas.h>
+
+// From Qt:
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+
+// From the STL:
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+using namespace bpp;
+using namespace std;
+
+/**
+ * @brief Benchmarks of PhyView operations on synthetic trees.
+ *
+ * phyview-bench [--shapes balanced,caterpillar,random] [--sizes 1000,10000,...]
+ *               [--seed n] [--no-render] [--deep] [--output file]
+ *
+ * For each shape and number of leaves, a tree with random branch lengths, bootstrap
+ * values and annotations is generated, then every command is done and undone,
+ * data are attached, the tree is written and read in the NHX and binary formats,
+ * the node table is reset and the tree is drawn and exported offscreen. The time
+ * of each operation and the peak resident memory of the process after it are
+ * written as JSON, to compare versions.
+ *
+ * Caterpillar trees are as deep as they have leaves, and bpp-phyl functions used by
+ * several commands are recursive: unless --deep is given, caterpillars are limited
+ * to 10,000 leaves. Other shapes go up to 10,000,000 leaves by default, which needs
+ * several gigabytes of memory; use --sizes to stop earlier.
+ */
+namespace
+{
+struct Result
+{
+  string shape;
+  size_t numberOfLeaves;
+  string operation;
+  double seconds;
+  long long peakMemory;
+  string error;
+};
+
+/**
+ * @return The largest resident set size of the process so far, in bytes, or 0 if not available.
+ */
+long long getPeakMemoryUsage()
+{
+#ifdef __unix__
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    return static_cast<long long>(usage.ru_maxrss) * 1024;
+#endif
+  return 0;
+}
+
+string toJson(const string& text)
+{
+  string json = "\"";
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+      json += '\\';
+    json += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+  }
+  return json + "\"";
+}
+
+struct SyntheticTree
+{
+  shared_ptr<TreeTemplate<Node>> tree;
+  // A son of the root which is not a leaf, and a leaf:
+  int innerId;
+  int leafId;
+};
+
+class TreeGenerator
+{
+private:
+  mt19937 random_;
+  int nextId_;
+  size_t nextLeaf_;
+
+public:
+  TreeGenerator(unsigned int seed) : random_(seed), nextId_(0), nextLeaf_(0) {}
+
+public:
+  /**
+   * @param shape "balanced", "caterpillar" or "random".
+   * @param numberOfLeaves At least 4.
+   */
+  SyntheticTree generate(const string& shape, size_t numberOfLeaves)
+  {
+    nextId_ = 0;
+    nextLeaf_ = 0;
+    Node* root = newNode_();
+    if (shape == "balanced")
+    {
+      vector<pair<Node*, size_t>> stack(1, make_pair(root, numberOfLeaves));
+      while (!stack.empty())
+      {
+        Node* node = stack.back().first;
+        size_t n = stack.back().second;
+        stack.pop_back();
+        if (n == 1)
+        {
+          setLeaf_(*node);
+          continue;
+        }
+        Node* left = newNode_();
+        Node* right = newNode_();
+        node->addSon(left);
+        node->addSon(right);
+        stack.push_back(make_pair(right, n - n / 2));
+        stack.push_back(make_pair(left, n / 2));
+      }
+    }
+    else if (shape == "caterpillar")
+    {
+      Node* node = root;
+      for (size_t i = 0; i < numberOfLeaves - 1; ++i)
+      {
+        Node* inner = newNode_();
+        node->addSon(inner);
+        Node* leaf = newNode_();
+        setLeaf_(*leaf);
+        node->addSon(leaf);
+        node = inner;
+      }
+      setLeaf_(*node);
+    }
+    else if (shape == "random")
+    {
+      // Yule process: a random leaf is split until there are enough of them.
+      vector<Node*> leaves;
+      for (size_t i = 0; i < 2; ++i)
+      {
+        leaves.push_back(newNode_());
+        root->addSon(leaves.back());
+      }
+      while (leaves.size() < numberOfLeaves)
+      {
+        size_t i = uniform_int_distribution<size_t>(0, leaves.size() - 1)(random_);
+        Node* left = newNode_();
+        Node* right = newNode_();
+        leaves[i]->addSon(left);
+        leaves[i]->addSon(right);
+        leaves[i] = left;
+        leaves.push_back(right);
+      }
+      for (auto* leaf : leaves)
+      {
+        setLeaf_(*leaf);
+      }
+    }
+    else
+    {
+      delete root;
+      throw Exception("Unknown tree shape: " + shape);
+    }
+
+    SyntheticTree synthetic;
+    synthetic.tree = TreeTraversal::makeTree(root);
+    synthetic.innerId = -1;
+    for (size_t i = 0; i < root->getNumberOfSons(); ++i)
+    {
+      if (!root->getSon(i)->isLeaf())
+        synthetic.innerId = root->getSon(i)->getId();
+    }
+    const Node* node = root;
+    while (!node->isLeaf())
+    {
+      node = node->getSon(node->getNumberOfSons() - 1);
+    }
+    synthetic.leafId = node->getId();
+    return synthetic;
+  }
+
+private:
+  Node* newNode_()
+  {
+    Node* node = new Node(nextId_++);
+    if (nextId_ > 1)
+    {
+      node->setDistanceToFather(exponential_distribution<double>(10.)(random_));
+      node->setBranchProperty(TreeTools::BOOTSTRAP, Number<double>(uniform_real_distribution<double>(0., 100.)(random_)));
+    }
+    node->setNodeProperty("value", Number<double>(normal_distribution<double>()(random_)));
+    return node;
+  }
+
+  void setLeaf_(Node& leaf)
+  {
+    static const char* states[] = { "A", "B", "C", "D" };
+    leaf.setName("L" + TextTools::toString(nextLeaf_++));
+    leaf.deleteBranchProperty(TreeTools::BOOTSTRAP);
+    leaf.setNodeProperty("state", BppString(states[uniform_int_distribution<int>(0, 3)(random_)]));
+  }
+};
+
+class Benchmark
+{
+private:
+  string shape_;
+  size_t numberOfLeaves_;
+  vector<Result>& results_;
+
+public:
+  Benchmark(const string& shape, size_t numberOfLeaves, vector<Result>& results) :
+    shape_(shape), numberOfLeaves_(numberOfLeaves), results_(results) {}
+
+public:
+  /**
+   * @return false if the operation failed.
+   */
+  bool run(const string& operation, const function<void ()>& f)
+  {
+    Result result = { shape_, numberOfLeaves_, operation, 0., 0, "" };
+    QElapsedTimer timer;
+    timer.start();
+    try
+    {
+      f();
+    }
+    catch (exception& e)
+    {
+      result.error = e.what();
+    }
+    result.seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    result.peakMemory = getPeakMemoryUsage();
+    results_.push_back(result);
+    cerr << shape_ << "\t" << numberOfLeaves_ << "\t" << operation << "\t" << result.seconds << (result.error.empty() ? "" : "\t" + result.error) << endl;
+    return result.error.empty();
+  }
+
+  /**
+   * @brief Time a command, created and done, then undone.
+   */
+  void runCommand(const string& operation, const function<QUndoCommand* ()>& create)
+  {
+    unique_ptr<QUndoCommand> command;
+    if (run(operation, [&]() { command.reset(create()); command->redo(); }))
+      run(operation + " (undo)", [&]() { command->undo(); });
+  }
+};
+
+void runAll(const SyntheticTree& synthetic, Benchmark& benchmark, bool render)
+{
+  auto doc = make_shared<TreeDocument>();
+  benchmark.run("set tree", [&]() { doc->setTree(synthetic.tree); });
+  int rootId = doc->tree().getRootId();
+  int innerId = synthetic.innerId;
+  int leafId = synthetic.leafId;
+  size_t numberOfLeaves = doc->getSummary().getNumberOfLeaves();
+
+  benchmark.runCommand("set lengths", [&]() { return new SetLengthCommand(doc, 0.1); });
+  benchmark.runCommand("delete lengths", [&]() { return new DeleteLengthCommand(doc); });
+  benchmark.runCommand("delete support values", [&]() { return new DeleteSupportValuesCommand(doc); });
+  benchmark.runCommand("init Grafen", [&]() { return new InitGrafenCommand(doc); });
+  benchmark.runCommand("compute Grafen", [&]() { return new ComputeGrafenCommand(doc, 0.5); });
+  benchmark.runCommand("convert to clock tree", [&]() { return new ConvertToClockTreeCommand(doc); });
+  benchmark.runCommand("swap", [&]() {
+    int id1 = doc->tree().getRootNode()->getSon(0)->getId();
+    int id2 = doc->tree().getRootNode()->getSon(1)->getId();
+    return new SwapCommand(doc, rootId, 0, 1, id1, id2);
+  });
+  benchmark.runCommand("order", [&]() { return new OrderCommand(doc, rootId, true); });
+  benchmark.runCommand("reroot", [&]() { return new RerootCommand(doc, innerId); });
+  benchmark.runCommand("outgroup", [&]() { return new OutgroupCommand(doc, leafId); });
+  benchmark.runCommand("midpoint rooting", [&]() { return new MidpointRootingCommand(doc, "Sum of squares"); });
+  benchmark.runCommand("unresolve", [&]() { return new UnresolveUnsupportedNodesCommand(doc, 50.); });
+  benchmark.runCommand("delete subtree", [&]() { return new DeleteSubtreeCommand(doc, innerId); });
+  benchmark.runCommand("insert subtree at node", [&]() {
+    return new InsertSubtreeAtNodeCommand(doc, leafId, TreeTemplateTools::cloneSubtree<Node>(*doc->getNode(leafId)));
+  });
+  benchmark.runCommand("insert subtree on branch", [&]() {
+    return new InsertSubtreeOnBranchCommand(doc, leafId, TreeTemplateTools::cloneSubtree<Node>(*doc->getNode(leafId)));
+  });
+  benchmark.runCommand("change branch length", [&]() { return new ChangeBranchLengthCommand(doc, leafId, 1.); });
+  benchmark.runCommand("change node name", [&]() { return new ChangeNodeNameCommand(doc, leafId, "renamed"); });
+  benchmark.runCommand("change node property", [&]() { return new ChangeNodePropertyCommand(doc, leafId, "state", "E"); });
+  benchmark.runCommand("sample subtree", [&]() { return new SampleSubtreeCommand(doc, rootId, static_cast<unsigned int>(numberOfLeaves / 2)); });
+  benchmark.runCommand("snapshot", [&]() { return new SnapCommand(doc); });
+
+  // Data, one row per leaf:
+  stringstream csv;
+  csv << "name,trait,newName" << endl;
+  for (size_t i = 0; i < numberOfLeaves; ++i)
+  {
+    csv << "L" << i << "," << (i % 7) << ",N" << i << endl;
+  }
+  shared_ptr<DataTable> table;
+  benchmark.run("read table", [&]() { table = DataTable::read(csv, ",", true, -1); });
+  if (table)
+  {
+    benchmark.runCommand("translate names", [&]() { return new TranslateNodeNamesCommand(doc, *table, 0, 2); });
+    benchmark.runCommand("attach data", [&]() { return new AttachDataCommand(doc, *table, 0, true); });
+  }
+  benchmark.runCommand("add data", [&]() { return new AddDataCommand(doc, "added"); });
+  benchmark.runCommand("rename data", [&]() { return new RenameDataCommand(doc, "value", "renamed"); });
+  benchmark.runCommand("remove data", [&]() { return new RemoveDataCommand(doc, "value"); });
+  benchmark.runCommand("naive ASR", [&]() { return new NaiveAsrCommand(doc, vector<string>(1, "state")); });
+  benchmark.runCommand("Fitch ASR", [&]() { return new ParsimonyAsrCommand(doc, vector<string>(1, "state")); });
+  benchmark.runCommand("set names from data", [&]() { return new SetNamesFromDataCommand(doc, "state", true); });
+
+  // Input and output:
+  string nhxPath = QDir::temp().filePath("phyview-bench.nhx").toStdString();
+  if (benchmark.run("write NHX", [&]() { PhyView::writeTree(doc->tree(), nhxPath, IOTreeFactory::NHX_FORMAT); }))
+  {
+    benchmark.run("read NHX", [&]() {
+      ifstream in(nhxPath.c_str(), ios::in | ios::binary);
+      TreeLoader::readTree(in, IOTreeFactory::NHX_FORMAT);
+    });
+  }
+  QFile::remove(QString::fromStdString(nhxPath));
+  string binaryPath = QDir::temp().filePath("phyview-bench.bpv").toStdString();
+  if (benchmark.run("write binary", [&]() { PhyView::writeTree(doc->tree(), binaryPath, BinaryTreeFormat::FORMAT); }))
+    benchmark.run("read binary", [&]() { BinaryTreeFormat::read(binaryPath); });
+  QFile::remove(QString::fromStdString(binaryPath));
+
+  // Views:
+  NodeTableModel model(doc);
+  benchmark.run("update table", [&]() { model.reset(); });
+  if (render)
+  {
+    TreeCanvas canvas;
+    benchmark.run("lay out and draw", [&]() {
+      canvas.setTreeDrawing(PhylogramPlot());
+      canvas.setTree(doc->getTree());
+    });
+    string pngPath = QDir::temp().filePath("phyview-bench.png").toStdString();
+    benchmark.run("export PNG", [&]() {
+      ImageExportDialog::renderToPng(canvas.scene(), QString::fromStdString(pngPath), 2048, 2048, false, true);
+    });
+    QFile::remove(QString::fromStdString(pngPath));
+  }
+}
+
+void writeResults(ostream& out, const vector<Result>& results)
+{
+  out << "{\"results\":[" << endl;
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    const Result& result = results[i];
+    out << "{\"shape\":" << toJson(result.shape)
+        << ",\"leaves\":" << result.numberOfLeaves
+        << ",\"operation\":" << toJson(result.operation)
+        << ",\"seconds\":" << result.seconds
+        << ",\"peakMemory\":" << result.peakMemory;
+    if (!result.error.empty())
+      out << ",\"error\":" << toJson(result.error);
+    out << "}" << (i + 1 < results.size() ? "," : "") << endl;
+  }
+  out << "]}" << endl;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication app(argc, argv);
+
+  QStringList shapes = QStringList() << "balanced" << "caterpillar" << "random";
+  vector<size_t> sizes = { 1000, 10000, 100000, 1000000, 10000000 };
+  unsigned int seed = 42;
+  bool render = true;
+  bool deep = false;
+  QString outputPath;
+  QStringList args = app.arguments();
+  for (int i = 1; i < args.size(); ++i)
+  {
+    bool hasValue = i < args.size() - 1;
+    if (args[i] == "--shapes" && hasValue)
+      shapes = args[++i].split(",");
+    else if (args[i] == "--sizes" && hasValue)
+    {
+      sizes.clear();
+      for (const auto& size : args[++i].split(","))
+      {
+        sizes.push_back(static_cast<size_t>(size.toDouble()));
+      }
+    }
+    else if (args[i] == "--seed" && hasValue)
+      seed = args[++i].toUInt();
+    else if (args[i] == "--output" && hasValue)
+      outputPath = args[++i];
+    else if (args[i] == "--no-render")
+      render = false;
+    else if (args[i] == "--deep")
+      deep = true;
+    else
+    {
+      cerr << "Usage: phyview-bench [--shapes balanced,caterpillar,random] [--sizes 1000,10000,...] [--seed n] [--no-render] [--deep] [--output file]" << endl;
+      return 1;
+    }
+  }
+
+  vector<Result> results;
+  TreeGenerator generator(seed);
+  for (const auto& shape : shapes)
+  {
+    for (size_t size : sizes)
+    {
+      if (size < 4 || (shape == "caterpillar" && size > 10000 && !deep))
+        continue;
+      Benchmark benchmark(shape.toStdString(), size, results);
+      SyntheticTree synthetic;
+      if (benchmark.run("generate", [&]() { synthetic = generator.generate(shape.toStdString(), size); }))
+        runAll(synthetic, benchmark, render);
+    }
+  }
+
+  if (outputPath.isEmpty())
+  {
+    writeResults(cout, results);
+  }
+  else
+  {
+    ofstream out(outputPath.toStdString().c_str(), ios::out);
+    writeResults(out, results);
+    if (!out)
+    {
+      cerr << "Error while writing " << outputPath.toStdString() << endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,185 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "PhyView.h"
+#include "BatchRunner.h"
+#include "Profiler.h"
+
+// From Qt:
+#include <QApplication>
+#include <QMessageBox>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Io/IoTreeFactory.h>
+
+// From the STL:
+#include <iostream>
+
+using namespace bpp;
+using namespace std;
+
+// This class is necessary to reimplement the notify method, in order to catch any foreign exception.
+class PhyViewApplication :
+  public QApplication
+{
+public:
+  PhyViewApplication(int& argc, char* argv[]) :
+    QApplication(argc, argv) {}
+
+public:
+  bool notify(QObject* receiver_, QEvent* event_)
+  {
+    try
+    {
+      return QApplication::notify(receiver_, event_);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "std::exception was caught" << std::endl;
+      std::cerr << ex.what() << endl;
+      QMessageBox msgBox;
+      msgBox.setText(ex.what());
+      msgBox.exec();
+    }
+    return false;
+  }
+};
+
+/**
+ * @brief Run a script on tree files, without display. See BatchRunner for the options.
+ */
+int runBatch(const QStringList& args)
+{
+  QString script, outputDir = "phyview-output";
+  unsigned int threads = 0;
+  string format = IOTreeFactory::NEWICK_FORMAT;
+  string tracePath;
+  QStringList files;
+  for (int i = 1; i < args.size(); ++i)
+  {
+    bool hasValue = i < args.size() - 1;
+    if (args[i] == "--batch" && hasValue)
+      script = args[++i];
+    else if (args[i] == "--trace" && hasValue)
+      tracePath = args[++i].toStdString();
+    else if (args[i] == "--output" && hasValue)
+      outputDir = args[++i];
+    else if (args[i] == "--threads" && hasValue)
+      threads = args[++i].toUInt();
+    else if (args[i] == "--nhx")
+      format = IOTreeFactory::NHX_FORMAT;
+    else if (args[i] == "--nexus")
+      format = IOTreeFactory::NEXUS_FORMAT;
+    else if (args[i] == "--newick")
+      format = IOTreeFactory::NEWICK_FORMAT;
+    else if (args[i].startsWith("--"))
+    {
+      cerr << "Unknown or incomplete option: " << args[i].toStdString() << endl;
+      return 1;
+    }
+    else
+      files.append(args[i]);
+  }
+  if (!tracePath.empty())
+    Profiler::instance().startTrace();
+  int status = 1;
+  try
+  {
+    BatchRunner runner(script, format, outputDir, threads);
+    unsigned int failures = runner.run(files);
+    cout << files.size() - static_cast<int>(failures) << " file(s) processed, " << failures << " failure(s)." << endl;
+    status = failures > 0 ? 2 : 0;
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+  }
+  if (!tracePath.empty())
+  {
+    try
+    {
+      Profiler::instance().writeTrace(tracePath);
+    }
+    catch (exception& e)
+    {
+      cerr << e.what() << endl;
+    }
+  }
+  return status;
+}
+
+int main(int argc, char* argv[])
+{
+  // Batch mode renders images without a display:
+  bool batch = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (string(argv[i]) == "--batch")
+      batch = true;
+  }
+  if (batch && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+
+  PhyViewApplication app(argc, argv);
+  if (batch)
+    return runBatch(app.arguments());
+
+  PhyView* phyview = new PhyView();
+  phyview->show();
+
+  // Parse command line arguments:
+  QStringList args = app.arguments();
+  string format = IOTreeFactory::NEWICK_FORMAT;
+  string tracePath;
+  // QTextCodec* codec = QTextCodec::codecForLocale(); Not supported in Qt5...
+  for (int i = 1; i < args.size(); ++i)
+  {
+    if (args[i] == "--trace")
+    {
+      if (i == args.size() - 1)
+      {
+        cerr << "You must specify a file after --trace tag." << endl;
+        return 1;
+      }
+      tracePath = args[++i].toStdString();
+      Profiler::instance().startTrace();
+    }
+    else if (args[i] == "--nhx")
+    {
+      format = IOTreeFactory::NHX_FORMAT;
+    }
+    else if (args[i] == "--nexus")
+    {
+      format = IOTreeFactory::NEWICK_FORMAT;
+    }
+    else if (args[i] == "--newick")
+    {
+      format = IOTreeFactory::NEWICK_FORMAT;
+      // } else if (args[i] == "--enc") {
+      //  if (i == args.size() - 1) {
+      //    cerr << "You must specify a text encoding after --enc tag." << endl;
+      //    exit(1);
+      //  }
+      //  ++i;
+      //  codec = QTextCodec::codecForName(args[i].toStdString().c_str());
+    }
+    else
+    {
+      phyview->readTree(args[i], format);
+    }
+  }
+  int status = app.exec();
+  if (!tracePath.empty())
+  {
+    try
+    {
+      Profiler::instance().writeTrace(tracePath);
+    }
+    catch (exception& e)
+    {
+      cerr << e.what() << endl;
+    }
+  }
+  return status;
+}
@@ -0,0 +1,125 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "PngWriter.h"
+
+// From bpp-core:
+#include <Bpp/Exceptions.h>
+
+using namespace bpp;
+using namespace std;
+
+namespace
+{
+void putUInt32(unsigned char* data, uint32_t value)
+{
+  data[0] = static_cast<unsigned char>(value >> 24);
+  data[1] = static_cast<unsigned char>(value >> 16);
+  data[2] = static_cast<unsigned char>(value >> 8);
+  data[3] = static_cast<unsigned char>(value);
+}
+}
+
+PngWriter::PngWriter(const string& path, unsigned int width, unsigned int height, bool alpha) :
+  out_(path.c_str(), ios::out | ios::binary),
+  width_(width),
+  height_(height),
+  rowsWritten_(0),
+  alpha_(alpha),
+  stream_(),
+  row_(1 + static_cast<size_t>(width) * (alpha ? 4 : 3)),
+  buffer_(1 << 16)
+{
+  if (!out_)
+    throw Exception("PngWriter. Could not open file for writing: " + path);
+  if (width == 0 || height == 0 || width > 0x7fffffff || height > 0x7fffffff)
+    throw Exception("PngWriter. Invalid image size.");
+  if (deflateInit(&stream_, Z_DEFAULT_COMPRESSION) != Z_OK)
+    throw Exception("PngWriter. Could not initialize compression.");
+
+  static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  out_.write(reinterpret_cast<const char*>(signature), 8);
+  unsigned char header[13];
+  putUInt32(header, width);
+  putUInt32(header + 4, height);
+  header[8] = 8;               // Bits per channel
+  header[9] = alpha ? 6 : 2;   // RGBA or RGB
+  header[10] = 0;              // Deflate
+  header[11] = 0;              // Adaptive filtering
+  header[12] = 0;              // No interlacing
+  writeChunk_("IHDR", header, 13);
+}
+
+PngWriter::~PngWriter()
+{
+  deflateEnd(&stream_);
+}
+
+void PngWriter::write(const QImage& band)
+{
+  if (static_cast<unsigned int>(band.width()) != width_)
+    throw Exception("PngWriter::write. Band width does not match the image width.");
+  if (rowsWritten_ + static_cast<unsigned int>(band.height()) > height_)
+    throw Exception("PngWriter::write. Too many rows.");
+  // Alpha is not premultiplied in PNG files:
+  QImage image = band.convertToFormat(alpha_ ? QImage::Format_RGBA8888 : QImage::Format_RGB888);
+  size_t rowSize = row_.size() - 1;
+  for (int y = 0; y < image.height(); ++y)
+  {
+    // Filter type 0 (none):
+    row_[0] = 0;
+    const unsigned char* line = image.constScanLine(y);
+    copy(line, line + rowSize, row_.begin() + 1);
+    deflate_(row_.data(), row_.size(), Z_NO_FLUSH);
+    ++rowsWritten_;
+  }
+  if (!out_)
+    throw Exception("PngWriter::write. Error while writing file.");
+}
+
+void PngWriter::close()
+{
+  if (rowsWritten_ != height_)
+    throw Exception("PngWriter::close. Not all rows have been written.");
+  deflate_(0, 0, Z_FINISH);
+  writeChunk_("IEND", 0, 0);
+  out_.close();
+  if (!out_)
+    throw Exception("PngWriter::close. Error while writing file.");
+}
+
+void PngWriter::deflate_(const unsigned char* data, size_t size, int flush)
+{
+  stream_.next_in = const_cast<Bytef*>(data);
+  stream_.avail_in = static_cast<uInt>(size);
+  int status;
+  do
+  {
+    stream_.next_out = buffer_.data();
+    stream_.avail_out = static_cast<uInt>(buffer_.size());
+    status = deflate(&stream_, flush);
+    if (status == Z_STREAM_ERROR)
+      throw Exception("PngWriter. Compression error.");
+    size_t produced = buffer_.size() - stream_.avail_out;
+    if (produced > 0)
+      writeChunk_("IDAT", buffer_.data(), produced);
+  }
+  while (stream_.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+}
+
+void PngWriter::writeChunk_(const char* type, const unsigned char* data, size_t size)
+{
+  unsigned char word[4];
+  putUInt32(word, static_cast<uint32_t>(size));
+  out_.write(reinterpret_cast<const char*>(word), 4);
+  out_.write(type, 4);
+  uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+  if (size > 0)
+  {
+    out_.write(reinterpret_cast<const char*>(data), static_cast<streamsize>(size));
+    crc = crc32(crc, data, static_cast<uInt>(size));
+  }
+  putUInt32(word, static_cast<uint32_t>(crc));
+  out_.write(reinterpret_cast<const char*>(word), 4);
+}
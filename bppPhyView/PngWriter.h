@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _PNGWRITER_H_
+#define _PNGWRITER_H_
+
+// From Qt:
+#include <QImage>
+
+// From the STL:
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+/**
+ * @brief Write a PNG file one band of rows at a time.
+ *
+ * Rows are compressed and written as soon as they are given, so that the full image
+ * never has to be held in memory. Images are 8 bits per channel RGB, or RGBA if an
+ * alpha channel is requested.
+ */
+class PngWriter
+{
+private:
+  std::ofstream out_;
+  unsigned int width_;
+  unsigned int height_;
+  unsigned int rowsWritten_;
+  bool alpha_;
+  z_stream stream_;
+  std::vector<unsigned char> row_;
+  std::vector<unsigned char> buffer_;
+
+public:
+  /**
+   * @brief Create the file and write the PNG header.
+   *
+   * @throw Exception If the file cannot be written.
+   */
+  PngWriter(const std::string& path, unsigned int width, unsigned int height, bool alpha);
+
+  ~PngWriter();
+
+private:
+  PngWriter(const PngWriter&);
+  PngWriter& operator=(const PngWriter&);
+
+public:
+  /**
+   * @brief Append the rows of an image, which must have the width of the file.
+   */
+  void write(const QImage& band);
+
+  /**
+   * @brief Write the end of the file. All rows must have been written.
+   */
+  void close();
+
+  unsigned int getNumberOfRowsWritten() const { return rowsWritten_; }
+
+private:
+  void deflate_(const unsigned char* data, size_t size, int flush);
+
+  void writeChunk_(const char* type, const unsigned char* data, size_t size);
+};
+
+#endif // _PNGWRITER_H_
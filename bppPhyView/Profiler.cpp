@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "Profiler.h"
+
+#include <Bpp/Exceptions.h>
+
+// From the STL:
+#include <cstdio>
+#include <fstream>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+using namespace bpp;
+using namespace std;
+
+namespace
+{
+string toJson(const string& text)
+{
+  string json = "\"";
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      json += '\\';
+      json += c;
+    }
+    else if (static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+      json += escaped;
+    }
+    else
+    {
+      json += c;
+    }
+  }
+  return json + "\"";
+}
+}
+
+Profiler::Profiler() :
+  mutex_(),
+  clock_(),
+  recent_(),
+  maxNumberOfRecentRecords_(500),
+  trace_(),
+  tracing_(false),
+  threads_(),
+  revision_(0)
+{
+  clock_.start();
+}
+
+Profiler& Profiler::instance()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::add(const string& name, const string& category, qint64 start, qint64 duration, qint64 memoryDelta)
+{
+  lock_guard<mutex> lock(mutex_);
+  auto it = threads_.find(this_thread::get_id());
+  if (it == threads_.end())
+    it = threads_.insert(make_pair(this_thread::get_id(), static_cast<unsigned int>(threads_.size()))).first;
+  Record record = { name, category, start, duration, memoryDelta, it->second };
+  if (tracing_)
+    trace_.push_back(record);
+  recent_.push_back(record);
+  if (recent_.size() > maxNumberOfRecentRecords_)
+    recent_.pop_front();
+  ++revision_;
+}
+
+vector<Profiler::Record> Profiler::getRecentRecords() const
+{
+  lock_guard<mutex> lock(mutex_);
+  return vector<Record>(recent_.begin(), recent_.end());
+}
+
+unsigned long Profiler::getRevision() const
+{
+  lock_guard<mutex> lock(mutex_);
+  return revision_;
+}
+
+void Profiler::clear()
+{
+  lock_guard<mutex> lock(mutex_);
+  recent_.clear();
+  trace_.clear();
+  ++revision_;
+}
+
+void Profiler::startTrace()
+{
+  lock_guard<mutex> lock(mutex_);
+  tracing_ = true;
+}
+
+bool Profiler::isTracing() const
+{
+  lock_guard<mutex> lock(mutex_);
+  return tracing_;
+}
+
+void Profiler::writeTrace(const string& path) const
+{
+  vector<Record> records;
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (tracing_)
+      records = trace_;
+    else
+      records.assign(recent_.begin(), recent_.end());
+  }
+  ofstream out(path.c_str(), ios::out);
+  if (!out)
+    throw IOException("Profiler::writeTrace. Cannot open file " + path);
+  // Complete events ("X"), with times in microseconds:
+  out << "{\"traceEvents\":[" << endl;
+  for (size_t i = 0; i < records.size(); ++i)
+  {
+    const Record& record = records[i];
+    out << "{\"name\":" << toJson(record.name)
+        << ",\"cat\":" << toJson(record.category)
+        << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << record.thread
+        << ",\"ts\":" << record.start
+        << ",\"dur\":" << record.duration
+        << ",\"args\":{\"memoryDelta\":" << record.memoryDelta << "}}"
+        << (i + 1 < records.size() ? "," : "") << endl;
+  }
+  out << "],\"displayTimeUnit\":\"ms\"}" << endl;
+  if (!out)
+    throw IOException("Profiler::writeTrace. Error while writing file " + path);
+}
+
+qint64 Profiler::getMemoryUsage()
+{
+#ifdef __linux__
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (!statm)
+    return 0;
+  long size = 0, resident = 0;
+  int n = fscanf(statm, "%ld %ld", &size, &resident);
+  fclose(statm);
+  return n == 2 ? static_cast<qint64>(resident) * sysconf(_SC_PAGESIZE) : 0;
+#else
+  return 0;
+#endif
+}
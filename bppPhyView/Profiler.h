@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+// From Qt:
+#include <QElapsedTimer>
+
+// From the STL:
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Collects the duration and memory change of operations, from all threads.
+ *
+ * Operations are timed with ProfileProbe objects. The most recent ones are kept for
+ * display. When tracing is on, all of them are kept, until they are written as a
+ * Chrome trace-event JSON file (to be opened with chrome://tracing or Perfetto).
+ *
+ * Memory changes are differences of the resident set size of the process, where
+ * it is available (Linux). Probes read it twice, so they are meant for operations
+ * such as commands, view updates and I/O, not for inner loops.
+ */
+class Profiler
+{
+public:
+  struct Record
+  {
+    std::string name;
+    std::string category;
+    // In microseconds, since the creation of the profiler:
+    qint64 start;
+    qint64 duration;
+    qint64 memoryDelta;
+    unsigned int thread;
+  };
+
+private:
+  mutable std::mutex mutex_;
+  QElapsedTimer clock_;
+  std::deque<Record> recent_;
+  size_t maxNumberOfRecentRecords_;
+  std::vector<Record> trace_;
+  bool tracing_;
+  std::map<std::thread::id, unsigned int> threads_;
+  unsigned long revision_;
+
+private:
+  Profiler();
+
+public:
+  static Profiler& instance();
+
+public:
+  /**
+   * @return The time elapsed since the creation of the profiler, in microseconds.
+   */
+  qint64 now() const { return clock_.nsecsElapsed() / 1000; }
+
+  void add(const std::string& name, const std::string& category, qint64 start, qint64 duration, qint64 memoryDelta);
+
+  std::vector<Record> getRecentRecords() const;
+
+  /**
+   * @return A number which changes each time a record is added, or records are cleared.
+   */
+  unsigned long getRevision() const;
+
+  void clear();
+
+  /**
+   * @brief Keep all records from now on, and not only the recent ones.
+   */
+  void startTrace();
+
+  bool isTracing() const;
+
+  /**
+   * @brief Write all traced records, or the recent ones if tracing is off, in the Chrome trace-event format.
+   *
+   * @throw Exception If the file cannot be written.
+   */
+  void writeTrace(const std::string& path) const;
+
+  /**
+   * @return The resident set size of the process, in bytes, or 0 if it is not available.
+   */
+  static qint64 getMemoryUsage();
+};
+
+/**
+ * @brief Times the scope it is declared in, and records it in the profiler.
+ */
+class ProfileProbe
+{
+private:
+  std::string name_;
+  std::string category_;
+  qint64 start_;
+  qint64 memory_;
+
+public:
+  ProfileProbe(const std::string& name, const std::string& category) :
+    name_(name),
+    category_(category),
+    start_(Profiler::instance().now()),
+    memory_(Profiler::getMemoryUsage())
+  {}
+
+  ProfileProbe(const ProfileProbe&) = delete;
+  ProfileProbe& operator=(const ProfileProbe&) = delete;
+
+  ~ProfileProbe()
+  {
+    Profiler& profiler = Profiler::instance();
+    profiler.add(name_, category_, start_, profiler.now() - start_, Profiler::getMemoryUsage() - memory_);
+  }
+};
+
+#endif // _PROFILER_H_
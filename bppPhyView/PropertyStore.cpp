@@ -0,0 +1,186 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "PropertyStore.h"
+#include "ValuePool.h"
+
+#include <Bpp/Exceptions.h>
+#include <Bpp/Numeric/Number.h>
+
+// From the STL:
+#include <algorithm>
+
+using namespace std;
+
+vector<int> PropertyColumn::getNodeIds() const
+{
+  vector<int> ids;
+  ids.reserve(numberOfValues_);
+  for (size_t i = 0; i < codes_.size(); ++i)
+  {
+    if (codes_[i] >= 0)
+      ids.push_back(static_cast<int>(i));
+  }
+  return ids;
+}
+
+void PropertyColumn::set(int id, const Clonable* property)
+{
+  if (id < 0)
+    throw Exception("PropertyColumn::set. Negative node id.");
+  size_t i = static_cast<size_t>(id);
+  if (!property)
+  {
+    if (hasValue(id))
+    {
+      codes_[i] = -1;
+      --numberOfValues_;
+    }
+    return;
+  }
+
+  Type type = OTHER;
+  const string* text = SharedString::getText(property);
+  double number = 0.;
+  if (text)
+  {
+    type = STRING;
+  }
+  else if (auto d = dynamic_cast<const Number<double>*>(property))
+  {
+    type = NUMBER;
+    number = d->getValue();
+  }
+  else if (auto n = dynamic_cast<const Number<int>*>(property))
+  {
+    type = NUMBER;
+    number = static_cast<double>(n->getValue());
+  }
+
+  bool replaced = hasValue(id);
+  if (numberOfValues_ == (replaced ? 1u : 0u))
+  {
+    type_ = type;
+  }
+  else if (type != type_ && type_ != OTHER)
+  {
+    // Mixed types, values are only available from the nodes:
+    type_ = OTHER;
+    numbers_.clear();
+    texts_.clear();
+    textCodes_.clear();
+    for (auto& code : codes_)
+    {
+      if (code >= 0)
+        code = 0;
+    }
+  }
+
+  if (i >= codes_.size())
+    codes_.resize(max(i + 1, codes_.size() * 2), -1);
+  if (!replaced)
+    ++numberOfValues_;
+  if (type_ == STRING)
+  {
+    auto it = textCodes_.find(*text);
+    if (it == textCodes_.end())
+    {
+      it = textCodes_.insert(make_pair(*text, static_cast<int32_t>(texts_.size()))).first;
+      texts_.push_back(*text);
+    }
+    codes_[i] = it->second;
+  }
+  else if (type_ == NUMBER)
+  {
+    numbers_.resize(codes_.size(), 0.);
+    codes_[i] = 0;
+    numbers_[i] = number;
+  }
+  else
+  {
+    codes_[i] = 0;
+  }
+}
+
+void PropertyColumn::swap(PropertyColumn& column)
+{
+  std::swap(type_, column.type_);
+  codes_.swap(column.codes_);
+  numbers_.swap(column.numbers_);
+  texts_.swap(column.texts_);
+  textCodes_.swap(column.textCodes_);
+  std::swap(numberOfValues_, column.numberOfValues_);
+}
+
+void PropertyStore::build(const Node& root)
+{
+  clear();
+  vector<const Node*> stack(1, &root);
+  while (!stack.empty())
+  {
+    const Node* node = stack.back();
+    stack.pop_back();
+    for (const auto& property : node->getNodePropertyNames())
+    {
+      columns_[property].set(node->getId(), node->getNodeProperty(property));
+    }
+    for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+    {
+      stack.push_back(node->getSon(i));
+    }
+  }
+  built_ = true;
+}
+
+void PropertyStore::clear()
+{
+  columns_.clear();
+  built_ = false;
+}
+
+void PropertyStore::update(const Node& node, const string& property)
+{
+  if (!built_)
+    return;
+  if (node.hasNodeProperty(property))
+  {
+    columns_[property].set(node.getId(), node.getNodeProperty(property));
+  }
+  else
+  {
+    auto it = columns_.find(property);
+    if (it == columns_.end())
+      return;
+    it->second.set(node.getId(), 0);
+    if (it->second.getNumberOfValues() == 0)
+      columns_.erase(it);
+  }
+}
+
+const PropertyColumn& PropertyStore::getColumn(const string& property) const
+{
+  auto it = columns_.find(property);
+  if (it == columns_.end())
+    throw Exception("PropertyStore::getColumn. No property " + property + ".");
+  return it->second;
+}
+
+vector<string> PropertyStore::getColumnNames() const
+{
+  vector<string> names;
+  for (const auto& column : columns_)
+  {
+    names.push_back(column.first);
+  }
+  return names;
+}
+
+void PropertyStore::renameColumn(const string& oldName, const string& newName)
+{
+  auto it = columns_.find(oldName);
+  if (it == columns_.end() || oldName == newName)
+    return;
+  columns_[newName].swap(it->second);
+  columns_.erase(oldName);
+}
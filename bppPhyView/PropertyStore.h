@@ -0,0 +1,146 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _PROPERTYSTORE_H_
+#define _PROPERTYSTORE_H_
+
+#include <Bpp/Clonable.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+
+// From the STL:
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief The values of one node property, in arrays indexed by node id.
+ *
+ * String values are coded as integers indexing the distinct texts of the column,
+ * numbers (Number<double> or Number<int>) are stored as doubles. A column mixing
+ * types, or holding other types, has type OTHER and no values: its property has
+ * to be read from the nodes.
+ */
+class PropertyColumn
+{
+public:
+  enum Type { STRING, NUMBER, OTHER };
+
+private:
+  Type type_;
+  // -1 for nodes without a value, otherwise a text index (STRING) or 0 (NUMBER):
+  std::vector<int32_t> codes_;
+  std::vector<double> numbers_;
+  std::vector<std::string> texts_;
+  std::unordered_map<std::string, int32_t> textCodes_;
+  size_t numberOfValues_;
+
+public:
+  PropertyColumn() :
+    type_(STRING),
+    codes_(),
+    numbers_(),
+    texts_(),
+    textCodes_(),
+    numberOfValues_(0)
+  {}
+
+public:
+  Type getType() const { return type_; }
+
+  bool hasValue(int id) const
+  {
+    return id >= 0 && static_cast<size_t>(id) < codes_.size() && codes_[static_cast<size_t>(id)] >= 0;
+  }
+
+  /**
+   * @return The code of the value of a node, -1 if it has none. For string columns,
+   * this is an index in getTexts().
+   */
+  int32_t getCode(int id) const { return hasValue(id) ? codes_[static_cast<size_t>(id)] : -1; }
+
+  const std::string& getText(int id) const { return texts_[static_cast<size_t>(codes_[static_cast<size_t>(id)])]; }
+
+  double getNumber(int id) const { return numbers_[static_cast<size_t>(id)]; }
+
+  /**
+   * @return The distinct texts of a string column. Texts no longer used are not removed.
+   */
+  const std::vector<std::string>& getTexts() const { return texts_; }
+
+  size_t getNumberOfValues() const { return numberOfValues_; }
+
+  /**
+   * @return The ids of all nodes with a value, in increasing order.
+   */
+  std::vector<int> getNodeIds() const;
+
+  /**
+   * @brief Set the value of a node from its property, or remove it if property is 0.
+   */
+  void set(int id, const Clonable* property);
+
+  void swap(PropertyColumn& column);
+};
+
+/**
+ * @brief Node properties of a document, by column.
+ *
+ * The nodes of the tree remain the reference, so that bpp-phyl functions and
+ * writers work unchanged: the store is built from them on first use, and is
+ * then kept up to date with the changes published by commands.
+ */
+class PropertyStore
+{
+private:
+  std::map<std::string, PropertyColumn> columns_;
+  bool built_;
+
+public:
+  PropertyStore() : columns_(), built_(false) {}
+
+public:
+  bool isBuilt() const { return built_; }
+
+  /**
+   * @brief Read all node properties of a (sub)tree.
+   */
+  void build(const Node& root);
+
+  /**
+   * @brief Forget everything. The store has to be built again before use.
+   */
+  void clear();
+
+  /**
+   * @brief Read a property of a node again after it has changed.
+   */
+  void update(const Node& node, const std::string& property);
+
+  bool hasColumn(const std::string& property) const { return columns_.find(property) != columns_.end(); }
+
+  /**
+   * @throw Exception If no node has this property.
+   */
+  const PropertyColumn& getColumn(const std::string& property) const;
+
+  std::vector<std::string> getColumnNames() const;
+
+  /**
+   * @brief Rename a column, without copying its values. Nodes are not modified.
+   */
+  void renameColumn(const std::string& oldName, const std::string& newName);
+
+  /**
+   * @brief Remove a column. Nodes are not modified.
+   */
+  void removeColumn(const std::string& property) { columns_.erase(property); }
+};
+
+#endif // _PROPERTYSTORE_H_
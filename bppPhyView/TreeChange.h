@@ -0,0 +1,92 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREECHANGE_H_
+#define _TREECHANGE_H_
+
+// From the STL:
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Describes what has been changed in the tree of a document.
+ *
+ * Changes other than topology ones list the ids of the nodes which were touched,
+ * so that views can restrict their update to them.
+ */
+class TreeChange
+{
+public:
+  enum Type {
+    TOPOLOGY = 1,
+    NAMES = 2,
+    LENGTHS = 4,
+    NODE_PROPERTIES = 8,
+    BRANCH_PROPERTIES = 16,
+    PROPERTIES_REMOVED = 32
+  };
+
+private:
+  int types_;
+  std::vector<int> nodeIds_;
+  std::set<std::string> properties_;
+  std::vector<std::pair<std::string, std::string>> renamedProperties_;
+
+public:
+  TreeChange(int types = TOPOLOGY) :
+    types_(types),
+    nodeIds_(),
+    properties_(),
+    renamedProperties_()
+  {}
+
+public:
+  void add(int type, int nodeId)
+  {
+    types_ |= type;
+    nodeIds_.push_back(nodeId);
+  }
+
+  void addProperty(const std::string& name) { properties_.insert(name); }
+
+  /**
+   * @brief Record that a node property was renamed on all nodes, or removed if newName is empty.
+   *
+   * Such properties are updated as a whole rather than node by node, and are not listed by getProperties().
+   */
+  void renameProperty(const std::string& oldName, const std::string& newName)
+  {
+    types_ |= NODE_PROPERTIES | PROPERTIES_REMOVED;
+    properties_.erase(oldName);
+    properties_.erase(newName);
+    renamedProperties_.push_back(std::make_pair(oldName, newName));
+  }
+
+  /**
+   * @brief Remove duplicated node ids.
+   */
+  void normalize()
+  {
+    std::sort(nodeIds_.begin(), nodeIds_.end());
+    nodeIds_.erase(std::unique(nodeIds_.begin(), nodeIds_.end()), nodeIds_.end());
+  }
+
+  bool has(int types) const { return (types_ & types) != 0; }
+
+  /**
+   * @return true if the tree has to be drawn again. Node properties are not displayed.
+   */
+  bool affectsDrawing() const { return has(TOPOLOGY | NAMES | LENGTHS | BRANCH_PROPERTIES); }
+
+  const std::vector<int>& getNodeIds() const { return nodeIds_; }
+
+  const std::set<std::string>& getProperties() const { return properties_; }
+
+  const std::vector<std::pair<std::string, std::string>>& getRenamedProperties() const { return renamedProperties_; }
+};
+
+#endif // _TREECHANGE_H_
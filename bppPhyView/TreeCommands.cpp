@@ -3,23 +3,290 @@
 // SPDX-License-Identifier: CECILL-2.1
 
 #include "TreeCommands.h"
+#include "ParsimonyAsr.h"
+#include "TreeTraversal.h"
+
+// From Qt:
+#include <QThread>
+
+// From the STL:
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
+namespace
+{
+QString describeAsr(const vector<string>& names, const QString& method)
+{
+  if (names.size() == 1)
+    return method + QString(" of variable '") + QString(names[0].c_str()) + QString("'.");
+  return method + QString(" of ") + QString::number(names.size()) + QString(" variables.");
+}
+}
+
+void AbstractCommand::doOrUndo(bool forward)
+{
+  ProfileProbe probe((forward ? "Do: " : "Undo: ") + text().toStdString(), "command");
+  UndoHistory& history = doc_->getUndoHistory();
+  if (spillOffset_ >= 0)
+    restore_();
+  history.touch(this);
+  apply_(forward);
+  doc_->modified(true);
+  doc_->updateAllViews(getChange_(forward));
+  history.enforceMemoryLimit(this);
+}
+
+bool AbstractCommand::spill()
+{
+  if (!spillable_ || spillOffset_ >= 0 || getPayloadMemoryUsage() == 0)
+    return false;
+  QByteArray data;
+  QDataStream out(&data, QIODevice::WriteOnly);
+  try
+  {
+    writePayload_(out);
+  }
+  catch (Exception& e)
+  {
+    // Some properties cannot be serialized, keep this command in memory.
+    spillable_ = false;
+    return false;
+  }
+  qint64 offset = doc_->getUndoHistory().store(data);
+  if (offset < 0)
+  {
+    spillable_ = false;
+    return false;
+  }
+  releasePayload_();
+  spillOffset_ = offset;
+  return true;
+}
+
+void AbstractCommand::restore_()
+{
+  QByteArray data = doc_->getUndoHistory().load(spillOffset_);
+  QDataStream in(data);
+  readPayload_(in);
+  spillOffset_ = -1;
+}
+
+shared_ptr<const Clonable> NodeEdit::read(const Node& node, Field field, const string& property)
+{
+  switch (field)
+  {
+  case NAME:
+    if (node.hasName())
+      return make_shared<BppString>(node.getName());
+    break;
+  case LENGTH:
+    if (node.hasDistanceToFather())
+      return make_shared<Number<double>>(node.getDistanceToFather());
+    break;
+  case NODE_PROPERTY:
+    if (node.hasNodeProperty(property))
+      return shared_ptr<const Clonable>(node.getNodeProperty(property)->clone());
+    break;
+  case BRANCH_PROPERTY:
+    if (node.hasBranchProperty(property))
+      return shared_ptr<const Clonable>(node.getBranchProperty(property)->clone());
+    break;
+  }
+  return nullptr;
+}
+
+void NodeEdit::write(Node& node, Field field, const string& property, const Clonable* value)
+{
+  switch (field)
+  {
+  case NAME:
+    if (value)
+      node.setName(dynamic_cast<const BppString*>(value)->toSTL());
+    else
+      node.deleteName();
+    break;
+  case LENGTH:
+    if (value)
+      node.setDistanceToFather(dynamic_cast<const Number<double>*>(value)->getValue());
+    else
+      node.deleteDistanceToFather();
+    break;
+  case NODE_PROPERTY:
+    if (value)
+      node.setNodeProperty(property, *value);
+    else
+      node.deleteNodeProperty(property);
+    break;
+  case BRANCH_PROPERTY:
+    if (value)
+      node.setBranchProperty(property, *value);
+    else
+      node.deleteBranchProperty(property);
+    break;
+  }
+}
+
+void AbstractEditCommand::record_(const Node& node, NodeEdit::Field field, const string& property, shared_ptr<const Clonable> after)
+{
+  NodeEdit edit;
+  edit.nodeId   = node.getId();
+  edit.field    = field;
+  edit.property = property;
+  edit.before   = NodeEdit::read(node, field, property);
+  edit.after    = after;
+  edits_.push_back(edit);
+}
+
+void AbstractEditCommand::apply_(bool forward)
+{
+  // When the same attribute is edited several times, undoing in reverse order restores the original value.
+  if (forward)
+  {
+    for (const auto& edit : edits_)
+    {
+      NodeEdit::write(*doc_->getNode(edit.nodeId), edit.field, edit.property, edit.after.get());
+    }
+  }
+  else
+  {
+    for (auto it = edits_.rbegin(); it != edits_.rend(); ++it)
+    {
+      NodeEdit::write(*doc_->getNode(it->nodeId), it->field, it->property, it->before.get());
+    }
+  }
+}
+
+TreeChange AbstractEditCommand::getChange_(bool forward) const
+{
+  TreeChange change(0);
+  for (const auto& edit : edits_)
+  {
+    switch (edit.field)
+    {
+    case NodeEdit::NAME:
+      change.add(TreeChange::NAMES, edit.nodeId);
+      break;
+    case NodeEdit::LENGTH:
+      change.add(TreeChange::LENGTHS, edit.nodeId);
+      break;
+    case NodeEdit::NODE_PROPERTY:
+    case NodeEdit::BRANCH_PROPERTY:
+      change.add(edit.field == NodeEdit::NODE_PROPERTY ? TreeChange::NODE_PROPERTIES : TreeChange::BRANCH_PROPERTIES, edit.nodeId);
+      change.addProperty(edit.property);
+      if (!(forward ? edit.after : edit.before))
+        change.add(TreeChange::PROPERTIES_REMOVED, edit.nodeId);
+      break;
+    }
+  }
+  change.normalize();
+  return change;
+}
+
+void AbstractEditCommand::recordLengths_(const function<void (TreeTemplate<Node>&)>& algorithm)
+{
+  TreeTemplate<Node>& tree = doc_->tree();
+  vector<Node*> nodes = TreeTraversal::postOrder(tree.rootNode());
+  vector<shared_ptr<const Clonable>> before(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    before[i] = NodeEdit::read(*nodes[i], NodeEdit::LENGTH, "");
+  }
+  algorithm(tree);
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    auto after = NodeEdit::read(*nodes[i], NodeEdit::LENGTH, "");
+    bool changed = (before[i] == nullptr) != (after == nullptr);
+    if (!changed && after)
+    {
+      changed = dynamic_cast<const Number<double>*>(before[i].get())->getValue() !=
+                dynamic_cast<const Number<double>*>(after.get())->getValue();
+    }
+    // Restore the original length, the new one will be set by redo():
+    NodeEdit::write(*nodes[i], NodeEdit::LENGTH, "", before[i].get());
+    if (changed)
+    {
+      NodeEdit edit;
+      edit.nodeId = nodes[i]->getId();
+      edit.field  = NodeEdit::LENGTH;
+      edit.before = before[i];
+      edit.after  = after;
+      edits_.push_back(edit);
+    }
+  }
+}
+
+size_t AbstractEditCommand::computePayloadMemoryUsage_() const
+{
+  size_t total = edits_.capacity() * sizeof(NodeEdit);
+  for (const auto& edit : edits_)
+  {
+    total += edit.property.capacity();
+    if (edit.before)
+      total += TreeSerializer::getMemoryUsage(edit.before.get());
+    if (edit.after)
+      total += TreeSerializer::getMemoryUsage(edit.after.get());
+  }
+  return total;
+}
+
+void AbstractEditCommand::writePayload_(QDataStream& out) const
+{
+  out << static_cast<quint32>(edits_.size());
+  for (const auto& edit : edits_)
+  {
+    out << static_cast<qint32>(edit.nodeId) << static_cast<quint8>(edit.field);
+    TreeSerializer::writeString(out, edit.property);
+    TreeSerializer::writeValue(out, edit.before.get());
+    TreeSerializer::writeValue(out, edit.after.get());
+  }
+}
+
+void AbstractEditCommand::readPayload_(QDataStream& in)
+{
+  // String node properties are read as plain strings, and shared through the pool again:
+  ValuePool& pool = doc_->getValuePool();
+  auto intern = [&pool](shared_ptr<const Clonable>& value) {
+    if (const string* text = SharedString::getText(value.get()))
+      value = make_shared<SharedString>(pool.get(*text));
+  };
+  quint32 n;
+  in >> n;
+  edits_.resize(n);
+  for (auto& edit : edits_)
+  {
+    qint32 id;
+    quint8 field;
+    in >> id >> field;
+    edit.nodeId   = id;
+    edit.field    = static_cast<NodeEdit::Field>(field);
+    edit.property = TreeSerializer::readString(in);
+    edit.before   = TreeSerializer::readValue(in);
+    edit.after    = TreeSerializer::readValue(in);
+    if (edit.field == NodeEdit::NODE_PROPERTY)
+    {
+      intern(edit.before);
+      intern(edit.after);
+    }
+  }
+}
+
 TranslateNodeNamesCommand::TranslateNodeNamesCommand(
     std::shared_ptr<TreeDocument> doc,
     const DataTable& table,
     unsigned int from, unsigned int to) :
-  AbstractCommand(QtTools::toQt("Translates nodes names from " + table.getColumnName(from) + " to " + table.getColumnName(to) + "."), doc)
+  AbstractEditCommand(QtTools::toQt("Translates nodes names from " + table.getColumnName(from) + " to " + table.getColumnName(to) + "."), doc)
 {
-  new_.reset(new TreeTemplate<Node>(*old_));
   // Build translation:
   map<string, string> tln;
   for (unsigned int i = 0; i < table.getNumberOfRows(); ++i)
   {
     tln[table(i, from)] = table(i, to);
   }
-  vector<Node*> nodes = new_->getNodes();
+  vector<Node*> nodes = TreeTraversal::postOrder(doc_->tree().rootNode());
   for (unsigned int i = 0; i < nodes.size(); i++)
   {
     if (nodes[i]->hasName())
@@ -27,7 +294,7 @@ TranslateNodeNamesCommand::TranslateNodeNamesCommand(
       map<string, string>::iterator it = tln.find(nodes[i]->getName());
       if (it != tln.end())
       {
-        nodes[i]->setName(it->second);
+        setName_(*nodes[i], it->second);
       }
     }
   }
@@ -37,152 +304,278 @@ AttachDataCommand::AttachDataCommand(
     std::shared_ptr<TreeDocument> doc,
     const DataTable& data,
     unsigned int index, bool useNames) :
-  AbstractCommand(QtTools::toQt("Attach data to tree."), doc)
-{
-  new_.reset(new TreeTemplate<Node>(*old_));
-  addProperties_(new_->getRootNode(), data, index, useNames);
-}
-
-void AttachDataCommand::addProperties_(Node* node, const DataTable& data, unsigned int index, bool useNames)
+  AbstractEditCommand(QtTools::toQt("Attach data to tree."), doc),
+  unmatchedKeys_(),
+  duplicatedKeys_()
 {
-  if (!useNames)
+  // Index the key column:
+  size_t nbRows = data.getNumberOfRows();
+  unordered_map<string, size_t> rows;
+  unordered_set<string> duplicated;
+  rows.reserve(nbRows);
+  for (size_t i = 0; i < nbRows; ++i)
   {
-    // Use id
-    string id = TextTools::toString(node->getId());
-    for (unsigned int i = 0; i < data.getNumberOfRows(); ++i)
+    auto res = rows.insert(make_pair(data(i, index), i));
+    if (!res.second)
     {
-      if (data(i, index) == id)
-      {
-        for (unsigned int j = 0; j < data.getNumberOfColumns(); ++j)
-        {
-          if (j != index)
-          {
-            node->setNodeProperty(data.getColumnName(j), BppString(data(i, j)));
-          }
-        }
-      }
+      if (duplicated.insert(data(i, index)).second)
+        duplicatedKeys_.push_back(data(i, index));
+      // The last row wins, as when rows were applied in order:
+      res.first->second = i;
     }
   }
-  else
+  vector<string> columnNames;
+  for (size_t j = 0; j < data.getNumberOfColumns(); ++j)
   {
-    // Use name:
-    if (node->hasName())
+    columnNames.push_back(data.getColumnName(j));
+  }
+
+  // Join with the nodes:
+  vector<bool> matched(nbRows, false);
+  for (auto* node : TreeTraversal::postOrder(doc_->tree().rootNode()))
+  {
+    string key;
+    if (!useNames)
+      key = TextTools::toString(node->getId());
+    else if (node->hasName())
+      key = node->getName();
+    else
+      continue;
+    auto it = rows.find(key);
+    if (it == rows.end())
+      continue;
+    size_t i = it->second;
+    matched[i] = true;
+    for (size_t j = 0; j < columnNames.size(); ++j)
     {
-      string name = node->getName();
-      for (unsigned int i = 0; i < data.getNumberOfRows(); ++i)
+      if (j != index)
       {
-        if (data(i, index) == name)
-        {
-          for (unsigned int j = 0; j < data.getNumberOfColumns(); ++j)
-          {
-            if (j != index)
-            {
-              node->setNodeProperty(data.getColumnName(j), BppString(data(i, j)));
-            }
-          }
-        }
+        setNodeProperty_(*node, columnNames[j], doc_->getValuePool().get(data(i, j)));
       }
     }
   }
-  for (unsigned int i = 0; i < node->getNumberOfSons(); ++i)
+  // Reported in the order of the table, rows overridden by a duplicated key excepted:
+  for (size_t i = 0; i < nbRows; ++i)
   {
-    addProperties_(node->getSon(i), data, index, useNames);
+    if (!matched[i] && rows.at(data(i, index)) == i)
+      unmatchedKeys_.push_back(data(i, index));
   }
 }
 
 AddDataCommand::AddDataCommand(
     std::shared_ptr<TreeDocument> doc,
     const QString& name) :
-  AbstractCommand(QString("Add data '") + name + QString("' to tree."), doc)
-{
-  new_.reset(new TreeTemplate<Node>(*old_));
-  addProperty_(new_->getRootNode(), name);
-}
-
-void AddDataCommand::addProperty_(Node* node, const QString& name)
+  AbstractEditCommand(QString("Add data '") + name + QString("' to tree."), doc)
 {
-  node->setNodeProperty(name.toStdString(), BppString(""));
-  for (unsigned int i = 0; i < node->getNumberOfSons(); ++i)
+  for (auto* node : TreeTraversal::postOrder(doc_->tree().rootNode()))
   {
-    addProperty_(node->getSon(i), name);
+    setNodeProperty_(*node, name.toStdString(), doc_->getValuePool().get(""));
   }
 }
 
 RemoveDataCommand::RemoveDataCommand(
     std::shared_ptr<TreeDocument> doc,
     const QString& name) :
-  AbstractCommand(QString("Remove data '") + name + QString("' from tree."), doc)
+  AbstractEditCommand(QString("Remove data '") + name + QString("' from tree."), doc),
+  name_(name.toStdString())
 {
-  new_.reset(new TreeTemplate<Node>(*old_));
-  removeProperty_(new_->getRootNode(), name);
+  // Only the nodes with a value are visited:
+  const PropertyStore& store = doc_->getPropertyStore();
+  if (!store.hasColumn(name_))
+    return;
+  for (int id : store.getColumn(name_).getNodeIds())
+  {
+    deleteNodeProperty_(*doc_->getNode(id), name_);
+  }
 }
 
-void RemoveDataCommand::removeProperty_(Node* node, const QString& name)
+TreeChange RemoveDataCommand::getChange_(bool forward) const
 {
-  node->deleteNodeProperty(name.toStdString());
-  for (unsigned int i = 0; i < node->getNumberOfSons(); ++i)
-  {
-    removeProperty_(node->getSon(i), name);
-  }
+  TreeChange change = AbstractEditCommand::getChange_(forward);
+  // Restored values are read node by node:
+  if (forward && !edits_.empty())
+    change.renameProperty(name_, "");
+  return change;
 }
 
 RenameDataCommand::RenameDataCommand(
     std::shared_ptr<TreeDocument> doc,
     const QString& oldName,
     const QString& newName) :
-  AbstractCommand(QString("Rename data '") + oldName + QString("' to '" + newName + "' from tree."), doc)
+  AbstractEditCommand(QString("Rename data '") + oldName + QString("' to '" + newName + "' from tree."), doc),
+  oldName_(oldName.toStdString()),
+  newName_(newName.toStdString()),
+  moved_(false),
+  nodeIds_()
 {
-  new_.reset(new TreeTemplate<Node>(*old_));
-  renameProperty_(new_->getRootNode(), oldName, newName);
+  const PropertyStore& store = doc_->getPropertyStore();
+  if (!store.hasColumn(oldName_) || oldName_ == newName_)
+    return;
+  if (!store.hasColumn(newName_))
+  {
+    moved_ = true;
+    return;
+  }
+  for (int id : store.getColumn(oldName_).getNodeIds())
+  {
+    const Node& node = *doc_->getNode(id);
+    setNodeProperty_(node, newName_, *node.getNodeProperty(oldName_));
+    deleteNodeProperty_(node, oldName_);
+  }
 }
 
-void RenameDataCommand::renameProperty_(Node* node, const QString& oldName, const QString& newName)
+void RenameDataCommand::apply_(bool forward)
 {
-  if (node->hasNodeProperty(oldName.toStdString()))
+  if (!moved_)
   {
-    Clonable* property = node->removeNodeProperty(oldName.toStdString());
-    node->setNodeProperty(newName.toStdString(), *property);
-    delete property;
+    AbstractEditCommand::apply_(forward);
+    return;
   }
-  for (unsigned int i = 0; i < node->getNumberOfSons(); ++i)
+  const string& from = forward ? oldName_ : newName_;
+  const string& to = forward ? newName_ : oldName_;
+  // The store is up to date with the tree between commands:
+  const PropertyStore& store = doc_->getPropertyStore();
+  nodeIds_ = store.hasColumn(from) ? store.getColumn(from).getNodeIds() : vector<int>();
+  for (int id : nodeIds_)
   {
-    renameProperty_(node->getSon(i), oldName, newName);
+    Node& node = *doc_->getNode(id);
+    node.setNodeProperty(to, *node.getNodeProperty(from));
+    node.deleteNodeProperty(from);
   }
 }
 
+TreeChange RenameDataCommand::getChange_(bool forward) const
+{
+  if (!moved_)
+    return AbstractEditCommand::getChange_(forward);
+  TreeChange change(0);
+  for (int id : nodeIds_)
+  {
+    change.add(TreeChange::NODE_PROPERTIES, id);
+  }
+  change.renameProperty(forward ? oldName_ : newName_, forward ? newName_ : oldName_);
+  return change;
+}
+
 NaiveAsrCommand::NaiveAsrCommand(
     std::shared_ptr<TreeDocument> doc,
-    const string& name) :
-  AbstractCommand(QString("Naive Ancestral State Reconstruction of variable '") + QString(name.c_str()) + QString("'."), doc)
+    const vector<string>& names) :
+  AbstractEditCommand(describeAsr(names, "Naive Ancestral State Reconstruction"), doc)
 {
-  new_.reset(new TreeTemplate<Node>(*old_));
-  auto state = asr_(new_->rootNode(), name);
-  new_->rootNode().setNodeProperty(name, BppString(state));
+  for (const auto& name : names)
+  {
+    auto state = asr_(doc_->tree().rootNode(), name);
+    setNodeProperty_(doc_->tree().rootNode(), name, doc_->getValuePool().get(state));
+  }
 }
 
-string NaiveAsrCommand::asr_(Node& node, const string& name)
+string NaiveAsrCommand::asr_(const Node& root, const string& name)
 {
-  if (node.isLeaf()) {
-    if (node.hasNodeProperty(name)) {
-      return dynamic_cast<const BppString*>(node.getNodeProperty(name))->toSTL();
-    } else {
-      return "";
+  // In post-order, the states of the sons of a node are the last ones on the stack:
+  vector<string> states;
+  for (const Node* node : TreeTraversal::postOrder(root))
+  {
+    if (node->isLeaf())
+    {
+      const string* state = node->hasNodeProperty(name) ? SharedString::getText(node->getNodeProperty(name)) : 0;
+      states.push_back(state ? *state : "");
+      continue;
     }
-  } else {
+    size_t first = states.size() - node->getNumberOfSons();
+    string ancestor = "";
+    bool consensus = true;
+    for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+    {
+      const string& state = states[first + i];
+      setNodeProperty_(*node->getSon(i), name, doc_->getValuePool().get(state));
+      if (state == "")
+        consensus = false;
+      else if (ancestor == "")
+        ancestor = state;
+      else if (ancestor != state)
+        consensus = false;
+    }
+    states.resize(first);
+    states.push_back(consensus ? ancestor : "");
+  }
+  return states.back();
+}
+
+ParsimonyAsrCommand::ParsimonyAsrCommand(
+    std::shared_ptr<TreeDocument> doc,
+    const vector<string>& names,
+    const vector<string>& alphabet,
+    const vector<double>& costs) :
+  AbstractEditCommand(describeAsr(names, costs.empty() ? "Fitch parsimony reconstruction" : "Sankoff parsimony reconstruction"), doc)
+{
+  ParsimonyAsr asr(doc_->tree().rootNode());
+  // Built here, as workers only read it:
+  const PropertyStore& store = doc_->getPropertyStore();
+  struct Result
+  {
     vector<string> states;
-    //We first call the function recursively on all subtrees:
-    for (size_t i = 0; i < node.getNumberOfSons(); ++i) {
-      auto state = asr_(node.son(i), name);
-      node.son(i).setNodeProperty(name, BppString(state));
-      states.push_back(state);
+    // The states to write, -1 for nodes left unchanged:
+    vector<int> reconstructed;
+    string error;
+  };
+  vector<Result> results(names.size());
+  atomic<size_t> next(0);
+  auto work = [&]() {
+    for (size_t j = next++; j < names.size(); j = next++)
+    {
+      Result& result = results[j];
+      try
+      {
+        result.states = alphabet;
+        bool hasColumn = store.hasColumn(names[j]) && store.getColumn(names[j]).getType() == PropertyColumn::STRING;
+        vector<int> observed = hasColumn ? asr.encode(store.getColumn(names[j]), result.states) : asr.encode(names[j], result.states);
+        if (result.states.empty())
+          throw Exception("ParsimonyAsrCommand. Variable '" + names[j] + "' has no value.");
+        if (!costs.empty() && result.states.size() > alphabet.size())
+          throw Exception("ParsimonyAsrCommand. State '" + result.states[alphabet.size()] + "' of variable '" + names[j] + "' is not in the cost matrix.");
+        if (costs.empty())
+          asr.fitch(observed, result.states.size(), result.reconstructed);
+        else
+          asr.sankoff(observed, costs, result.reconstructed);
+        for (size_t i = 0; i < observed.size(); ++i)
+        {
+          if (asr.isLeaf(i) || observed[i] >= 0)
+            result.reconstructed[i] = -1;
+        }
+      }
+      catch (exception& e)
+      {
+        result.error = e.what();
+      }
     }
-    string ancestor = "";
-    for (const auto& state : states) {
-      if (state == "") return "";
-      if (ancestor == "") ancestor = state;
-      else if (ancestor != state) return "";
+  };
+  // The calling thread is one of the workers:
+  size_t numberOfThreads = min(names.size(), static_cast<size_t>(max(1, QThread::idealThreadCount())));
+  vector<thread> workers;
+  for (size_t i = 1; i < numberOfThreads; ++i)
+  {
+    workers.push_back(thread(work));
+  }
+  work();
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  // Edits are recorded here, as this is not thread safe, all in one command so that they are undone at once:
+  ValuePool& pool = doc_->getValuePool();
+  for (size_t j = 0; j < names.size(); ++j)
+  {
+    Result& result = results[j];
+    if (!result.error.empty())
+      throw Exception(result.error);
+    for (size_t i = 0; i < result.reconstructed.size(); ++i)
+    {
+      if (result.reconstructed[i] >= 0)
+        setNodeProperty_(asr.getNode(i), names[j], pool.get(result.states[static_cast<size_t>(result.reconstructed[i])]));
     }
-    return ancestor;  
+    // Release memory as we go, as there may be many variables:
+    vector<int>().swap(result.reconstructed);
   }
 }
 
@@ -190,23 +583,20 @@ SetNamesFromDataCommand::SetNamesFromDataCommand(
     std::shared_ptr<TreeDocument> doc,
     const string& propertyName,
     bool innerNodesOnly) :
-  AbstractCommand(QString("Set names from variable '") + QString(propertyName.c_str()) + QString("'."), doc)
+  AbstractEditCommand(QString("Set names from variable '") + QString(propertyName.c_str()) + QString("'."), doc)
 {
-  new_.reset(new TreeTemplate<Node>(*old_));
-  auto nodes = new_->getNodes();
+  auto nodes = TreeTraversal::postOrder(doc_->tree().rootNode());
   for (auto* node : nodes) {
     if (node->hasNodeProperty(propertyName)) {
       if (node->isLeaf()) {
 	if (!innerNodesOnly) {
-	  string name = dynamic_cast<BppString*>(node->getNodeProperty(propertyName))->toSTL();
-	  node->setName(name);	
+	  string name = *SharedString::getText(node->getNodeProperty(propertyName));
+	  setName_(*node, name);	
         } // else do nothing
       } else {
-	string name = dynamic_cast<BppString*>(node->getNodeProperty(propertyName))->toSTL();
-	node->setName(name);	
+	string name = *SharedString::getText(node->getNodeProperty(propertyName));
+	setName_(*node, name);	
       }
     }
   }
 }
-
-
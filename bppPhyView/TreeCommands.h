@@ -6,15 +6,19 @@
 #define _COMMANDS_H_
 
 #include "TreeDocument.h"
+#include "TreeSerializer.h"
 
 #include <Bpp/Text/TextTools.h>
 #include <Bpp/Numeric/DataTable.h>
+#include <Bpp/Numeric/Number.h>
+#include <Bpp/BppString.h>
 
 // From bpp-phyl:
 #include <Bpp/Phyl/Tree/TreeTools.h>
 
 // From Qt:
 #include <QUndoCommand>
+#include <QDataStream>
 #include <QTime>
 
 // From bpp-qt:
@@ -22,210 +26,395 @@
 
 // From the STL:
 #include <vector>
-
-class AbstractCommand : public QUndoCommand
+#include <memory>
+#include <functional>
+
+/**
+ * @brief Base class for all undoable tree operations.
+ *
+ * Subclasses only implement apply_(), which performs the change (forward = true)
+ * or reverts it (forward = false) on the document tree.
+ *
+ * Commands register to the undo history of their document. Subclasses storing
+ * data implement the payload methods, which allow the history to move this data
+ * to disk when the memory limit of the document is exceeded.
+ */
+class AbstractCommand :
+  public QUndoCommand,
+  public SpillableCommand
 {
 protected:
   std::shared_ptr<TreeDocument> doc_;
-  std::shared_ptr<TreeTemplate<Node>> old_;
-  std::shared_ptr<TreeTemplate<Node>> new_;
+
+private:
+  qint64 spillOffset_;
+  bool spillable_;
+  mutable size_t payloadMemoryUsage_;
+  mutable bool payloadMemoryUsageKnown_;
 
 public:
   AbstractCommand(const QString& name, std::shared_ptr<TreeDocument> doc) :
     QUndoCommand(name),
     doc_(doc),
-    old_(new TreeTemplate<Node>(doc->tree())),
-    new_(nullptr)
+    spillOffset_(-1),
+    spillable_(true),
+    payloadMemoryUsage_(0),
+    payloadMemoryUsageKnown_(false)
+  {
+    doc_->getUndoHistory().add(this);
+  }
+
+  virtual ~AbstractCommand()
+  {
+    if (spillOffset_ >= 0)
+      doc_->getUndoHistory().release(spillOffset_);
+    doc_->getUndoHistory().remove(this);
+  }
+
+public:
+  void redo() { doOrUndo(true); }
+  void undo() { doOrUndo(false); }
+
+  virtual void doOrUndo(bool forward);
+
+  size_t getPayloadMemoryUsage() const
+  {
+    if (spillOffset_ >= 0)
+      return 0;
+    if (!payloadMemoryUsageKnown_)
+    {
+      payloadMemoryUsage_ = computePayloadMemoryUsage_();
+      payloadMemoryUsageKnown_ = true;
+    }
+    return payloadMemoryUsage_;
+  }
+
+  bool spill();
+
+protected:
+  virtual void apply_(bool forward) = 0;
+
+  /**
+   * @return What apply_() changes in the tree. By default, the whole tree is considered as changed.
+   */
+  virtual TreeChange getChange_(bool forward) const { return TreeChange(TreeChange::TOPOLOGY); }
+
+  virtual size_t computePayloadMemoryUsage_() const { return 0; }
+  virtual void writePayload_(QDataStream& out) const {}
+  virtual void readPayload_(QDataStream& in) {}
+  virtual void releasePayload_() {}
+
+private:
+  void restore_();
+};
+
+/**
+ * @brief Commands changing the topology of the tree.
+ *
+ * The modified tree is computed on a copy of the document tree at construction.
+ * redo() and undo() then swap it with the tree of the document, so that each
+ * command keeps a single extra tree.
+ */
+class AbstractSnapshotCommand : public AbstractCommand
+{
+protected:
+  std::shared_ptr<TreeTemplate<Node>> new_;
+
+public:
+  AbstractSnapshotCommand(const QString& name, std::shared_ptr<TreeDocument> doc) :
+    AbstractCommand(name, doc),
+    new_(copyTree_(doc->tree()))
   {}
 
-  virtual ~AbstractCommand() = default;
+  virtual ~AbstractSnapshotCommand() = default;
+
+private:
+  static std::shared_ptr<TreeTemplate<Node>> copyTree_(const TreeTemplate<Node>& tree)
+  {
+    ProfileProbe probe("Copy tree", "command");
+    return TreeTraversal::cloneTree(tree);
+  }
+
+protected:
+  void apply_(bool forward)
+  {
+    doc_->swapTree(new_);
+  }
+
+  size_t computePayloadMemoryUsage_() const { return TreeSerializer::getMemoryUsage(*new_); }
+  void writePayload_(QDataStream& out) const { TreeSerializer::writeTree(out, *new_); }
+  void readPayload_(QDataStream& in)
+  {
+    new_ = TreeSerializer::readTree(in);
+    doc_->getValuePool().intern(new_->rootNode());
+  }
+  void releasePayload_() { new_.reset(); }
+};
+
+/**
+ * @brief Records the change of one attribute of one node.
+ *
+ * Values are stored as BppString for names, Number<double> for branch lengths,
+ * and as the property itself otherwise. A null value means that the attribute is absent.
+ */
+struct NodeEdit
+{
+  enum Field { NAME, LENGTH, NODE_PROPERTY, BRANCH_PROPERTY };
+
+  int nodeId;
+  Field field;
+  std::string property;
+  std::shared_ptr<const Clonable> before;
+  std::shared_ptr<const Clonable> after;
+
+  static std::shared_ptr<const Clonable> read(const Node& node, Field field, const std::string& property);
+  static void write(Node& node, Field field, const std::string& property, const Clonable* value);
+};
+
+/**
+ * @brief Commands changing names, lengths or properties of nodes, without altering the topology.
+ *
+ * Only the edited values are stored, before and after the change,
+ * and are applied in place to the document tree.
+ * Subclasses register their changes at construction with the set/delete methods.
+ */
+class AbstractEditCommand : public AbstractCommand
+{
+protected:
+  std::vector<NodeEdit> edits_;
 
 public:
-  void redo() { doOrUndo(); }
-  void undo() { doOrUndo(); }
+  AbstractEditCommand(const QString& name, std::shared_ptr<TreeDocument> doc) :
+    AbstractCommand(name, doc),
+    edits_()
+  {}
+
+  virtual ~AbstractEditCommand() = default;
+
+protected:
+  void apply_(bool forward);
+
+  TreeChange getChange_(bool forward) const;
+
+  size_t computePayloadMemoryUsage_() const;
+  void writePayload_(QDataStream& out) const;
+  void readPayload_(QDataStream& in);
+  void releasePayload_() { std::vector<NodeEdit>().swap(edits_); }
 
-  virtual void doOrUndo()
+  void setName_(const Node& node, const std::string& name)
   {
-    doc_->setTree(*new_);
-    doc_->modified(true);
-    doc_->updateAllViews();
-    new_.swap(old_);
+    record_(node, NodeEdit::NAME, "", std::make_shared<BppString>(name));
   }
+
+  void setLength_(const Node& node, double length)
+  {
+    record_(node, NodeEdit::LENGTH, "", std::make_shared<Number<double>>(length));
+  }
+
+  void deleteLength_(const Node& node)
+  {
+    record_(node, NodeEdit::LENGTH, "", nullptr);
+  }
+
+  void setNodeProperty_(const Node& node, const std::string& property, const Clonable& value)
+  {
+    record_(node, NodeEdit::NODE_PROPERTY, property, std::shared_ptr<const Clonable>(value.clone()));
+  }
+
+  void deleteNodeProperty_(const Node& node, const std::string& property)
+  {
+    record_(node, NodeEdit::NODE_PROPERTY, property, nullptr);
+  }
+
+  void deleteBranchProperty_(const Node& node, const std::string& property)
+  {
+    record_(node, NodeEdit::BRANCH_PROPERTY, property, nullptr);
+  }
+
+  /**
+   * @brief Records all branch lengths modified by an algorithm working on a whole tree.
+   *
+   * The algorithm is run on the document tree, the modified lengths are recorded,
+   * and the original ones are put back until the command is (re)done.
+   */
+  void recordLengths_(const std::function<void (TreeTemplate<Node>&)>& algorithm);
+
+private:
+  void record_(const Node& node, NodeEdit::Field field, const std::string& property, std::shared_ptr<const Clonable> after);
 };
 
-class SetLengthCommand : public AbstractCommand
+class SetLengthCommand : public AbstractEditCommand
 {
 public:
   SetLengthCommand(std::shared_ptr<TreeDocument> doc, double length) :
-    AbstractCommand(QtTools::toQt("Set all lengths to " + TextTools::toString(length) + "."), doc)
+    AbstractEditCommand(QtTools::toQt("Set all lengths to " + TextTools::toString(length) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    new_->setBranchLengths(length);
+    recordLengths_([length](TreeTemplate<Node>& tree) { tree.setBranchLengths(length); });
   }
 };
 
-class DeleteLengthCommand : public AbstractCommand
+class DeleteLengthCommand : public AbstractEditCommand
 {
 public:
   DeleteLengthCommand(std::shared_ptr<TreeDocument> doc) :
-    AbstractCommand(QtTools::toQt("Delete all branch lengths."), doc)
+    AbstractEditCommand(QtTools::toQt("Delete all branch lengths."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    TreeTemplateTools::deleteBranchLengths(new_->rootNode());
+    recordLengths_([](TreeTemplate<Node>& tree) { TreeTemplateTools::deleteBranchLengths(tree.rootNode()); });
   }
 };
 
-class DeleteSupportValuesCommand : public AbstractCommand
+class DeleteSupportValuesCommand : public AbstractEditCommand
 {
 public:
   DeleteSupportValuesCommand(std::shared_ptr<TreeDocument> doc) :
-    AbstractCommand(QtTools::toQt("Delete all support values."), doc)
+    AbstractEditCommand(QtTools::toQt("Delete all support values."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    std::vector<std::string> properties;
-    properties.push_back(TreeTools::BOOTSTRAP);
-    TreeTemplateTools::deleteBranchProperties(new_->rootNode(), properties);
+    for (Node* node : TreeTraversal::postOrder(doc_->tree().rootNode()))
+    {
+      if (node->hasBranchProperty(TreeTools::BOOTSTRAP))
+        deleteBranchProperty_(*node, TreeTools::BOOTSTRAP);
+    }
   }
 };
 
 
-class InitGrafenCommand : public AbstractCommand
+class InitGrafenCommand : public AbstractEditCommand
 {
 public:
   InitGrafenCommand(std::shared_ptr<TreeDocument> doc) :
-    AbstractCommand("Init branch lengths (Grafen)", doc)
+    AbstractEditCommand("Init branch lengths (Grafen)", doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    TreeTools::initBranchLengthsGrafen(*new_);
+    recordLengths_([](TreeTemplate<Node>& tree) { TreeTools::initBranchLengthsGrafen(tree); });
   }
 };
 
-class ComputeGrafenCommand : public AbstractCommand
+class ComputeGrafenCommand : public AbstractEditCommand
 {
 public:
   ComputeGrafenCommand(std::shared_ptr<TreeDocument> doc, double power) :
-    AbstractCommand(QtTools::toQt("Compute branch lengths (Grafen), power=" + TextTools::toString(power) + "."), doc)
+    AbstractEditCommand(QtTools::toQt("Compute branch lengths (Grafen), power=" + TextTools::toString(power) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    TreeTools::computeBranchLengthsGrafen(*new_, power, false);
+    recordLengths_([power](TreeTemplate<Node>& tree) { TreeTools::computeBranchLengthsGrafen(tree, power, false); });
   }
 };
 
-class ConvertToClockTreeCommand : public AbstractCommand
+class ConvertToClockTreeCommand : public AbstractEditCommand
 {
 public:
   ConvertToClockTreeCommand(std::shared_ptr<TreeDocument> doc) :
-    AbstractCommand(QtTools::toQt("Convert to clock tree"), doc)
+    AbstractEditCommand(QtTools::toQt("Convert to clock tree"), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    TreeTools::convertToClockTree(*new_, new_->getRootId(), true);
+    recordLengths_([](TreeTemplate<Node>& tree) { TreeTools::convertToClockTree(tree, tree.getRootId(), true); });
   }
 };
 
+/**
+ * @brief Swapping two sons is its own inverse, so nothing needs to be stored.
+ */
 class SwapCommand : public AbstractCommand
 {
+private:
+  int nodeId_;
+  unsigned int i1_, i2_;
+
 public:
   SwapCommand(std::shared_ptr<TreeDocument> doc,
       int nodeId, unsigned int i1, unsigned int i2, int id1, int id2) :
-    AbstractCommand(QtTools::toQt("Swap nodes " + TextTools::toString(id1) + " and " + TextTools::toString(id2) + "."), doc)
+    AbstractCommand(QtTools::toQt("Swap nodes " + TextTools::toString(id1) + " and " + TextTools::toString(id2) + "."), doc),
+    nodeId_(nodeId), i1_(i1), i2_(i2)
+  {}
+
+protected:
+  void apply_(bool forward)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    new_->swapNodes(nodeId, i1, i2);
+    doc_->tree().swapNodes(nodeId_, i1_, i2_);
   }
 };
 
-class OrderCommand : public AbstractCommand
+class OrderCommand : public AbstractSnapshotCommand
 {
 public:
   OrderCommand(std::shared_ptr<TreeDocument> doc, int nodeId, bool downward) :
-    AbstractCommand(QtTools::toQt("Order nodes in subtree " + TextTools::toString(nodeId) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Order nodes in subtree " + TextTools::toString(nodeId) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     TreeTemplateTools::orderTree(*new_->getNode(nodeId), downward);
   }
 };
 
-class RerootCommand : public AbstractCommand
+class RerootCommand : public AbstractSnapshotCommand
 {
 public:
   RerootCommand(std::shared_ptr<TreeDocument> doc, int nodeId) :
-    AbstractCommand(QtTools::toQt("Reroot at " + TextTools::toString(nodeId) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Reroot at " + TextTools::toString(nodeId) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     new_->rootAt(nodeId);
   }
 };
 
-class OutgroupCommand : public AbstractCommand
+class OutgroupCommand : public AbstractSnapshotCommand
 {
 public:
   OutgroupCommand(std::shared_ptr<TreeDocument> doc, int nodeId) :
-    AbstractCommand(QtTools::toQt("New outgroup: " + TextTools::toString(nodeId) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("New outgroup: " + TextTools::toString(nodeId) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     new_->newOutGroup(nodeId);
   }
 };
 
-class MidpointRootingCommand : public AbstractCommand
+class MidpointRootingCommand : public AbstractSnapshotCommand
 {
 public:
   MidpointRootingCommand(std::shared_ptr<TreeDocument> doc, const string& criterion) :
-    AbstractCommand(QtTools::toQt("Midpoint rooting (" + criterion + ")."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Midpoint rooting (" + criterion + ")."), doc)
   {
     short crit = 0;
     if (criterion == "Variance")
       crit = TreeTemplateTools::MIDROOT_VARIANCE;
     else if (criterion == "Sum of squares")
       crit = TreeTemplateTools::MIDROOT_SUM_OF_SQUARES;
-    new_.reset(new TreeTemplate<Node>(*old_));
     TreeTemplateTools::midRoot(*new_, crit, true);
   }
 };
 
-class UnresolveUnsupportedNodesCommand : public AbstractCommand
+class UnresolveUnsupportedNodesCommand : public AbstractSnapshotCommand
 {
 public:
   UnresolveUnsupportedNodesCommand(std::shared_ptr<TreeDocument> doc, double threshold) :
-    AbstractCommand(QtTools::toQt("Unresolve nodes with bootstrap < " + TextTools::toString(threshold) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Unresolve nodes with bootstrap < " + TextTools::toString(threshold) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     TreeTemplateTools::unresolveUncertainNodes(new_->rootNode(), threshold, TreeTools::BOOTSTRAP);
   }
 };
 
-class DeleteSubtreeCommand : public AbstractCommand
+class DeleteSubtreeCommand : public AbstractSnapshotCommand
 {
 public:
   DeleteSubtreeCommand(std::shared_ptr<TreeDocument> doc, int nodeId) :
-    AbstractCommand(QtTools::toQt("Delete substree " + TextTools::toString(nodeId) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Delete substree " + TextTools::toString(nodeId) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     Node* node = new_->getNode(nodeId);
     TreeTemplateTools::dropSubtree(*new_, node);
   }
 };
 
-class InsertSubtreeAtNodeCommand : public AbstractCommand
+class InsertSubtreeAtNodeCommand : public AbstractSnapshotCommand
 {
 public:
   InsertSubtreeAtNodeCommand(std::shared_ptr<TreeDocument> doc, int nodeId, Node* subtree) :
-    AbstractCommand(QtTools::toQt("Insert substree at " + TextTools::toString(nodeId) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Insert substree at " + TextTools::toString(nodeId) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     Node* node = new_->getNode(nodeId);
     node->addSon(subtree);
     new_->resetNodesId();
   }
 };
 
-class InsertSubtreeOnBranchCommand : public AbstractCommand
+class InsertSubtreeOnBranchCommand : public AbstractSnapshotCommand
 {
 public:
   InsertSubtreeOnBranchCommand(std::shared_ptr<TreeDocument> doc, int nodeId, Node* subtree) :
-    AbstractCommand(QtTools::toQt("Insert substree below " + TextTools::toString(nodeId) + "."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Insert substree below " + TextTools::toString(nodeId) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     Node* node = new_->getNode(nodeId);
     if (!node->hasFather())
     {
@@ -248,31 +437,37 @@ public:
   }
 };
 
-class ChangeBranchLengthCommand : public AbstractCommand
+class ChangeBranchLengthCommand : public AbstractEditCommand
 {
 public:
   ChangeBranchLengthCommand(std::shared_ptr<TreeDocument> doc, int nodeId, double newLength) :
-    AbstractCommand(QtTools::toQt("Change length of node " + TextTools::toString(nodeId) + " to " + TextTools::toString(newLength) + "."), doc)
+    AbstractEditCommand(QtTools::toQt("Change length of node " + TextTools::toString(nodeId) + " to " + TextTools::toString(newLength) + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    Node* node = new_->getNode(nodeId);
-    node->setDistanceToFather(newLength);
+    setLength_(*doc_->tree().getNode(nodeId), newLength);
   }
 };
 
-class ChangeNodeNameCommand : public AbstractCommand
+class ChangeNodeNameCommand : public AbstractEditCommand
 {
 public:
   ChangeNodeNameCommand(std::shared_ptr<TreeDocument> doc, int nodeId, const string& newName) :
-    AbstractCommand(QtTools::toQt("Change name of node " + TextTools::toString(nodeId) + " to " + newName + "."), doc)
+    AbstractEditCommand(QtTools::toQt("Change name of node " + TextTools::toString(nodeId) + " to " + newName + "."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
-    Node* node = new_->getNode(nodeId);
-    node->setName(newName);
+    setName_(*doc_->tree().getNode(nodeId), newName);
+  }
+};
+
+class ChangeNodePropertyCommand : public AbstractEditCommand
+{
+public:
+  ChangeNodePropertyCommand(std::shared_ptr<TreeDocument> doc, int nodeId, const string& property, const string& value) :
+    AbstractEditCommand(QtTools::toQt("Change " + property + " of node " + TextTools::toString(nodeId) + " to " + value + "."), doc)
+  {
+    setNodeProperty_(*doc_->tree().getNode(nodeId), property, doc_->getValuePool().get(value));
   }
 };
 
-class TranslateNodeNamesCommand : public AbstractCommand
+class TranslateNodeNamesCommand : public AbstractEditCommand
 {
 public:
   TranslateNodeNamesCommand(
@@ -281,77 +476,135 @@ public:
       unsigned int from, unsigned int to);
 };
 
-class AttachDataCommand : public AbstractCommand
+/**
+ * @brief Attach the rows of a table to the nodes with matching id or name.
+ *
+ * The key column is hashed once, so that the join is linear in the number of nodes and rows.
+ * When a key occurs several times in the table, the last row is used.
+ */
+class AttachDataCommand : public AbstractEditCommand
 {
+private:
+  std::vector<std::string> unmatchedKeys_;
+  std::vector<std::string> duplicatedKeys_;
+
 public:
   AttachDataCommand(
       std::shared_ptr<TreeDocument> doc,
       const DataTable& data,
       unsigned int index, bool useNames);
 
-private:
-  static void addProperties_(Node* node, const DataTable& data, unsigned int index, bool useNames);
+public:
+  /**
+   * @return The keys of the table which do not correspond to any node.
+   */
+  const std::vector<std::string>& getUnmatchedKeys() const { return unmatchedKeys_; }
+
+  /**
+   * @return The keys found in more than one row of the table.
+   */
+  const std::vector<std::string>& getDuplicatedKeys() const { return duplicatedKeys_; }
 };
 
-class AddDataCommand : public AbstractCommand
+class AddDataCommand : public AbstractEditCommand
 {
 public:
   AddDataCommand(std::shared_ptr<TreeDocument> doc, const QString& name);
-
-private:
-  static void addProperty_(Node* node, const QString& name);
 };
 
-class RemoveDataCommand : public AbstractCommand
+/**
+ * @brief Remove a node property from all nodes.
+ *
+ * The values are recorded to be restored, but the column of the property store is removed as a whole.
+ */
+class RemoveDataCommand : public AbstractEditCommand
 {
+private:
+  std::string name_;
+
 public:
   RemoveDataCommand(std::shared_ptr<TreeDocument> doc, const QString& name);
 
-private:
-  static void removeProperty_(Node* node, const QString& name);
+protected:
+  TreeChange getChange_(bool forward) const;
 };
 
-class RenameDataCommand : public AbstractCommand
+/**
+ * @brief Rename a node property on all nodes.
+ *
+ * When no node has a property with the new name, values are moved from one property to
+ * the other, nothing is recorded, and the column of the property store is renamed as a whole.
+ * Otherwise the edits of the nodes are recorded, as the values they replace must be restored.
+ */
+class RenameDataCommand : public AbstractEditCommand
 {
+private:
+  std::string oldName_;
+  std::string newName_;
+  bool moved_;
+  // The nodes whose value was moved by the last apply_():
+  std::vector<int> nodeIds_;
+
 public:
   RenameDataCommand(std::shared_ptr<TreeDocument> doc, const QString& oldName, const QString& newName);
 
-private:
-  static void renameProperty_(Node* node, const QString& oldName, const QString& newName);
+protected:
+  void apply_(bool forward);
+
+  TreeChange getChange_(bool forward) const;
 };
 
-class SampleSubtreeCommand : public AbstractCommand
+class SampleSubtreeCommand : public AbstractSnapshotCommand
 {
 public:
   SampleSubtreeCommand(std::shared_ptr<TreeDocument> doc, int nodeId, unsigned int size) :
-    AbstractCommand(QtTools::toQt("Sample subtree " + TextTools::toString(nodeId) + " to " + TextTools::toString(size) + " leaves."), doc)
+    AbstractSnapshotCommand(QtTools::toQt("Sample subtree " + TextTools::toString(nodeId) + " to " + TextTools::toString(size) + " leaves."), doc)
   {
-    new_.reset(new TreeTemplate<Node>(*old_));
     Node* node = new_->getNode(nodeId);
     TreeTemplateTools::sampleSubtree(*new_, TreeTemplateTools::getLeavesNames(*node), size);
   }
 };
 
-class SnapCommand : public AbstractCommand
+class SnapCommand : public AbstractSnapshotCommand
 {
 public:
   SnapCommand(std::shared_ptr<TreeDocument> doc) :
-    AbstractCommand(QString("Tree snapshot (saved at ") + QTime::currentTime().toString("hh:mm:ss") + QString(")"), doc)
-  {
-    new_.reset(new TreeTemplate<Node>(*old_));
-  }
+    AbstractSnapshotCommand(QString("Tree snapshot (saved at ") + QTime::currentTime().toString("hh:mm:ss") + QString(")"), doc)
+  {}
 };
 
-class NaiveAsrCommand : public AbstractCommand
+class NaiveAsrCommand : public AbstractEditCommand
 {
 public:
-  NaiveAsrCommand(std::shared_ptr<TreeDocument> doc, const string& name);
+  NaiveAsrCommand(std::shared_ptr<TreeDocument> doc, const std::vector<std::string>& names);
 
 private:
-  static std::string asr_(Node& node, const string& name);
+  std::string asr_(const Node& root, const string& name);
+};
+
+/**
+ * @brief Maximum parsimony reconstruction of the ancestral states of one or more variables.
+ *
+ * Inner nodes without a value get the reconstructed state, other nodes are left unchanged.
+ * Variables are independent, and are reconstructed in parallel on the same flattened tree.
+ */
+class ParsimonyAsrCommand : public AbstractEditCommand
+{
+public:
+  /**
+   * @param alphabet The states of the cost matrix.
+   * @param costs The costs of changes between states, row by row, for Sankoff's algorithm.
+   * The same matrix is used for all variables. Fitch's algorithm is used if there are none.
+   * @throw Exception If a variable has no value, or a value is not in the cost matrix.
+   */
+  ParsimonyAsrCommand(
+      std::shared_ptr<TreeDocument> doc,
+      const std::vector<std::string>& names,
+      const std::vector<std::string>& alphabet = std::vector<std::string>(),
+      const std::vector<double>& costs = std::vector<double>());
 };
 
-class SetNamesFromDataCommand : public AbstractCommand
+class SetNamesFromDataCommand : public AbstractEditCommand
 {
 public:
   SetNamesFromDataCommand(std::shared_ptr<TreeDocument> doc, const string& propertyName, bool innerNodesOnly);
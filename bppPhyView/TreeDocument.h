@@ -5,7 +5,19 @@
 #ifndef _TREEDOCUMENT_H_
 #define _TREEDOCUMENT_H_
 
+#include "UndoHistory.h"
+#include "TreeChange.h"
+#include "MultiTreeFile.h"
+#include "NameIndex.h"
+#include "PropertyStore.h"
+#include "TreeLayout.h"
+#include "TreeSummary.h"
+#include "ValuePool.h"
+#include "Profiler.h"
+#include "TreeTraversal.h"
+
 #include <Bpp/Io/FileTools.h>
+#include <Bpp/Text/TextTools.h>
 
 // From bpp-phyl:
 #include <Bpp/Phyl/Tree/Tree.h>
@@ -13,6 +25,7 @@
 
 // From the STL:
 #include <string>
+#include <unordered_map>
 
 // From Qt:
 #include <QUndoStack>
@@ -29,7 +42,7 @@ public:
   virtual ~DocumentView() {}
 
 public:
-  virtual void updateView() = 0;
+  virtual void updateView(const TreeChange& change) = 0;
 };
 
 /**
@@ -41,20 +54,39 @@ class TreeDocument
 {
 private:
   std::shared_ptr<TreeTemplate<Node>> tree_;
+  std::unordered_map<int, Node*> nodeIndex_;
+  NameIndex nameIndex_;
+  PropertyStore propertyStore_;
+  TreeLayout layout_;
+  TreeSummary summary_;
+  ValuePool valuePool_;
   std::string documentName_;
   bool modified_;
   std::string currentFilePath_;
   std::string currentFileFormat_;
+  std::shared_ptr<MultiTreeFile> multiTreeFile_;
+  size_t currentTreeInFile_;
+  // The history must be destroyed after the stack, as commands unregister from it.
+  UndoHistory undoHistory_;
   QUndoStack undoStack_;
   vector<DocumentView*> viewers_;
 
 public:
   TreeDocument() :
     tree_(),
+    nodeIndex_(),
+    nameIndex_(),
+    propertyStore_(),
+    layout_(),
+    summary_(),
+    valuePool_(),
     documentName_(),
     modified_(false),
     currentFilePath_(),
     currentFileFormat_(),
+    multiTreeFile_(),
+    currentTreeInFile_(0),
+    undoHistory_(),
     undoStack_()
   {}
 
@@ -90,11 +122,119 @@ public:
     }
   }
 
+  /**
+   * @brief Set the tree of the document. Its string node properties are shared through the value pool.
+   */
   void setTree(const Tree& tree)
   {
-    tree_.reset(new TreeTemplate<Node>(tree));
+    const TreeTemplate<Node>* treeTemplate = dynamic_cast<const TreeTemplate<Node>*>(&tree);
+    tree_ = treeTemplate ? TreeTraversal::cloneTree(*treeTemplate) : TreeTraversal::adoptTree(new TreeTemplate<Node>(tree));
+    valuePool_.intern(tree_->rootNode());
+    nodeIndex_.clear();
+    nameIndex_.clear();
+    propertyStore_.clear();
+    layout_.clear();
+    summary_.clear();
+  }
+
+  void setTree(std::shared_ptr<TreeTemplate<Node>> tree)
+  {
+    tree_ = tree;
+    valuePool_.intern(tree_->rootNode());
+    nodeIndex_.clear();
+    nameIndex_.clear();
+    propertyStore_.clear();
+    layout_.clear();
+    summary_.clear();
+  }
+
+  /**
+   * @brief Exchange the tree of the document with another one, without copying.
+   */
+  void swapTree(std::shared_ptr<TreeTemplate<Node>>& tree)
+  {
+    tree_.swap(tree);
+    nodeIndex_.clear();
+    nameIndex_.clear();
+    propertyStore_.clear();
+    layout_.clear();
+    summary_.clear();
+  }
+
+  /**
+   * @brief Get a node from its id in constant time.
+   *
+   * The index is built on first use, and invalidated each time the tree is replaced.
+   */
+  Node* getNode(int id)
+  {
+    if (nodeIndex_.empty())
+    {
+      for (auto* node : TreeTraversal::postOrder(tree().rootNode()))
+      {
+        nodeIndex_[node->getId()] = node;
+      }
+    }
+    auto it = nodeIndex_.find(id);
+    if (it == nodeIndex_.end())
+      throw Exception("TreeDocument::getNode. No node with id " + TextTools::toString(id) + ".");
+    return it->second;
+  }
+
+  /**
+   * @brief Get the index of node names and string properties, for searching.
+   *
+   * The index is built on first use, and kept up to date with the changes published by commands.
+   */
+  const NameIndex& getNameIndex()
+  {
+    if (!nameIndex_.isBuilt())
+      nameIndex_.build(tree().rootNode());
+    return nameIndex_;
   }
 
+  /**
+   * @brief Get the node properties of the tree, by column.
+   *
+   * The store is built on first use, and kept up to date with the changes published by commands.
+   * It must be built (by calling this method) before being read from other threads.
+   */
+  const PropertyStore& getPropertyStore()
+  {
+    if (!propertyStore_.isBuilt())
+      propertyStore_.build(tree().rootNode());
+    return propertyStore_;
+  }
+
+  /**
+   * @brief Get the extents of all subtrees, as needed to lay out the tree.
+   *
+   * The layout is computed on first use, shared by all views, and kept up to date with the changes published by commands.
+   */
+  const TreeLayout& getLayout()
+  {
+    if (!layout_.isBuilt())
+      layout_.build(tree().rootNode());
+    return layout_;
+  }
+
+  /**
+   * @brief Get the summary statistics of the tree.
+   *
+   * The summary is computed on first use, and kept until a command changes the tree.
+   */
+  const TreeSummary& getSummary()
+  {
+    if (!summary_.isBuilt())
+      summary_.build(tree().rootNode());
+    return summary_;
+  }
+
+  /**
+   * @brief Get the pool of string property values, which commands use to store new values.
+   */
+  ValuePool& getValuePool() { return valuePool_; }
+
   const std::string& getName() const { return documentName_; }
 
   void setFile(const string& filePath, const string& fileFormat)
@@ -107,21 +247,118 @@ public:
   const string& getFilePath() const { return currentFilePath_; }
   const string& getFileFormat() const { return currentFileFormat_; }
 
+  /**
+   * @brief Attach the index of the file the tree was read from, when it contains several trees.
+   *
+   * @param trees The index, or a null pointer if the document has a single tree.
+   * @param current The index of the tree of the document in the file.
+   */
+  void setMultiTreeFile(std::shared_ptr<MultiTreeFile> trees, size_t current = 0)
+  {
+    multiTreeFile_ = trees;
+    currentTreeInFile_ = current;
+  }
+
+  bool hasMultiTreeFile() const { return multiTreeFile_ != nullptr; }
+
+  std::shared_ptr<MultiTreeFile> getMultiTreeFile() { return multiTreeFile_; }
+
+  size_t getCurrentTreeInFile() const { return currentTreeInFile_; }
+
+  /**
+   * @brief Replace the tree of the document with another tree of its file.
+   *
+   * The tree is copied from the cache of the file. The undo stack is cleared, as
+   * commands refer to the nodes of the previous tree, and its changes are lost.
+   *
+   * @throw Exception If the document has no multi-tree file or the tree cannot be read.
+   */
+  void showTreeOfFile(size_t i)
+  {
+    if (!multiTreeFile_)
+      throw Exception("TreeDocument::showTreeOfFile. The document was not read from a file with several trees.");
+    std::shared_ptr<TreeTemplate<Node>> tree = TreeTraversal::cloneTree(*multiTreeFile_->getTree(i));
+    undoStack_.clear();
+    setTree(tree);
+    currentTreeInFile_ = i;
+    modified_ = false;
+    updateAllViews(TreeChange(TreeChange::TOPOLOGY));
+  }
+
   void modified(bool yn) { modified_ = yn; }
   bool modified() const { return modified_; }
 
   QUndoStack& getUndoStack() { return undoStack_; }
 
+  UndoHistory& getUndoHistory() { return undoHistory_; }
+  const UndoHistory& getUndoHistory() const { return undoHistory_; }
+
   void addView(DocumentView* viewer)
   {
     viewers_.push_back(viewer);
   }
 
-  void updateAllViews()
+  void updateAllViews(const TreeChange& change = TreeChange())
   {
+    ProfileProbe probe("Update views", "view");
+    // Any change may alter the summary, which is cheaper to compute again than to update:
+    summary_.clear();
+    if (change.has(TreeChange::TOPOLOGY))
+    {
+      nameIndex_.clear();
+      propertyStore_.clear();
+      layout_.clear();
+    }
+    else
+    {
+      if (layout_.isBuilt() && change.has(TreeChange::LENGTHS))
+      {
+        // Changing most lengths one by one would cost more than laying the tree out again:
+        if (change.getNodeIds().size() > layout_.getNumberOfNodes() / 4)
+        {
+          layout_.clear();
+        }
+        else
+        {
+          for (int id : change.getNodeIds())
+          {
+            layout_.updateLength(*getNode(id));
+          }
+        }
+      }
+      if (nameIndex_.isBuilt() && change.has(TreeChange::NAMES | TreeChange::NODE_PROPERTIES))
+      {
+        for (int id : change.getNodeIds())
+        {
+          nameIndex_.update(*getNode(id));
+        }
+      }
+      if (propertyStore_.isBuilt())
+      {
+        // Whole columns are renamed or removed without reading the nodes:
+        for (const auto& renamed : change.getRenamedProperties())
+        {
+          if (renamed.second.empty())
+            propertyStore_.removeColumn(renamed.first);
+          else
+            propertyStore_.renameColumn(renamed.first, renamed.second);
+        }
+      }
+      if (propertyStore_.isBuilt() && change.has(TreeChange::NODE_PROPERTIES))
+      {
+        for (int id : change.getNodeIds())
+        {
+          const Node& node = *getNode(id);
+          for (const auto& property : change.getProperties())
+          {
+            propertyStore_.update(node, property);
+          }
+        }
+      }
+    }
     for (size_t i = 0; i < viewers_.size(); i++)
     {
-      viewers_[i]->updateView();
+      viewers_[i]->updateView(change);
     }
   }
 };
@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "TreeLayout.h"
+
+#include <Bpp/Exceptions.h>
+#include <Bpp/Text/TextTools.h>
+
+// From the STL:
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+void TreeLayout::build(const Node& root)
+{
+  clear();
+  vector< pair<const Node*, size_t> > stack;
+  stack.push_back(make_pair(&root, 0));
+  while (!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    fathers_.push_back(stack.back().second);
+    stack.pop_back();
+    size_t index = ids_.size();
+    ids_.push_back(node->getId());
+    indexes_[node->getId()] = index;
+    subtreeSizes_.push_back(1);
+    numbersOfLeaves_.push_back(node->isLeaf() ? 1 : 0);
+    depths_.push_back(0);
+    heights_.push_back(0.);
+    lengths_.push_back(node->hasDistanceToFather() ? node->getDistanceToFather() : 0.);
+    // Sons are pushed in reverse order, so that they are visited in the drawing order:
+    for (size_t i = node->getNumberOfSons(); i > 0; --i)
+    {
+      stack.push_back(make_pair(node->getSon(i - 1), index));
+    }
+  }
+  for (size_t i = ids_.size(); i > 1; --i)
+  {
+    size_t j = i - 1;
+    size_t father = fathers_[j];
+    subtreeSizes_[father] += subtreeSizes_[j];
+    numbersOfLeaves_[father] += numbersOfLeaves_[j];
+    depths_[father] = max(depths_[father], depths_[j] + 1);
+    heights_[father] = max(heights_[father], heights_[j] + lengths_[j]);
+  }
+}
+
+void TreeLayout::clear()
+{
+  ids_.clear();
+  indexes_.clear();
+  fathers_.clear();
+  subtreeSizes_.clear();
+  numbersOfLeaves_.clear();
+  depths_.clear();
+  heights_.clear();
+  lengths_.clear();
+}
+
+size_t TreeLayout::getIndex(int id) const
+{
+  auto it = indexes_.find(id);
+  if (it == indexes_.end())
+    throw Exception("TreeLayout::getIndex. No node with id " + TextTools::toString(id) + ".");
+  return it->second;
+}
+
+double TreeLayout::computeHeight_(size_t i) const
+{
+  double height = 0.;
+  // Sons follow their father in pre-order, each one after the subtree of the previous one:
+  for (size_t j = i + 1; j < i + subtreeSizes_[i]; j += subtreeSizes_[j])
+  {
+    height = max(height, heights_[j] + lengths_[j]);
+  }
+  return height;
+}
+
+void TreeLayout::updateLength(const Node& node)
+{
+  if (!isBuilt())
+    return;
+  size_t i = getIndex(node.getId());
+  lengths_[i] = node.hasDistanceToFather() ? node.getDistanceToFather() : 0.;
+  // Only the heights of the ancestors may change, up to the first one which does not:
+  while (i > 0)
+  {
+    i = fathers_[i];
+    double height = computeHeight_(i);
+    if (height == heights_[i])
+      break;
+    heights_[i] = height;
+  }
+}
@@ -0,0 +1,102 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREELAYOUT_H_
+#define _TREELAYOUT_H_
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+
+// From the STL:
+#include <unordered_map>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief The extent of each subtree of a document, as needed to lay it out.
+ *
+ * Nodes are stored in pre-order, in drawing order, so that the subtree of node i
+ * is made of nodes i to i + getSubtreeSize(i) - 1. The horizontal extent of a subtree
+ * is its height for phylograms, and its depth (in number of branches) for cladograms;
+ * its vertical extent is its number of leaves, whatever the drawing type and orientation.
+ *
+ * The layout is built on first use, and is shared by all views of the document.
+ * Changes of branch lengths only update the ancestors of the nodes which were
+ * touched; other changes but topology ones do not affect it.
+ */
+class TreeLayout
+{
+private:
+  std::vector<int> ids_;
+  std::unordered_map<int, size_t> indexes_;
+  std::vector<size_t> fathers_;
+  std::vector<size_t> subtreeSizes_;
+  std::vector<size_t> numbersOfLeaves_;
+  std::vector<unsigned int> depths_;
+  std::vector<double> heights_;
+  std::vector<double> lengths_;
+
+public:
+  TreeLayout() :
+    ids_(),
+    indexes_(),
+    fathers_(),
+    subtreeSizes_(),
+    numbersOfLeaves_(),
+    depths_(),
+    heights_(),
+    lengths_()
+  {}
+
+public:
+  bool isBuilt() const { return !ids_.empty(); }
+
+  /**
+   * @brief Lay out a (sub)tree.
+   */
+  void build(const Node& root);
+
+  /**
+   * @brief Forget everything. The layout has to be built again before use.
+   */
+  void clear();
+
+  /**
+   * @brief Read the length of the branch of a node again after it has changed.
+   */
+  void updateLength(const Node& node);
+
+  size_t getNumberOfNodes() const { return ids_.size(); }
+
+  int getId(size_t i) const { return ids_[i]; }
+
+  /**
+   * @return The index of a node in pre-order.
+   * @throw Exception If there is no node with this id.
+   */
+  size_t getIndex(int id) const;
+
+  size_t getSubtreeSize(size_t i) const { return subtreeSizes_[i]; }
+
+  size_t getNumberOfLeaves(size_t i) const { return numbersOfLeaves_[i]; }
+
+  /**
+   * @return The largest number of branches between a node and the leaves of its subtree.
+   */
+  unsigned int getDepth(size_t i) const { return depths_[i]; }
+
+  /**
+   * @return The largest distance between a node and the leaves of its subtree.
+   */
+  double getHeight(size_t i) const { return heights_[i]; }
+
+private:
+  /**
+   * @return The height of node i, computed from the ones of its sons.
+   */
+  double computeHeight_(size_t i) const;
+};
+
+#endif // _TREELAYOUT_H_
@@ -0,0 +1,200 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "TreeLoader.h"
+#include "BinaryTreeFormat.h"
+#include "CompressedStream.h"
+#include "NewickStreamReader.h"
+#include "Profiler.h"
+#include "TreeTraversal.h"
+
+#include <Bpp/Exceptions.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Io/IoTreeFactory.h>
+
+// From Qt:
+#include <QFileInfo>
+#include <QThread>
+
+// From the STL:
+#include <fstream>
+
+using namespace std;
+
+ProgressStreamBuffer::int_type ProgressStreamBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  if (cancelled_)
+    return traits_type::eof();
+  streamsize n = source_->sgetn(buffer_.data(), static_cast<streamsize>(buffer_.size()));
+  if (n <= 0)
+    return traits_type::eof();
+  bytesRead_ += n;
+  setg(buffer_.data(), buffer_.data(), buffer_.data() + n);
+  return traits_type::to_int_type(*gptr());
+}
+
+TreeLoader::TreeLoader(QWidget* parent) :
+  QObject(parent),
+  jobs_(),
+  progress_(new QProgressDialog(parent)),
+  timer_(),
+  pool_()
+{
+  pool_.setMaxThreadCount(QThread::idealThreadCount());
+  progress_->setWindowTitle(tr("Loading trees"));
+  progress_->setRange(0, 1000);
+  progress_->setMinimumDuration(500);
+  progress_->setAutoClose(false);
+  progress_->setAutoReset(false);
+  progress_->reset();
+  connect(progress_, &QProgressDialog::canceled, this, &TreeLoader::cancel);
+  connect(&timer_, &QTimer::timeout, this, &TreeLoader::updateProgress);
+}
+
+TreeLoader::~TreeLoader()
+{
+  cancel();
+  pool_.waitForDone();
+}
+
+void TreeLoader::load(const QString& path, const string& format)
+{
+  auto job = make_shared<Job>(path, format, QFileInfo(path).size());
+  jobs_.push_back(job);
+  if (!timer_.isActive())
+  {
+    progress_->setValue(0);
+    timer_.start(100);
+  }
+  pool_.start([this, job]() { run_(job); });
+}
+
+void TreeLoader::cancel()
+{
+  for (auto& job : jobs_)
+  {
+    job->cancelled = true;
+  }
+}
+
+void TreeLoader::updateProgress()
+{
+  qint64 total = 0, read = 0;
+  for (const auto& job : jobs_)
+  {
+    total += job->size;
+    read  += job->bytesRead;
+  }
+  progress_->setLabelText(tr("Loading %1 file(s): %2 / %3 MB read")
+      .arg(jobs_.size())
+      .arg(static_cast<double>(read) / 1048576., 0, 'f', 1)
+      .arg(static_cast<double>(total) / 1048576., 0, 'f', 1));
+  progress_->setValue(total > 0 ? static_cast<int>(min<qint64>(999, read * 1000 / total)) : 0);
+}
+
+void TreeLoader::run_(shared_ptr<Job> job)
+{
+  shared_ptr<TreeTemplate<Node>> tree;
+  vector<int> collapsedIds;
+  shared_ptr<MultiTreeFile> trees;
+  QString error;
+  try
+  {
+    // Jobs cancelled while queued are not started:
+    if (job->cancelled)
+      throw Exception("Cancelled.");
+    ProfileProbe probe("Read " + QFileInfo(job->path).fileName().toStdString(), "io");
+    string path = job->path.toStdString();
+    if (BinaryTreeFormat::isBinaryFile(path))
+    {
+      // Memory mapped, no parsing to follow:
+      auto content = BinaryTreeFormat::read(path);
+      tree = content.tree;
+      collapsedIds.swap(content.collapsedIds);
+      job->format = BinaryTreeFormat::FORMAT;
+      job->bytesRead = job->size;
+    }
+    else
+    {
+      Compression::Type compression = Compression::detect(path);
+      Compression::checkSupported(compression, path);
+      ifstream file(path.c_str(), ios::in | ios::binary);
+      if (!file)
+        throw IOException("Cannot open file " + path);
+      // Progress is measured on the file, compressed or not:
+      ProgressStreamBuffer buffer(file.rdbuf(), job->bytesRead, job->cancelled);
+      unique_ptr<InflateStreamBuffer> inflate;
+      if (compression == Compression::GZIP)
+        inflate.reset(new InflateStreamBuffer(&buffer));
+      istream in(inflate ? static_cast<streambuf*>(inflate.get()) : &buffer);
+      in.exceptions(ios::badbit);
+      if (job->format == IOTreeFactory::NEWICK_FORMAT
+          || job->format == IOTreeFactory::NHX_FORMAT
+          || job->format == IOTreeFactory::NEXUS_FORMAT)
+      {
+        // The first tree is parsed while the file is indexed:
+        trees = make_shared<MultiTreeFile>(path, job->format);
+        tree = trees->scan(in);
+        if (!tree && job->format == IOTreeFactory::NEXUS_FORMAT && !job->cancelled)
+        {
+          // No tree statement recognized, let the Nexus reader report the problem:
+          CompressedInputFile nexus(path);
+          tree = readTree(nexus, job->format);
+        }
+        // The index is only kept for files with several trees:
+        if (trees->getNumberOfTrees() < 2)
+          trees.reset();
+      }
+      else
+      {
+        tree = readTree(in, job->format);
+      }
+    }
+  }
+  catch (exception& e)
+  {
+    error = QString::fromStdString(e.what());
+  }
+  QMetaObject::invokeMethod(this, [this, job, tree, collapsedIds, trees, error]() { finish_(job, tree, collapsedIds, trees, error); }, Qt::QueuedConnection);
+}
+
+shared_ptr<TreeTemplate<Node>> TreeLoader::readTree(istream& in, const string& format)
+{
+  // The readers of bpp are recursive, and overflow the stack on deep trees:
+  if (format == IOTreeFactory::NEWICK_FORMAT || format == IOTreeFactory::NHX_FORMAT)
+    return NewickStreamReader(format == IOTreeFactory::NHX_FORMAT).readTree(in);
+  IOTreeFactory factory;
+  unique_ptr<ITree> reader(factory.createReader(format));
+  AbstractITree* streamReader = dynamic_cast<AbstractITree*>(reader.get());
+  if (!streamReader)
+    throw Exception("Format " + format + " can not be read from a stream.");
+  unique_ptr<Tree> result(streamReader->readTree(in));
+  shared_ptr<TreeTemplate<Node>> tree;
+  if (dynamic_cast<TreeTemplate<Node>*>(result.get()))
+    tree = TreeTraversal::adoptTree(dynamic_cast<TreeTemplate<Node>*>(result.release()));
+  else if (result)
+    tree = TreeTraversal::adoptTree(new TreeTemplate<Node>(*result));
+  return tree;
+}
+
+void TreeLoader::finish_(shared_ptr<Job> job, shared_ptr<TreeTemplate<Node>> tree, const vector<int>& collapsedIds, shared_ptr<MultiTreeFile> trees, const QString& error)
+{
+  jobs_.remove(job);
+  if (jobs_.empty())
+  {
+    timer_.stop();
+    progress_->reset();
+  }
+  if (job->cancelled)
+    return;
+  if (!error.isEmpty() || !tree)
+    emit loadFailed(job->path, error.isEmpty() ? tr("No tree found in file.") : error);
+  else if (trees)
+    emit multiTreeFileLoaded(job->path, job->format, tree, trees);
+  else
+    emit treeLoaded(job->path, job->format, tree, collapsedIds);
+}
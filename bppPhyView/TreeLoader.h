@@ -0,0 +1,145 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREELOADER_H_
+#define _TREELOADER_H_
+
+#include "MultiTreeFile.h"
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/TreeTemplate.h>
+
+// From Qt:
+#include <QObject>
+#include <QProgressDialog>
+#include <QThreadPool>
+#include <QTimer>
+
+// From the STL:
+#include <atomic>
+#include <istream>
+#include <list>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief A stream buffer counting the bytes read from another one.
+ *
+ * Reading stops (end of file is reported) as soon as the cancel flag is set.
+ */
+class ProgressStreamBuffer :
+  public std::streambuf
+{
+private:
+  std::streambuf* source_;
+  std::atomic<qint64>& bytesRead_;
+  const std::atomic<bool>& cancelled_;
+  std::vector<char> buffer_;
+
+public:
+  ProgressStreamBuffer(std::streambuf* source, std::atomic<qint64>& bytesRead, const std::atomic<bool>& cancelled, size_t bufferSize = 1 << 16) :
+    source_(source),
+    bytesRead_(bytesRead),
+    cancelled_(cancelled),
+    buffer_(bufferSize)
+  {}
+
+protected:
+  int_type underflow();
+};
+
+/**
+ * @brief Reads tree files in worker threads.
+ *
+ * Several files can be loaded at the same time, with at most one thread per core:
+ * further files are queued until a thread is available. A single progress dialog
+ * shows the number of bytes read for all pending files, and allows to cancel them.
+ * Trees are converted to TreeTemplate<Node> in the worker thread,
+ * and handed over with the treeLoaded() signal, in the GUI thread.
+ * Files in PhyView's binary format are recognized whatever the requested format,
+ * and gzip compressed files are decompressed while they are parsed.
+ *
+ * Newick, NHX and Nexus files are indexed while their first tree is parsed, in a
+ * single pass: when they contain several trees, the index is handed over with the
+ * multiTreeFileLoaded() signal, to read the others on demand.
+ */
+class TreeLoader :
+  public QObject
+{
+  Q_OBJECT
+
+private:
+  struct Job
+  {
+    QString path;
+    std::string format;
+    qint64 size;
+    std::atomic<qint64> bytesRead;
+    std::atomic<bool> cancelled;
+
+    Job(const QString& p, const std::string& f, qint64 s) :
+      path(p), format(f), size(s), bytesRead(0), cancelled(false) {}
+  };
+
+  std::list<std::shared_ptr<Job>> jobs_;
+  QProgressDialog* progress_;
+  QTimer timer_;
+  QThreadPool pool_;
+
+public:
+  TreeLoader(QWidget* parent);
+
+  virtual ~TreeLoader();
+
+public:
+  /**
+   * @brief Load a file in the background, as soon as a thread is available.
+   */
+  void load(const QString& path, const std::string& format);
+
+  bool isLoading() const { return !jobs_.empty(); }
+
+  /**
+   * @brief Read a tree from a stream, in the calling thread.
+   *
+   * @return The tree read, or a null pointer if the stream contains no tree.
+   * @throw Exception If the format is not supported or the stream is not valid.
+   */
+  static std::shared_ptr<TreeTemplate<Node>> readTree(std::istream& in, const std::string& format);
+
+signals:
+  /**
+   * @param collapsedIds Nodes saved as collapsed, with files in the binary format.
+   */
+  void treeLoaded(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree, const std::vector<int>& collapsedIds);
+  /**
+   * @param tree The first tree of the file.
+   * @param trees The index of all the trees of the file.
+   */
+  void multiTreeFileLoaded(const QString& path, const std::string& format, std::shared_ptr<TreeTemplate<Node>> tree, std::shared_ptr<MultiTreeFile> trees);
+  void loadFailed(const QString& path, const QString& message);
+
+public slots:
+  void cancel();
+
+private slots:
+  void updateProgress();
+
+private:
+  /**
+   * @brief Parse the file, in the worker thread.
+   */
+  void run_(std::shared_ptr<Job> job);
+
+  /**
+   * @brief Hand over the result, in the GUI thread.
+   */
+  void finish_(std::shared_ptr<Job> job, std::shared_ptr<TreeTemplate<Node>> tree, const std::vector<int>& collapsedIds, std::shared_ptr<MultiTreeFile> trees, const QString& error);
+};
+
+#endif // _TREELOADER_H_
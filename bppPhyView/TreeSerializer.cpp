@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "TreeSerializer.h"
+#include "ValuePool.h"
+#include "TreeTraversal.h"
+
+#include <Bpp/BppString.h>
+#include <Bpp/Exceptions.h>
+#include <Bpp/Numeric/Number.h>
+
+using namespace std;
+
+// Type tags for values:
+static const quint8 NO_VALUE     = 0;
+static const quint8 STRING_VALUE = 1;
+static const quint8 DOUBLE_VALUE = 2;
+
+bool TreeSerializer::isSerializable(const Clonable* value)
+{
+  return !value || SharedString::getText(value) || dynamic_cast<const Number<double>*>(value);
+}
+
+void TreeSerializer::writeValue(QDataStream& out, const Clonable* value)
+{
+  if (!value)
+  {
+    out << NO_VALUE;
+  }
+  else if (auto str = SharedString::getText(value))
+  {
+    out << STRING_VALUE;
+    writeString(out, *str);
+  }
+  else if (auto num = dynamic_cast<const Number<double>*>(value))
+  {
+    out << DOUBLE_VALUE << num->getValue();
+  }
+  else
+  {
+    throw Exception("TreeSerializer::writeValue. Unsupported property type.");
+  }
+}
+
+shared_ptr<const Clonable> TreeSerializer::readValue(QDataStream& in)
+{
+  quint8 type;
+  in >> type;
+  if (type == STRING_VALUE)
+  {
+    return make_shared<BppString>(readString(in));
+  }
+  else if (type == DOUBLE_VALUE)
+  {
+    double x;
+    in >> x;
+    return make_shared<Number<double>>(x);
+  }
+  return nullptr;
+}
+
+void TreeSerializer::writeProperties_(QDataStream& out, const Node& node, bool branch)
+{
+  vector<string> names = branch ? node.getBranchPropertyNames() : node.getNodePropertyNames();
+  out << static_cast<quint32>(names.size());
+  for (const auto& name : names)
+  {
+    writeString(out, name);
+    writeValue(out, branch ? node.getBranchProperty(name) : node.getNodeProperty(name));
+  }
+}
+
+void TreeSerializer::readProperties_(QDataStream& in, Node& node, bool branch)
+{
+  quint32 n;
+  in >> n;
+  for (quint32 i = 0; i < n; ++i)
+  {
+    string name = readString(in);
+    auto value = readValue(in);
+    if (!value)
+      continue;
+    if (branch)
+      node.setBranchProperty(name, *value);
+    else
+      node.setNodeProperty(name, *value);
+  }
+}
+
+void TreeSerializer::writeTree(QDataStream& out, const TreeTemplate<Node>& tree)
+{
+  // Pre-order traversal with an explicit stack of (node, father index):
+  vector<pair<const Node*, qint32>> stack;
+  stack.push_back(make_pair(tree.getRootNode(), -1));
+  out << static_cast<quint32>(TreeTraversal::getNumberOfNodes(*tree.getRootNode()));
+  qint32 index = 0;
+  while (!stack.empty())
+  {
+    const Node* node = stack.back().first;
+    qint32 father = stack.back().second;
+    stack.pop_back();
+    out << static_cast<qint32>(node->getId()) << father;
+    out << node->hasName();
+    if (node->hasName())
+      writeString(out, node->getName());
+    out << node->hasDistanceToFather();
+    if (node->hasDistanceToFather())
+      out << node->getDistanceToFather();
+    writeProperties_(out, *node, false);
+    writeProperties_(out, *node, true);
+    // Push sons in reverse order so that they are written in their original order:
+    for (size_t i = node->getNumberOfSons(); i > 0; --i)
+    {
+      stack.push_back(make_pair(node->getSon(i - 1), index));
+    }
+    ++index;
+  }
+}
+
+shared_ptr<TreeTemplate<Node>> TreeSerializer::readTree(QDataStream& in)
+{
+  quint32 n;
+  in >> n;
+  vector<Node*> nodes;
+  nodes.reserve(n);
+  for (quint32 i = 0; i < n && in.status() == QDataStream::Ok; ++i)
+  {
+    qint32 id, father;
+    bool hasName, hasLength;
+    in >> id >> father >> hasName;
+    if (father >= static_cast<qint32>(i) || (father < 0 && i > 0))
+      break;
+    Node* node = new Node(id);
+    nodes.push_back(node);
+    if (hasName)
+      node->setName(readString(in));
+    in >> hasLength;
+    if (hasLength)
+    {
+      double length;
+      in >> length;
+      node->setDistanceToFather(length);
+    }
+    readProperties_(in, *node, false);
+    readProperties_(in, *node, true);
+    if (father >= 0)
+      nodes[static_cast<size_t>(father)]->addSon(node);
+  }
+  if (in.status() != QDataStream::Ok || n == 0 || nodes.size() != n)
+  {
+    for (auto* node : nodes)
+    {
+      delete node;
+    }
+    throw Exception("TreeSerializer::readTree. Corrupted data.");
+  }
+  return TreeTraversal::makeTree(nodes[0]);
+}
+
+size_t TreeSerializer::getMemoryUsage(const Clonable* value)
+{
+  // The text of shared strings is counted once in the value pool:
+  if (dynamic_cast<const SharedString*>(value))
+    return sizeof(SharedString);
+  if (auto str = dynamic_cast<const BppString*>(value))
+    return sizeof(BppString) + str->toSTL().capacity();
+  return 32;
+}
+
+size_t TreeSerializer::getMemoryUsage(const TreeTemplate<Node>& tree)
+{
+  size_t total = 0;
+  for (const Node* node : TreeTraversal::postOrder(*tree.getRootNode()))
+  {
+    total += sizeof(Node) + sizeof(Node*);
+    if (node->hasName())
+      total += sizeof(string) + node->getName().size();
+    if (node->hasDistanceToFather())
+      total += sizeof(double);
+    for (const auto& name : node->getNodePropertyNames())
+    {
+      total += 64 + name.size() + getMemoryUsage(node->getNodeProperty(name));
+    }
+    for (const auto& name : node->getBranchPropertyNames())
+    {
+      total += 64 + name.size() + getMemoryUsage(node->getBranchProperty(name));
+    }
+  }
+  return total;
+}
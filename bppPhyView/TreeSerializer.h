@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREESERIALIZER_H_
+#define _TREESERIALIZER_H_
+
+#include <Bpp/Clonable.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/TreeTemplate.h>
+
+// From Qt:
+#include <QDataStream>
+
+// From the STL:
+#include <memory>
+#include <string>
+
+using namespace bpp;
+
+/**
+ * @brief Binary (de)serialization of trees and node attributes with QDataStream.
+ *
+ * Nodes are written in pre-order, each one with the index of its father,
+ * so that no recursion is needed when reading or writing.
+ * Only string (BppString or SharedString) and Number<double> properties are supported,
+ * writing any other type throws an Exception.
+ */
+class TreeSerializer
+{
+public:
+  static void writeTree(QDataStream& out, const TreeTemplate<Node>& tree);
+
+  static std::shared_ptr<TreeTemplate<Node>> readTree(QDataStream& in);
+
+  static bool isSerializable(const Clonable* value);
+
+  /**
+   * @brief Write a value, which can be null.
+   */
+  static void writeValue(QDataStream& out, const Clonable* value);
+
+  static std::shared_ptr<const Clonable> readValue(QDataStream& in);
+
+  static void writeString(QDataStream& out, const std::string& s)
+  {
+    out << QByteArray::fromRawData(s.data(), static_cast<int>(s.size()));
+  }
+
+  static std::string readString(QDataStream& in)
+  {
+    QByteArray data;
+    in >> data;
+    return data.toStdString();
+  }
+
+  /**
+   * @brief Rough estimate of the heap memory used by a tree, in bytes.
+   */
+  static size_t getMemoryUsage(const TreeTemplate<Node>& tree);
+
+  static size_t getMemoryUsage(const Clonable* value);
+
+private:
+  static void writeProperties_(QDataStream& out, const Node& node, bool branch);
+  static void readProperties_(QDataStream& in, Node& node, bool branch);
+};
+
+#endif // _TREESERIALIZER_H_
@@ -4,10 +4,14 @@
 
 #include "TreeSubWindow.h"
 #include "PhyView.h"
+#include "CompressedStream.h"
 
 // From Qt:
+#include <QEvent>
 #include <QScrollArea>
 #include <QMessageBox>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
 
 // From bpp-qt:
 #include <Bpp/Qt/QtTools.h>
@@ -18,29 +22,123 @@ TreeSubWindow::TreeSubWindow(
     const TreeDrawing& td) :
   phyview_(phyview),
   treeDocument_(document),
-  treeCanvas_()
+  drawing_(td.clone()),
+  hibernated_(false),
+  levelOfDetailEnabled_(false),
+  collapsedNodes_(),
+  idleTime_(),
+  treeCanvas_(),
+  levelOfDetail_(),
+  levelOfDetailDrawing_(),
+  panel_(),
+  placeholder_(),
+  splitter_(),
+  treeBrowser_(),
+  treeBrowserLabel_(),
+  treeBrowserIndex_(),
+  nodeFilter_(),
+  nodeEditor_(),
+  nodeModel_(),
+  nodeProxy_(),
+  labels_(),
+  labelsIndexed_(false),
+  drawingNodes_(),
+  drawingNames_(),
+  drawingNodesOf_(0),
+  redrawPending_(false),
+  layoutPending_(false),
+  redrawTimer_()
 {
   setAttribute(Qt::WA_DeleteOnClose);
   setWindowFilePath(QtTools::toQt(treeDocument_->getFilePath()));
   treeDocument_->addView(this);
+  idleTime_.start();
+
+  treeBrowserLabel_ = new QLabel();
+  treeBrowserIndex_ = new QSpinBox();
+  treeBrowserIndex_->setKeyboardTracking(false);
+  connect(treeBrowserIndex_, &QSpinBox::valueChanged, this, &TreeSubWindow::showTreeOfFile);
+  treeBrowser_ = new QWidget();
+  QHBoxLayout* browserLayout = new QHBoxLayout;
+  browserLayout->setContentsMargins(0, 0, 0, 0);
+  browserLayout->addWidget(new QLabel(tr("Tree")));
+  browserLayout->addWidget(treeBrowserIndex_);
+  browserLayout->addWidget(treeBrowserLabel_, 1);
+  treeBrowser_->setLayout(browserLayout);
+  updateTreeBrowser();
+
+  // The drawing and the table are only built when the window is first shown:
+  placeholder_ = new QLabel(tr("Activate the window to draw the tree."));
+  placeholder_->setAlignment(Qt::AlignCenter);
+  panel_ = new QWidget();
+  QVBoxLayout* layout = new QVBoxLayout;
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->addWidget(treeBrowser_);
+  layout->addWidget(placeholder_, 1);
+  panel_->setLayout(layout);
+
+  setMinimumSize(400, 400);
+  setWidget(panel_);
+
+  redrawTimer_.setSingleShot(true);
+  redrawTimer_.setInterval(16);
+  connect(&redrawTimer_, &QTimer::timeout, this, &TreeSubWindow::redrawIfVisible);
+}
+
+TreeSubWindow::~TreeSubWindow()
+{
+  delete panel_;
+  delete levelOfDetail_;
+  phyview_->removeTreesTableRow(this);
+  phyview_->checkLastWindow();
+}
+
+void TreeSubWindow::ensureView()
+{
+  idleTime_.restart();
+  if (treeCanvas_)
+    return;
+  ProfileProbe probe(hibernated_ ? "Wake window" : "Create window", "view");
   treeCanvas_ = new TreeCanvas();
+  // The drawing is set first, so that the tree is laid out once:
+  treeCanvas_->setTreeDrawing(*drawing_);
+  drawing_.reset();
+  // Level of detail applies from the first draw, large trees are never drawn in full:
+  levelOfDetail_ = new LevelOfDetailTreeDrawingListener(treeDocument_, treeCanvas_);
+  levelOfDetailDrawing_ = &treeCanvas_->treeDrawing();
+  treeCanvas_->treeDrawing().addTreeDrawingListener(levelOfDetail_);
+  levelOfDetail_->enable(levelOfDetailEnabled_);
+  levelOfDetail_->invalidate();
+  connect(treeCanvas_, &TreeCanvas::drawingChanged, this, &TreeSubWindow::updateLevelOfDetail);
   treeCanvas_->setTree(treeDocument_->getTree());
-  treeCanvas_->setTreeDrawing(td);
   treeCanvas_->setMinimumSize(400, 400);
   treeCanvas_->addMouseListener(phyview_->getMouseActionListener());
-  connect(treeCanvas_, &TreeCanvas::drawingChanged, phyview, &PhyView::clearSearchResults);
-
-  nodeEditor_ = new QTableWidget();
-  nodeEditor_->setColumnCount(3);
-  connect(nodeEditor_, &QTableWidget::itemChanged, this, &TreeSubWindow::nodeEditorHasChanged);
-  QStringList labels;
-  labels.append(tr("Id"));
-  labels.append(tr("Name"));
-  labels.append(tr("Branch length"));
-  nodeEditor_->setHorizontalHeaderLabels(labels);
-  splitter_ = new QSplitter(this);
+  connect(treeCanvas_, &TreeCanvas::drawingChanged, this, &TreeSubWindow::invalidateLabels);
+  connect(treeCanvas_, &TreeCanvas::drawingChanged, phyview_, &PhyView::clearSearchResults);
+
+  nodeModel_ = new NodeTableModel(treeDocument_, this);
+  connect(nodeModel_, &NodeTableModel::nodeEdited, this, &TreeSubWindow::nodeEditorHasChanged);
+  nodeProxy_ = new QSortFilterProxyModel(this);
+  nodeProxy_->setSourceModel(nodeModel_);
+  nodeProxy_->setFilterKeyColumn(-1);
+  nodeProxy_->setFilterCaseSensitivity(Qt::CaseInsensitive);
+  nodeEditor_ = new QTableView();
+  nodeEditor_->setModel(nodeProxy_);
+  nodeEditor_->setSortingEnabled(true);
+  nodeEditor_->sortByColumn(-1, Qt::AscendingOrder);
+  nodeFilter_ = new QLineEdit();
+  nodeFilter_->setPlaceholderText(tr("Filter nodes"));
+  nodeFilter_->setClearButtonEnabled(true);
+  connect(nodeFilter_, &QLineEdit::textChanged, nodeProxy_, &QSortFilterProxyModel::setFilterFixedString);
+  QWidget* nodePanel = new QWidget();
+  QVBoxLayout* nodeLayout = new QVBoxLayout;
+  nodeLayout->setContentsMargins(0, 0, 0, 0);
+  nodeLayout->addWidget(nodeFilter_);
+  nodeLayout->addWidget(nodeEditor_);
+  nodePanel->setLayout(nodeLayout);
+  splitter_ = new QSplitter();
   splitter_->addWidget(treeCanvas_);
-  splitter_->addWidget(nodeEditor_);
+  splitter_->addWidget(nodePanel);
   splitter_->setCollapsible(0, true);
   splitter_->setCollapsible(1, true);
   // Move the splitter to the right:
@@ -48,206 +146,445 @@ TreeSubWindow::TreeSubWindow(
   currentSizes[0] = currentSizes[0] + currentSizes[1];
   currentSizes[1] = 0;
   splitter_->setSizes(currentSizes);
+  placeholder_->hide();
+  static_cast<QVBoxLayout*>(panel_->layout())->addWidget(splitter_, 1);
 
-  setMinimumSize(400, 400);
-  setWidget(splitter_);
-  updateTable();
+  // Options set in the controls apply to new windows, woken ones keep their own:
+  if (!hibernated_)
+    phyview_->applyDrawingOptions(*treeCanvas_);
+  hibernated_ = false;
+  vector<int> collapsed;
+  collapsed.swap(collapsedNodes_);
+  collapseNodes(collapsed);
+  phyview_->updateTreesTableRow(this);
 }
 
-TreeSubWindow::~TreeSubWindow()
+void TreeSubWindow::hibernate()
 {
+  if (!treeCanvas_)
+    return;
+  collapsedNodes_ = getCollapsedNodes();
+  TreeDrawing& td = treeCanvas_->treeDrawing();
+  td.removeTreeDrawingListener(levelOfDetail_);
+  // Only the settings of the drawing are kept, not its copy of the tree:
+  drawing_.reset(td.clone());
+  drawing_->setTree(0);
+  redrawTimer_.stop();
+  redrawPending_ = false;
+  layoutPending_ = false;
+  invalidateLabels();
+  drawingNodes_.clear();
+  drawingNames_.clear();
+  drawingNodesOf_ = 0;
+  // The scene and the table go with their widgets:
   delete splitter_;
-  phyview_->checkLastWindow();
+  delete nodeProxy_;
+  delete nodeModel_;
+  delete levelOfDetail_;
+  splitter_ = 0;
+  treeCanvas_ = 0;
+  nodeFilter_ = 0;
+  nodeEditor_ = 0;
+  nodeProxy_ = 0;
+  nodeModel_ = 0;
+  levelOfDetail_ = 0;
+  levelOfDetailDrawing_ = 0;
+  placeholder_->show();
+  hibernated_ = true;
+}
+
+void TreeSubWindow::setLevelOfDetail(bool yn)
+{
+  levelOfDetailEnabled_ = yn;
+  if (levelOfDetail_)
+    levelOfDetail_->enable(yn);
 }
 
-QTableWidgetItem* TreeSubWindow::getTableWigetItem_(Clonable* property)
+void TreeSubWindow::updateLevelOfDetail()
 {
-  QTableWidgetItem* propItem = 0;
-  BppString* str = dynamic_cast<BppString*>(property);
-  if (str)
+  // The drawing is replaced when its type is changed, and the listener has to be added again:
+  if (&treeCanvas_->treeDrawing() != levelOfDetailDrawing_)
   {
-    propItem = new QTableWidgetItem();
-    propItem->setText(QtTools::toQt(*str));
+    levelOfDetailDrawing_ = &treeCanvas_->treeDrawing();
+    treeCanvas_->treeDrawing().addTreeDrawingListener(levelOfDetail_);
+    levelOfDetail_->invalidate();
+    drawingNodesOf_ = 0;
   }
-  else
+  levelOfDetail_->update();
+}
+
+void TreeSubWindow::updateView(const TreeChange& change)
+{
+  if (!treeCanvas_)
   {
-    Number<double>* num = dynamic_cast<Number<double>*>(property);
-    if (num)
+    // Built from the document when needed:
+    if (change.has(TreeChange::TOPOLOGY))
     {
-      propItem = new QTableWidgetItem();
-      propItem->setText(QtTools::toQt(*num));
+      collapsedNodes_.clear();
+      updateTreeBrowser();
+      phyview_->updateTreesTableSize(this);
     }
+    return;
   }
-  return propItem;
-}
-
-void TreeSubWindow::updateTable()
-{
-  stopSignal_ = true;
-  nodes_ = treeDocument_->getTree()->getNodes();
-  nodeEditor_->clearContents();
-  nodeEditor_->setRowCount(nodes_.size());
-
-  vector<string> nodeProperties;
-  TreeTemplateTools::getNodePropertyNames(*treeDocument_->getTree()->getRootNode(), nodeProperties);
-  vector<string> branchProperties;
-  TreeTemplateTools::getBranchPropertyNames(*treeDocument_->getTree()->getRootNode(), branchProperties);
-  QStringList labels;
-  labels.append(tr("Id"));
-  labels.append(tr("Name"));
-  labels.append(tr("Branch length"));
-  for (size_t i = 0; i < nodeProperties.size(); ++i)
+  if (change.has(TreeChange::TOPOLOGY))
   {
-    labels.append(QtTools::toQt(nodeProperties[i]));
+    // Collapsed nodes are reset with the tree, the ones of the new tree are collapsed as it is drawn:
+    levelOfDetail_->invalidate();
+    drawingNodesOf_ = 0;
+    layoutPending_ = false;
+    ProfileProbe probe("Lay out and draw tree", "render");
+    treeCanvas_->setTree(treeDocument_->getTree());
+    updateTreeBrowser();
+    phyview_->updateTreesTableSize(this);
   }
-  for (size_t i = 0; i < branchProperties.size(); ++i)
+  else if (change.affectsDrawing())
   {
-    labels.append(QtTools::toQt(branchProperties[i]));
+    ProfileProbe probe("Update drawn nodes", "render");
+    if (!updateDrawingNodes_(change))
+    {
+      layoutPending_ = true;
+      requestRedraw();
+    }
   }
-  nodeEditor_->setColumnCount(labels.size());
-  nodeEditor_->setHorizontalHeaderLabels(labels);
+  nodeModel_->update(change);
+}
 
-  for (size_t i = 0; i < nodes_.size(); ++i)
+void TreeSubWindow::indexDrawingNodes_()
+{
+  const TreeDrawing& td = treeCanvas_->treeDrawing();
+  if (&td == drawingNodesOf_)
+    return;
+  drawingNodes_.clear();
+  drawingNames_.clear();
+  drawingNodesOf_ = &td;
+  if (!td.hasTree())
+    return;
+  // The canvas draws its own copy of the tree, which is only changed here to follow the document:
+  INode& root = *const_cast<TreeTemplate<INode>*>(td.getTree())->getRootNode();
+  for (INode* node : TreeTraversal::preOrder(root))
   {
-    QTableWidgetItem* idItem = new QTableWidgetItem(QtTools::toQt(TextTools::toString(nodes_[i]->getId())));
-    Qt::ItemFlags flags = idItem->flags();
-    flags &= ~Qt::ItemIsEditable;
-    idItem->setFlags(flags);
-    nodeEditor_->setItem(i, 0, idItem);
-
-    QTableWidgetItem* nameItem = new QTableWidgetItem();
-    if (nodes_[i]->hasName())
-      nameItem->setText(QtTools::toQt(nodes_[i]->getName()));
-    nodeEditor_->setItem(i, 1, nameItem);
-
-    QTableWidgetItem* brlenItem = new QTableWidgetItem();
-    if (nodes_[i]->hasDistanceToFather())
-      brlenItem->setText(QtTools::toQt(TextTools::toString(nodes_[i]->getDistanceToFather())));
-    nodeEditor_->setItem(i, 2, brlenItem);
+    drawingNodes_[node->getId()] = node;
+    if (node->hasName())
+      ++drawingNames_[node->getName()];
+  }
+}
 
-    for (size_t j = 0; j < nodeProperties.size(); ++j)
+bool TreeSubWindow::updateDrawingNodes_(const TreeChange& change)
+{
+  indexDrawingNodes_();
+  // Lengths and branch properties (bootstrap values...) move or change what is drawn:
+  bool inPlace = !change.has(TreeChange::LENGTHS | TreeChange::BRANCH_PROPERTIES);
+  for (int id : change.getNodeIds())
+  {
+    auto it = drawingNodes_.find(id);
+    if (it == drawingNodes_.end())
+    {
+      // Not expected: the drawn tree is replaced as a whole, as for a change of topology.
+      levelOfDetail_->invalidate();
+      drawingNodesOf_ = 0;
+      layoutPending_ = false;
+      treeCanvas_->setTree(treeDocument_->getTree());
+      updateTreeBrowser();
+      return true;
+    }
+    INode& drawn = *it->second;
+    const Node& node = *treeDocument_->getNode(id);
+    string oldName = drawn.hasName() ? drawn.getName() : "";
+    string newName = node.hasName() ? node.getName() : "";
+    if (oldName != newName)
     {
-      QTableWidgetItem* item = 0;
-      if (nodes_[i]->hasNodeProperty(nodeProperties[j]))
+      if (inPlace)
+        inPlace = renameLabel_(oldName, newName);
+      if (drawn.hasName() && --drawingNames_[oldName] == 0)
+        drawingNames_.erase(oldName);
+      if (node.hasName())
       {
-        item = getTableWigetItem_(nodes_[i]->getNodeProperty(nodeProperties[j]));
+        drawn.setName(newName);
+        ++drawingNames_[newName];
       }
       else
       {
-        item = new QTableWidgetItem();
+        drawn.deleteName();
       }
-      nodeEditor_->setItem(i, 3 + j, item);
     }
-
-    for (size_t j = 0; j < branchProperties.size(); ++j)
+    if (change.has(TreeChange::LENGTHS))
     {
-      QTableWidgetItem* item = 0;
-      if (nodes_[i]->hasBranchProperty(branchProperties[j]))
-      {
-        item = getTableWigetItem_(nodes_[i]->getBranchProperty(branchProperties[j]));
-      }
+      if (node.hasDistanceToFather())
+        drawn.setDistanceToFather(node.getDistanceToFather());
       else
+        drawn.deleteDistanceToFather();
+    }
+    if (change.has(TreeChange::BRANCH_PROPERTIES))
+    {
+      drawn.deleteBranchProperties();
+      for (const auto& name : node.getBranchPropertyNames())
       {
-        item = new QTableWidgetItem();
+        drawn.setBranchProperty(name, *node.getBranchProperty(name));
       }
-      nodeEditor_->setItem(i, 3 + nodeProperties.size() + j, item);
     }
   }
-  stopSignal_ = false;
+  return inPlace;
+}
+
+bool TreeSubWindow::renameLabel_(const string& oldName, const string& newName)
+{
+  // Labels are only matched by their text, so the old name must belong to this node only:
+  if (oldName.empty() || newName.empty())
+    return false;
+  auto count = drawingNames_.find(oldName);
+  if (count == drawingNames_.end() || count->second != 1)
+    return false;
+  QString oldText = QtTools::toQt(oldName);
+  QList<QGraphicsTextItem*> items = findLabels(oldText);
+  if (items.size() > 1)
+    return false;
+  // No item if the node is not drawn (in a collapsed subtree, or internal names hidden):
+  if (items.size() == 1)
+  {
+    QString newText = QtTools::toQt(newName);
+    items[0]->setPlainText(newText);
+    labels_.remove(oldText, items[0]);
+    labels_.insert(newText, items[0]);
+  }
+  return true;
+}
+
+void TreeSubWindow::requestRedraw()
+{
+  // Windows without a drawing are drawn when it is built:
+  if (!treeCanvas_)
+    return;
+  redrawPending_ = true;
+  if (isVisible() && !isMinimized() && !redrawTimer_.isActive())
+    redrawTimer_.start();
+}
+
+void TreeSubWindow::redrawIfVisible()
+{
+  // Hidden windows keep their request until they are shown:
+  if (!redrawPending_ || !treeCanvas_ || !isVisible() || isMinimized())
+    return;
+  redrawPending_ = false;
+  ProfileProbe probe("Draw tree", "render");
+  if (layoutPending_)
+  {
+    // Nodes of the drawn tree were changed by updateView:
+    layoutPending_ = false;
+    treeCanvas_->treeDrawing().treeHasChanged();
+  }
+  treeCanvas_->redraw();
+}
+
+void TreeSubWindow::showEvent(QShowEvent* event)
+{
+  QMdiSubWindow::showEvent(event);
+  if (!treeCanvas_)
+    ensureView();
+  if (redrawPending_)
+    redrawTimer_.start();
+}
+
+void TreeSubWindow::changeEvent(QEvent* event)
+{
+  QMdiSubWindow::changeEvent(event);
+  if (event->type() != QEvent::WindowStateChange || isMinimized())
+    return;
+  if (!treeCanvas_ && isVisible())
+    ensureView();
+  if (redrawPending_)
+    redrawTimer_.start();
+}
+
+void TreeSubWindow::updateTreeBrowser()
+{
+  if (!treeDocument_->hasMultiTreeFile())
+  {
+    treeBrowser_->hide();
+    return;
+  }
+  auto trees = treeDocument_->getMultiTreeFile();
+  size_t current = treeDocument_->getCurrentTreeInFile();
+  {
+    QSignalBlocker blocker(treeBrowserIndex_);
+    treeBrowserIndex_->setRange(1, static_cast<int>(trees->getNumberOfTrees()));
+    treeBrowserIndex_->setValue(static_cast<int>(current) + 1);
+  }
+  QString text = tr("of %1").arg(trees->getNumberOfTrees());
+  if (!trees->getTreeName(current).empty())
+    text += " - " + QtTools::toQt(trees->getTreeName(current));
+  treeBrowserLabel_->setText(text);
+  treeBrowser_->show();
+}
+
+void TreeSubWindow::showTreeOfFile(int index)
+{
+  if (treeDocument_->modified()
+      && QMessageBox::question(this, tr("Browse trees"), tr("The changes made to this tree will be lost. Continue?")) != QMessageBox::Yes)
+  {
+    updateTreeBrowser();
+    return;
+  }
+  try
+  {
+    treeDocument_->showTreeOfFile(static_cast<size_t>(index - 1));
+  }
+  catch (exception& e)
+  {
+    QMessageBox::critical(this, tr("Ouch..."), tr("Error when reading tree %1:\n").arg(index) + QString::fromStdString(e.what()));
+  }
+  updateTreeBrowser();
+}
+
+vector<int> TreeSubWindow::getCollapsedNodes() const
+{
+  if (!treeCanvas_)
+    return collapsedNodes_;
+  vector<int> collapsed;
+  const TreeDrawing& td = treeCanvas_->treeDrawing();
+  for (int id : TreeTraversal::getNodesId(treeDocument_->tree().rootNode()))
+  {
+    if (td.isNodeCollapsed(id) && !levelOfDetail_->hasCollapsed(id))
+      collapsed.push_back(id);
+  }
+  return collapsed;
+}
+
+void TreeSubWindow::collapseNodes(const vector<int>& ids)
+{
+  if (ids.empty())
+    return;
+  if (!treeCanvas_)
+  {
+    collapsedNodes_.insert(collapsedNodes_.end(), ids.begin(), ids.end());
+    return;
+  }
+  TreeDrawing& td = treeCanvas_->treeDrawing();
+  for (int id : ids)
+  {
+    if (treeDocument_->tree().hasNode(id))
+      td.collapseNode(id, true);
+  }
+  treeCanvas_->redraw();
+}
+
+QList<QGraphicsTextItem*> TreeSubWindow::findLabels(const QString& text)
+{
+  ensureView();
+  if (!labelsIndexed_)
+  {
+    for (auto* item : treeCanvas_->scene()->items())
+    {
+      auto* label = qgraphicsitem_cast<QGraphicsTextItem*>(item);
+      if (label)
+        labels_.insert(label->toPlainText(), label);
+    }
+    labelsIndexed_ = true;
+  }
+  return labels_.values(text);
+}
+
+void TreeSubWindow::updateTable()
+{
+  if (!nodeModel_)
+    return;
+  ProfileProbe probe("Update table", "view");
+  nodeModel_->reset();
 }
 
 void TreeSubWindow::writeTableToFile(const string& file, const string& sep)
 {
-  ofstream out(file.c_str(), ios::out);
-  for (int j = 0; j < nodeEditor_->columnCount(); ++j)
+  // Windows without a view use a model of their own, rather than drawing the tree:
+  unique_ptr<NodeTableModel> model;
+  const NodeTableModel* table = nodeModel_;
+  if (!table)
   {
-    QTableWidgetItem* hitem = nodeEditor_->horizontalHeaderItem(j);
-    out << (j > 0 ? sep : "") << (hitem ? hitem->text().toStdString() : "");
+    model.reset(new NodeTableModel(treeDocument_));
+    table = model.get();
+  }
+  CompressedOutputFile out(file, Compression::isCompressedName(file));
+  int nbColumns = table->columnCount();
+  int nbRows = table->rowCount();
+  for (int j = 0; j < nbColumns; ++j)
+  {
+    out << (j > 0 ? sep : "") << table->headerData(j, Qt::Horizontal).toString().toStdString();
   }
   out << endl;
-  for (int i = 0; i < nodeEditor_->rowCount(); ++i)
+  for (int i = 0; i < nbRows; ++i)
   {
-    for (int j = 0; j < nodeEditor_->columnCount(); ++j)
+    for (int j = 0; j < nbColumns; ++j)
     {
-      QTableWidgetItem* item = nodeEditor_->item(i, j);
-      out << (j > 0 ? sep : "") << (item ? item->text().toStdString() : 0);
+      out << (j > 0 ? sep : "") << table->data(table->index(i, j)).toString().toStdString();
     }
     out << endl;
   }
   out.close();
 }
 
-void TreeSubWindow::nodeEditorHasChanged(QTableWidgetItem* item)
+void TreeSubWindow::nodeEditorHasChanged(int nodeId, int column, const QString& value)
 {
-  if (stopSignal_)
-    return;
-  if (item->column() == 1)
+  if (column == NodeTableModel::NAME_COLUMN)
   {
     // Change name:
-    phyview_->submitCommand(new ChangeNodeNameCommand(treeDocument_, nodes_[item->row()]->getId(), item->text().toStdString()));
+    phyview_->submitCommand(new ChangeNodeNameCommand(treeDocument_, nodeId, value.toStdString()));
   }
-  else if (item->column() == 2)
+  else if (column == NodeTableModel::LENGTH_COLUMN)
   {
     // Change branch length:
-    phyview_->submitCommand(new ChangeBranchLengthCommand(treeDocument_, nodes_[item->row()]->getId(), item->text().toDouble()));
+    phyview_->submitCommand(new ChangeBranchLengthCommand(treeDocument_, nodeId, value.toDouble()));
   }
   else
   {
     // Change node property:
-    nodes_[item->row()]->setNodeProperty(nodeEditor_->horizontalHeaderItem(item->column())->text().toStdString(), BppString(item->text().toStdString()));
+    phyview_->submitCommand(new ChangeNodePropertyCommand(treeDocument_, nodeId, nodeModel_->headerData(column, Qt::Horizontal).toString().toStdString(), value.toStdString()));
   }
-  treeCanvas_->setTree(treeDocument_->getTree());
 }
 
 void TreeSubWindow::duplicateDownSelection(unsigned int rep)
 {
-  QList<QTableWidgetSelectionRange> selection = nodeEditor_->selectedRanges();
+  ensureView();
+  QModelIndexList selection = nodeEditor_->selectionModel()->selectedIndexes();
   if (selection.size() == 0)
   {
     QMessageBox::critical(phyview_, QString("Oups..."), QString("No selection."));
     return;
   }
   // Perform some checking:
-  int row = -1;
-  for (int i = 0; i < selection.size(); ++i)
+  int row = selection[0].row();
+  for (const auto& index : selection)
   {
-    QTableWidgetSelectionRange range = selection[i];
-    if (range.rowCount() != 1)
+    if (index.row() != row)
     {
       QMessageBox::critical(phyview_, QString("Oups..."), QString("Only one row can be selected."));
       return;
     }
-    if (i == 0)
-    {
-      row = range.topRow();
-    }
-    else
-    {
-      if (range.topRow() != row)
-      {
-        QMessageBox::critical(phyview_, QString("Oups..."), QString("Only one row can be selected."));
-        return;
-      }
-    }
   }
   // Ok, if we reach this stage, then everything is ok...
-  int j;
-  for (j = row + 1; j < nodeEditor_->rowCount() && j - row <= static_cast<int>(rep); ++j)
+  // Rows are identified by node ids, as each edit refreshes the model:
+  vector<int> targets;
+  for (int j = row + 1; j < nodeProxy_->rowCount() && j - row <= static_cast<int>(rep); ++j)
+  {
+    targets.push_back(nodeModel_->getNodeId(nodeProxy_->mapToSource(nodeProxy_->index(j, 0)).row()));
+  }
+  vector<pair<int, QString>> values;
+  for (const auto& index : selection)
   {
-    for (int i = 0; i < selection.size(); ++i)
+    if (index.flags() & Qt::ItemIsEditable)
+      values.push_back(make_pair(nodeProxy_->mapToSource(index).column(), index.data(Qt::EditRole).toString()));
+  }
+  treeDocument_->getUndoStack().beginMacro(tr("Duplicate down"));
+  for (int id : targets)
+  {
+    for (const auto& value : values)
     {
-      QTableWidgetSelectionRange range = selection[i];
-      for (int k = range.leftColumn(); k <= range.rightColumn(); ++k)
-      {
-        nodeEditor_->setItem(j, k, nodeEditor_->item(row, k)->clone());
-      }
+      nodeEditorHasChanged(id, value.first, value.second);
     }
   }
+  treeDocument_->getUndoStack().endMacro();
   // Shift selection:
-  for (int i = 0; i < selection.size(); ++i)
+  int last = row + static_cast<int>(targets.size());
+  nodeEditor_->clearSelection();
+  for (const auto& index : selection)
   {
-    QTableWidgetSelectionRange range = selection[i];
-    nodeEditor_->setRangeSelected(range, false);
-    nodeEditor_->setRangeSelected(QTableWidgetSelectionRange(j - 1, range.leftColumn(), j - 1, range.rightColumn()), true);
+    nodeEditor_->selectionModel()->select(nodeProxy_->index(last, index.column()), QItemSelectionModel::Select);
   }
 }
@@ -6,11 +6,21 @@
 #define _TREESUBWINDOW_H_
 
 #include "TreeDocument.h"
+#include "NodeTableModel.h"
+#include "LevelOfDetail.h"
 
 // From Qt:
 #include <QMdiSubWindow>
 #include <QSplitter>
-#include <QTableWidget>
+#include <QTableView>
+#include <QSortFilterProxyModel>
+#include <QLineEdit>
+#include <QLabel>
+#include <QSpinBox>
+#include <QGraphicsTextItem>
+#include <QMultiHash>
+#include <QTimer>
+#include <QElapsedTimer>
 
 // From bpp-phyl:
 #include <Bpp/Phyl/Graphics/TreeDrawing.h>
@@ -18,10 +28,23 @@
 // From bpp-qt
 #include <Bpp/Qt/Tree/TreeCanvas.h>
 
+// From the STL:
+#include <string>
+#include <unordered_map>
+
 using namespace bpp;
 
 class PhyView;
 
+/**
+ * @brief A window showing a document, as a drawing and a table of nodes.
+ *
+ * The drawing, with its scene, and the table are only built when the window is
+ * first shown, so that many documents can be opened at once. They can be freed
+ * again when the window is not viewed (hibernation), while the document and its
+ * undo stack are kept: the drawing settings and the collapsed nodes are restored
+ * when the window is viewed again.
+ */
 class TreeSubWindow :
   public QMdiSubWindow,
   public DocumentView
@@ -31,11 +54,35 @@ class TreeSubWindow :
 private:
   PhyView* phyview_;
   std::shared_ptr<TreeDocument> treeDocument_;
+  // Settings of the drawing, while the window has no view:
+  std::unique_ptr<TreeDrawing> drawing_;
+  bool hibernated_;
+  bool levelOfDetailEnabled_;
+  // Nodes collapsed by the user, while the window has no view:
+  std::vector<int> collapsedNodes_;
+  QElapsedTimer idleTime_;
   TreeCanvas* treeCanvas_;
+  LevelOfDetailTreeDrawingListener* levelOfDetail_;
+  const TreeDrawing* levelOfDetailDrawing_;
+  QWidget* panel_;
+  QLabel* placeholder_;
   QSplitter* splitter_;
-  QTableWidget* nodeEditor_;
-  std::vector<Node*> nodes_;
-  bool stopSignal_;
+  QWidget* treeBrowser_;
+  QLabel* treeBrowserLabel_;
+  QSpinBox* treeBrowserIndex_;
+  QLineEdit* nodeFilter_;
+  QTableView* nodeEditor_;
+  NodeTableModel* nodeModel_;
+  QSortFilterProxyModel* nodeProxy_;
+  QMultiHash<QString, QGraphicsTextItem*> labels_;
+  bool labelsIndexed_;
+  // The nodes of the copy of the tree drawn by the canvas, and how many of them carry each name:
+  std::unordered_map<int, INode*> drawingNodes_;
+  std::unordered_map<std::string, unsigned int> drawingNames_;
+  const TreeDrawing* drawingNodesOf_;
+  bool redrawPending_;
+  bool layoutPending_;
+  QTimer redrawTimer_;
 
 public:
   TreeSubWindow(
@@ -49,29 +96,148 @@ public:
   std::shared_ptr<TreeDocument> getDocument() { return treeDocument_; }
   const TreeTemplate<Node>& tree() const { return treeDocument_->tree(); }
 
+  /**
+   * @return The canvas, or a null pointer if the window has no view.
+   */
   const TreeCanvas* getTreeCanvas() const { return treeCanvas_; }
-  TreeCanvas* getTreeCanvas() { return treeCanvas_; }
 
-  const TreeCanvas& treeCanvas() const { return *treeCanvas_; }
-  TreeCanvas& treeCanvas() { return *treeCanvas_; }
+  /**
+   * @return The canvas. The view is built if needed.
+   */
+  TreeCanvas* getTreeCanvas()
+  {
+    ensureView();
+    return treeCanvas_;
+  }
+
+  TreeCanvas& treeCanvas()
+  {
+    ensureView();
+    return *treeCanvas_;
+  }
+
+  /**
+   * @return true if the drawing and the table of the window exist.
+   */
+  bool hasView() const { return treeCanvas_ != 0; }
+
+  /**
+   * @brief Build the drawing and the table, if needed, and mark the window as viewed.
+   */
+  void ensureView();
+
+  /**
+   * @brief Free the drawing, its scene and the table. The document is kept.
+   */
+  void hibernate();
+
+  /**
+   * @return The time since the window was last viewed, in milliseconds.
+   */
+  qint64 getIdleTime() const { return idleTime_.elapsed(); }
 
   void duplicateDownSelection(unsigned int rep);
 
-  void updateView()
+  /**
+   * @brief Refresh the drawing only if the change is visible in it, and the table rows which were touched.
+   *
+   * The drawing is only rebuilt from the tree on topology changes. Other changes are
+   * copied to the nodes drawn by the canvas: renamed labels are edited in place, and
+   * other visible changes are laid out and drawn again at the next coalesced redraw.
+   */
+  void updateView(const TreeChange& change);
+
+  LevelOfDetailTreeDrawingListener& levelOfDetail()
   {
-    treeCanvas_->setTree(treeDocument_->getTree());
-    updateTable();
+    ensureView();
+    return *levelOfDetail_;
   }
 
+  /**
+   * @brief Enable the level of detail, now or when the view is built.
+   */
+  void setLevelOfDetail(bool yn);
+
+  /**
+   * @brief Ask for the drawing to be redone.
+   *
+   * Requests made within a frame are coalesced into a single redraw. The drawing of a
+   * hidden or minimized window is only redone when it is shown again.
+   */
+  void requestRedraw();
+
+  /**
+   * @return The ids of the nodes collapsed by the user, not those collapsed for the level of detail.
+   */
+  std::vector<int> getCollapsedNodes() const;
+
+  /**
+   * @brief Collapse several nodes, and redraw once. Ids not in the tree are ignored.
+   */
+  void collapseNodes(const std::vector<int>& ids);
+
   void updateTable();
 
+  /**
+   * @brief Show the controls to browse the trees of the file, if the document was read from a file with several trees.
+   */
+  void updateTreeBrowser();
+
+  /**
+   * @return The text items of the drawing showing a given text.
+   *
+   * Items are indexed on first use after each redraw.
+   */
+  QList<QGraphicsTextItem*> findLabels(const QString& text);
+
+  /**
+   * @brief Write the node table, compressed with gzip if the name of the file ends with ".gz".
+   *
+   * @throw IOException If the file cannot be written.
+   */
   void writeTableToFile(const string& file, const string& sep);
 
+protected:
+  void showEvent(QShowEvent* event);
+
+  void changeEvent(QEvent* event);
+
+private slots:
+  void nodeEditorHasChanged(int nodeId, int column, const QString& value);
+
+  void updateLevelOfDetail();
+
+  void redrawIfVisible();
+
 private:
-  QTableWidgetItem* getTableWigetItem_(Clonable* property);
+  /**
+   * @brief Index the nodes drawn by the canvas, if not done since the tree or the drawing was replaced.
+   */
+  void indexDrawingNodes_();
+
+  /**
+   * @brief Copy the names, lengths and branch properties of the nodes touched by a change to the drawn tree.
+   *
+   * @return false if the drawing has to be laid out and drawn again.
+   */
+  bool updateDrawingNodes_(const TreeChange& change);
+
+  /**
+   * @brief Replace the text of the label of a node, if it can be told apart from other labels.
+   *
+   * @return false if the label could not be found unambiguously.
+   */
+  bool renameLabel_(const std::string& oldName, const std::string& newName);
 
 private slots:
-  void nodeEditorHasChanged(QTableWidgetItem* item);
+
+  void showTreeOfFile(int index);
+
+  void invalidateLabels()
+  {
+    labels_.clear();
+    labelsIndexed_ = false;
+  }
 };
 
 #endif // _TREESUBWINDOW_H_
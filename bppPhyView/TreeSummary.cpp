@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "TreeSummary.h"
+
+// From the STL:
+#include <algorithm>
+#include <tuple>
+
+using namespace std;
+
+const size_t TreeSummary::NUMBER_OF_FIRST_LEAVES;
+
+void TreeSummary::build(const Node& root)
+{
+  clear();
+  // Pre-order traversal with an explicit stack of (node, depth, distance from the root):
+  vector<tuple<const Node*, size_t, double>> stack(1, make_tuple(&root, size_t(0), 0.));
+  while (!stack.empty())
+  {
+    const Node* node;
+    size_t depth;
+    double distance;
+    tie(node, depth, distance) = stack.back();
+    stack.pop_back();
+    ++numberOfNodes_;
+    for (const auto& name : node->getNodePropertyNames())
+    {
+      nodePropertyNames_.insert(name);
+    }
+    for (const auto& name : node->getBranchPropertyNames())
+    {
+      branchPropertyNames_.insert(name);
+    }
+    size_t n = node->getNumberOfSons();
+    if (n == 0)
+    {
+      ++numberOfLeaves_;
+      depth_ = max(depth_, depth);
+      height_ = max(height_, distance);
+      if (firstLeavesNames_.size() < NUMBER_OF_FIRST_LEAVES && node->hasName())
+        firstLeavesNames_.push_back(node->getName());
+      continue;
+    }
+    if (node != &root)
+      maxNumberOfSons_ = max(maxNumberOfSons_, n);
+    // Push sons in reverse order so that leaves are met in their original order:
+    for (size_t i = n; i > 0; --i)
+    {
+      const Node* son = node->getSon(i - 1);
+      double length = son->hasDistanceToFather() ? son->getDistanceToFather() : 0.;
+      totalLength_ += length;
+      stack.push_back(make_tuple(son, depth + 1, distance + length));
+    }
+  }
+  built_ = true;
+}
+
+void TreeSummary::clear()
+{
+  numberOfLeaves_ = 0;
+  numberOfNodes_ = 0;
+  depth_ = 0;
+  height_ = 0.;
+  totalLength_ = 0.;
+  maxNumberOfSons_ = 0;
+  firstLeavesNames_.clear();
+  nodePropertyNames_.clear();
+  branchPropertyNames_.clear();
+  built_ = false;
+}
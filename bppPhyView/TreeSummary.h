@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREESUMMARY_H_
+#define _TREESUMMARY_H_
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+
+// From the STL:
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief Summary statistics of a tree, computed in one traversal.
+ *
+ * Documents keep their summary until a command changes the tree, so that lists
+ * of documents and the statistics panel do not traverse the trees again.
+ */
+class TreeSummary
+{
+public:
+  /**
+   * @brief The number of leaf names kept, to describe the tree.
+   */
+  static const size_t NUMBER_OF_FIRST_LEAVES = 5;
+
+private:
+  size_t numberOfLeaves_;
+  size_t numberOfNodes_;
+  size_t depth_;
+  double height_;
+  double totalLength_;
+  size_t maxNumberOfSons_;
+  std::vector<std::string> firstLeavesNames_;
+  std::set<std::string> nodePropertyNames_;
+  std::set<std::string> branchPropertyNames_;
+  bool built_;
+
+public:
+  TreeSummary() :
+    numberOfLeaves_(0),
+    numberOfNodes_(0),
+    depth_(0),
+    height_(0.),
+    totalLength_(0.),
+    maxNumberOfSons_(0),
+    firstLeavesNames_(),
+    nodePropertyNames_(),
+    branchPropertyNames_(),
+    built_(false)
+  {}
+
+public:
+  bool isBuilt() const { return built_; }
+
+  /**
+   * @brief Summarize a (sub)tree.
+   */
+  void build(const Node& root);
+
+  /**
+   * @brief Forget everything. The summary has to be built again before use.
+   */
+  void clear();
+
+  size_t getNumberOfLeaves() const { return numberOfLeaves_; }
+  size_t getNumberOfNodes() const { return numberOfNodes_; }
+
+  /**
+   * @return The largest number of branches from the root to a leaf.
+   */
+  size_t getDepth() const { return depth_; }
+
+  /**
+   * @return The largest distance from the root to a leaf. Missing lengths count as 0.
+   */
+  double getHeight() const { return height_; }
+
+  /**
+   * @return The sum of all branch lengths. Missing lengths count as 0.
+   */
+  double getTotalLength() const { return totalLength_; }
+
+  /**
+   * @return true if a node has more than two sons, the root excepted.
+   */
+  bool isMultifurcating() const { return maxNumberOfSons_ > 2; }
+
+  /**
+   * @return The names of the first leaves, in pre-order. Unnamed leaves are skipped.
+   */
+  const std::vector<std::string>& getFirstLeavesNames() const { return firstLeavesNames_; }
+
+  /**
+   * @return The names of the node properties found on any node.
+   */
+  const std::set<std::string>& getNodePropertyNames() const { return nodePropertyNames_; }
+
+  /**
+   * @return The names of the branch properties found on any node.
+   */
+  const std::set<std::string>& getBranchPropertyNames() const { return branchPropertyNames_; }
+};
+
+#endif // _TREESUMMARY_H_
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "TreeSummaryBox.h"
+
+// From Qt:
+#include <QFormLayout>
+#include <QStringList>
+
+// From bpp-qt:
+#include <Bpp/Qt/QtTools.h>
+
+using namespace bpp;
+
+TreeSummaryBox::TreeSummaryBox(QWidget* parent) :
+  QWidget(parent),
+  numberOfLeaves_(new QLabel()),
+  numberOfNodes_(new QLabel()),
+  depth_(new QLabel()),
+  height_(new QLabel()),
+  totalLength_(new QLabel()),
+  multifurcating_(new QLabel()),
+  properties_(new QLabel())
+{
+  properties_->setWordWrap(true);
+  QFormLayout* layout = new QFormLayout;
+  layout->addRow(tr("Leaves:"), numberOfLeaves_);
+  layout->addRow(tr("Nodes:"), numberOfNodes_);
+  layout->addRow(tr("Depth:"), depth_);
+  layout->addRow(tr("Height:"), height_);
+  layout->addRow(tr("Total length:"), totalLength_);
+  layout->addRow(tr("Multifurcating:"), multifurcating_);
+  layout->addRow(tr("Properties:"), properties_);
+  setLayout(layout);
+}
+
+void TreeSummaryBox::showSummary(const TreeSummary& summary)
+{
+  numberOfLeaves_->setText(QString::number(summary.getNumberOfLeaves()));
+  numberOfNodes_->setText(QString::number(summary.getNumberOfNodes()));
+  depth_->setText(QString::number(summary.getDepth()));
+  height_->setText(QString::number(summary.getHeight()));
+  totalLength_->setText(QString::number(summary.getTotalLength()));
+  multifurcating_->setText(summary.isMultifurcating() ? tr("yes") : tr("no"));
+  QStringList names;
+  for (const auto& name : summary.getNodePropertyNames())
+  {
+    names << QtTools::toQt(name);
+  }
+  for (const auto& name : summary.getBranchPropertyNames())
+  {
+    names << tr("%1 (branch)").arg(QtTools::toQt(name));
+  }
+  properties_->setText(names.isEmpty() ? tr("none") : names.join(", "));
+}
+
+void TreeSummaryBox::clear()
+{
+  numberOfLeaves_->clear();
+  numberOfNodes_->clear();
+  depth_->clear();
+  height_->clear();
+  totalLength_->clear();
+  multifurcating_->clear();
+  properties_->clear();
+}
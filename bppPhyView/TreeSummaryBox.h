@@ -0,0 +1,43 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREESUMMARYBOX_H_
+#define _TREESUMMARYBOX_H_
+
+#include "TreeSummary.h"
+
+// From Qt:
+#include <QLabel>
+#include <QWidget>
+
+/**
+ * @brief Shows the summary statistics of a tree, as cached by its document.
+ */
+class TreeSummaryBox :
+  public QWidget
+{
+  Q_OBJECT
+
+private:
+  QLabel* numberOfLeaves_;
+  QLabel* numberOfNodes_;
+  QLabel* depth_;
+  QLabel* height_;
+  QLabel* totalLength_;
+  QLabel* multifurcating_;
+  QLabel* properties_;
+
+public:
+  TreeSummaryBox(QWidget* parent = 0);
+
+public:
+  void showSummary(const TreeSummary& summary);
+
+  /**
+   * @brief Show empty fields, when no tree is active.
+   */
+  void clear();
+};
+
+#endif // _TREESUMMARYBOX_H_
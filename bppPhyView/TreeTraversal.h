@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _TREETRAVERSAL_H_
+#define _TREETRAVERSAL_H_
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+#include <Bpp/Phyl/Tree/TreeTemplate.h>
+
+// From the STL:
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace bpp;
+
+/**
+ * @brief Traversals of subtrees with an explicit stack.
+ *
+ * The recursive functions of TreeTemplateTools overflow the stack on very deep
+ * (caterpillar-like) trees, these ones only use heap memory. N is Node or const Node.
+ * The copy constructor and the destructor of TreeTemplate are recursive too: trees
+ * are copied with cloneTree(), and owned by pointers made by adoptTree() or makeTree().
+ */
+class TreeTraversal
+{
+public:
+  /**
+   * @return The nodes of the subtree, each one before its sons, sons in order.
+   */
+  template<class N>
+  static std::vector<N*> preOrder(N& root)
+  {
+    std::vector<N*> nodes;
+    std::vector<N*> stack(1, &root);
+    while (!stack.empty())
+    {
+      N* node = stack.back();
+      stack.pop_back();
+      nodes.push_back(node);
+      for (size_t i = node->getNumberOfSons(); i > 0; --i)
+      {
+        stack.push_back(node->getSon(i - 1));
+      }
+    }
+    return nodes;
+  }
+
+  /**
+   * @return The nodes of the subtree, each one after its sons, sons in order.
+   * This is the order of TreeTemplate::getNodes().
+   */
+  template<class N>
+  static std::vector<N*> postOrder(N& root)
+  {
+    // Pre-order with sons in reverse order, reversed:
+    std::vector<N*> nodes;
+    std::vector<N*> stack(1, &root);
+    while (!stack.empty())
+    {
+      N* node = stack.back();
+      stack.pop_back();
+      nodes.push_back(node);
+      for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+      {
+        stack.push_back(node->getSon(i));
+      }
+    }
+    std::reverse(nodes.begin(), nodes.end());
+    return nodes;
+  }
+
+  static std::vector<int> getNodesId(const Node& root)
+  {
+    std::vector<int> ids;
+    for (const Node* node : postOrder(root))
+    {
+      ids.push_back(node->getId());
+    }
+    return ids;
+  }
+
+  static size_t getNumberOfNodes(const Node& root)
+  {
+    size_t n = 0;
+    std::vector<const Node*> stack(1, &root);
+    while (!stack.empty())
+    {
+      const Node* node = stack.back();
+      stack.pop_back();
+      ++n;
+      for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+      {
+        stack.push_back(node->getSon(i));
+      }
+    }
+    return n;
+  }
+
+  static size_t getNumberOfLeaves(const Node& root)
+  {
+    size_t n = 0;
+    std::vector<const Node*> stack(1, &root);
+    while (!stack.empty())
+    {
+      const Node* node = stack.back();
+      stack.pop_back();
+      if (node->isLeaf())
+        ++n;
+      for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+      {
+        stack.push_back(node->getSon(i));
+      }
+    }
+    return n;
+  }
+
+  /**
+   * @return The names of the leaves of the subtree, in order. Leaves without a name are skipped.
+   */
+  static std::vector<std::string> getLeavesNames(const Node& root)
+  {
+    std::vector<std::string> names;
+    for (const Node* node : preOrder(root))
+    {
+      if (node->isLeaf() && node->hasName())
+        names.push_back(node->getName());
+    }
+    return names;
+  }
+
+  /**
+   * @brief Copy a subtree, as TreeTemplateTools::cloneSubtree.
+   *
+   * @return The root of the copy, to be deleted by the caller.
+   */
+  static Node* cloneSubtree(const Node& root)
+  {
+    Node* clone = new Node(root);
+    std::vector<std::pair<const Node*, Node*>> stack(1, std::make_pair(&root, clone));
+    while (!stack.empty())
+    {
+      const Node* node = stack.back().first;
+      Node* copy = stack.back().second;
+      stack.pop_back();
+      for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+      {
+        Node* son = new Node(*node->getSon(i));
+        copy->addSon(son);
+        stack.push_back(std::make_pair(node->getSon(i), son));
+      }
+    }
+    return clone;
+  }
+
+  /**
+   * @brief Delete a tree, without the recursion of the destructor of TreeTemplate.
+   */
+  static void deleteTree(TreeTemplate<Node>* tree)
+  {
+    if (tree && tree->getRootNode())
+    {
+      Node* root = tree->getRootNode();
+      std::vector<Node*> nodes = postOrder(*root);
+      nodes.pop_back();
+      // The root is left alone, for the destructor of the tree. Nodes do not delete their sons:
+      for (size_t i = root->getNumberOfSons(); i > 0; --i)
+      {
+        root->removeSon(i - 1);
+      }
+      for (Node* node : nodes)
+      {
+        delete node;
+      }
+    }
+    delete tree;
+  }
+
+  /**
+   * @return A pointer owning the tree, which deletes it with deleteTree().
+   */
+  static std::shared_ptr<TreeTemplate<Node>> adoptTree(TreeTemplate<Node>* tree)
+  {
+    return std::shared_ptr<TreeTemplate<Node>>(tree, &TreeTraversal::deleteTree);
+  }
+
+  /**
+   * @return A tree made of the subtree, owning it, which deletes it with deleteTree().
+   */
+  static std::shared_ptr<TreeTemplate<Node>> makeTree(Node* root)
+  {
+    return adoptTree(new TreeTemplate<Node>(root));
+  }
+
+  /**
+   * @brief Copy a tree, as the copy constructor of TreeTemplate.
+   *
+   * @return The copy, which deletes it with deleteTree().
+   */
+  static std::shared_ptr<TreeTemplate<Node>> cloneTree(const TreeTemplate<Node>& tree)
+  {
+    std::shared_ptr<TreeTemplate<Node>> clone = makeTree(cloneSubtree(*tree.getRootNode()));
+    clone->setName(tree.getName());
+    return clone;
+  }
+};
+
+#endif // _TREETRAVERSAL_H_
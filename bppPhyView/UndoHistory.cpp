@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "UndoHistory.h"
+
+#include <Bpp/Exceptions.h>
+
+// From Qt:
+#include <QDataStream>
+#include <QDir>
+
+// From the STL:
+#include <iterator>
+
+using namespace bpp;
+
+const size_t UndoHistory::DEFAULT_MEMORY_LIMIT = 512 * 1024 * 1024;
+
+size_t UndoHistory::getMemoryUsage() const
+{
+  size_t total = 0;
+  for (const auto* command : commands_)
+  {
+    total += command->getPayloadMemoryUsage();
+  }
+  return total;
+}
+
+void UndoHistory::enforceMemoryLimit(const SpillableCommand* current)
+{
+  size_t usage = getMemoryUsage();
+  for (auto* command : commands_)
+  {
+    if (usage <= memoryLimit_)
+      break;
+    if (command == current)
+      continue;
+    size_t size = command->getPayloadMemoryUsage();
+    if (size > 0 && command->spill())
+      usage -= size;
+  }
+}
+
+qint64 UndoHistory::store(const QByteArray& data)
+{
+  if (!file_.isOpen())
+  {
+    file_.setFileTemplate(QDir::tempPath() + "/phyview-undo-XXXXXX");
+    if (!file_.open())
+      return -1;
+  }
+  QByteArray record;
+  QDataStream buffer(&record, QIODevice::WriteOnly);
+  buffer << qCompress(data, 1);
+  qint64 size = record.size();
+
+  // First fit, the rest of the block stays free:
+  qint64 offset = file_.size();
+  for (auto it = freeBlocks_.begin(); it != freeBlocks_.end(); ++it)
+  {
+    if (it->second >= size)
+    {
+      offset = it->first;
+      qint64 rest = it->second - size;
+      freeBlocks_.erase(it);
+      if (rest > 0)
+        freeBlocks_[offset + size] = rest;
+      break;
+    }
+  }
+  if (!file_.seek(offset) || file_.write(record) != size)
+  {
+    if (offset < file_.size())
+      free_(offset, size);
+    return -1;
+  }
+  usedBlocks_[offset] = size;
+  return offset;
+}
+
+QByteArray UndoHistory::load(qint64 offset)
+{
+  if (!file_.isOpen() || !file_.seek(offset))
+    throw Exception("UndoHistory::load. Cannot read undo history file.");
+  QDataStream in(&file_);
+  QByteArray data;
+  in >> data;
+  if (in.status() != QDataStream::Ok)
+    throw Exception("UndoHistory::load. Corrupted undo history file.");
+  release(offset);
+  return qUncompress(data);
+}
+
+void UndoHistory::release(qint64 offset)
+{
+  auto it = usedBlocks_.find(offset);
+  if (it == usedBlocks_.end())
+    return;
+  qint64 size = it->second;
+  usedBlocks_.erase(it);
+  free_(offset, size);
+}
+
+void UndoHistory::free_(qint64 offset, qint64 size)
+{
+  // Merge with the free blocks just before and after:
+  auto next = freeBlocks_.lower_bound(offset);
+  if (next != freeBlocks_.end() && next->first == offset + size)
+  {
+    size += next->second;
+    next = freeBlocks_.erase(next);
+  }
+  if (next != freeBlocks_.begin())
+  {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset)
+    {
+      offset = previous->first;
+      size += previous->second;
+      freeBlocks_.erase(previous);
+    }
+  }
+  // Free space at the end is given back to the file system:
+  if (offset + size >= file_.size() && file_.resize(offset))
+    return;
+  freeBlocks_[offset] = size;
+}
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _UNDOHISTORY_H_
+#define _UNDOHISTORY_H_
+
+// From Qt:
+#include <QByteArray>
+#include <QTemporaryFile>
+
+// From the STL:
+#include <list>
+#include <map>
+
+/**
+ * @brief Interface for undo commands whose payload can be moved out of memory.
+ */
+class SpillableCommand
+{
+public:
+  virtual ~SpillableCommand() {}
+
+public:
+  /**
+   * @return The memory used by the payload of the command, in bytes, or 0 if it has been spilled.
+   */
+  virtual size_t getPayloadMemoryUsage() const = 0;
+
+  /**
+   * @brief Move the payload of the command to the history file.
+   *
+   * @return false if the command cannot be spilled.
+   */
+  virtual bool spill() = 0;
+};
+
+/**
+ * @brief Keeps the memory used by the undo commands of a document under a given limit.
+ *
+ * Commands register themselves at construction. When the limit is exceeded,
+ * the payloads of the least recently used commands are compressed and written
+ * to a temporary file. They are loaded back when the command is undone or redone.
+ *
+ * The space of payloads loaded back or dropped is listed as free, reused by the
+ * next payloads which fit in it, and cut from the file when it is at its end, so
+ * that the file does not grow with the number of spills.
+ */
+class UndoHistory
+{
+private:
+  size_t memoryLimit_;
+  std::list<SpillableCommand*> commands_;
+  QTemporaryFile file_;
+  // Blocks of the file, by offset, with their size:
+  std::map<qint64, qint64> usedBlocks_;
+  std::map<qint64, qint64> freeBlocks_;
+
+public:
+  static const size_t DEFAULT_MEMORY_LIMIT;
+
+public:
+  UndoHistory() :
+    memoryLimit_(DEFAULT_MEMORY_LIMIT),
+    commands_(),
+    file_(),
+    usedBlocks_(),
+    freeBlocks_()
+  {}
+
+private:
+  UndoHistory(const UndoHistory&) = delete;
+  UndoHistory& operator=(const UndoHistory&) = delete;
+
+public:
+  void add(SpillableCommand* command) { commands_.push_back(command); }
+  void remove(SpillableCommand* command) { commands_.remove(command); }
+
+  /**
+   * @brief Mark a command as the most recently used one.
+   */
+  void touch(SpillableCommand* command)
+  {
+    commands_.remove(command);
+    commands_.push_back(command);
+  }
+
+  size_t getMemoryLimit() const { return memoryLimit_; }
+  void setMemoryLimit(size_t limit) { memoryLimit_ = limit; }
+
+  /**
+   * @return The memory currently used by all registered commands, in bytes.
+   */
+  size_t getMemoryUsage() const;
+
+  /**
+   * @return The size of the history file, in bytes.
+   */
+  qint64 getDiskUsage() const { return file_.isOpen() ? file_.size() : 0; }
+
+  /**
+   * @brief Spill commands, least recently used first, until the memory limit is satisfied.
+   *
+   * @param current A command which must stay in memory.
+   */
+  void enforceMemoryLimit(const SpillableCommand* current);
+
+  /**
+   * @brief Compress and write data to the history file, in the first free block large enough, or at its end.
+   *
+   * @return The position where data were written, or -1 in case of failure.
+   */
+  qint64 store(const QByteArray& data);
+
+  /**
+   * @brief Read back data written with store(), and free their space in the file.
+   */
+  QByteArray load(qint64 offset);
+
+  /**
+   * @brief Free the space of data written with store() which will not be read back.
+   */
+  void release(qint64 offset);
+
+private:
+  void free_(qint64 offset, qint64 size);
+};
+
+#endif // _UNDOHISTORY_H_
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#include "ValuePool.h"
+
+#include <Bpp/BppString.h>
+
+// From the STL:
+#include <vector>
+
+using namespace std;
+
+const string* SharedString::getText(const Clonable* property)
+{
+  if (auto shared = dynamic_cast<const SharedString*>(property))
+    return &shared->toSTL();
+  if (auto str = dynamic_cast<const BppString*>(property))
+    return &str->toSTL();
+  return 0;
+}
+
+SharedString ValuePool::get(const string& text)
+{
+  auto it = values_.find(text);
+  if (it == values_.end())
+    it = values_.insert(make_pair(text, make_shared<const string>(text))).first;
+  return SharedString(it->second);
+}
+
+void ValuePool::intern(Node& root)
+{
+  vector<Node*> stack(1, &root);
+  while (!stack.empty())
+  {
+    Node* node = stack.back();
+    stack.pop_back();
+    for (const auto& name : node->getNodePropertyNames())
+    {
+      if (auto str = dynamic_cast<const BppString*>(node->getNodeProperty(name)))
+        node->setNodeProperty(name, get(str->toSTL()));
+    }
+    for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+    {
+      stack.push_back(node->getSon(i));
+    }
+  }
+}
+
+void ValuePool::toBppStrings(Node& root)
+{
+  vector<Node*> stack(1, &root);
+  while (!stack.empty())
+  {
+    Node* node = stack.back();
+    stack.pop_back();
+    for (const auto& name : node->getNodePropertyNames())
+    {
+      if (auto shared = dynamic_cast<const SharedString*>(node->getNodeProperty(name)))
+        node->setNodeProperty(name, BppString(shared->toSTL()));
+    }
+    for (size_t i = 0; i < node->getNumberOfSons(); ++i)
+    {
+      stack.push_back(node->getSon(i));
+    }
+  }
+}
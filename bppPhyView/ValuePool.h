@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: The Bio++ Development Group
+//
+// SPDX-License-Identifier: CECILL-2.1
+
+#ifndef _VALUEPOOL_H_
+#define _VALUEPOOL_H_
+
+#include <Bpp/Clonable.h>
+
+// From bpp-phyl:
+#include <Bpp/Phyl/Tree/Node.h>
+
+// From the STL:
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+using namespace bpp;
+
+/**
+ * @brief A string node property sharing its text with all equal values of a document.
+ *
+ * Copying it only copies a pointer, so that categorical annotations repeated over
+ * many nodes are stored once, and trees and edits can be copied cheaply.
+ */
+class SharedString :
+  public virtual Clonable
+{
+private:
+  std::shared_ptr<const std::string> text_;
+
+public:
+  explicit SharedString(std::shared_ptr<const std::string> text) :
+    text_(text)
+  {}
+
+  SharedString* clone() const { return new SharedString(*this); }
+
+public:
+  const std::string& toSTL() const { return *text_; }
+
+  /**
+   * @return The text of a string property, shared or not, or 0 if it is not a string.
+   */
+  static const std::string* getText(const Clonable* property);
+};
+
+/**
+ * @brief The distinct string property values of a document.
+ *
+ * Values are never removed, as commands in the undo history may still refer to them.
+ */
+class ValuePool
+{
+private:
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> values_;
+
+public:
+  ValuePool() : values_() {}
+
+public:
+  /**
+   * @return A property sharing the text of all equal values.
+   */
+  SharedString get(const std::string& text);
+
+  /**
+   * @brief Replace all string node properties of a (sub)tree by shared ones.
+   */
+  void intern(Node& root);
+
+  /**
+   * @brief Replace all shared node properties of a (sub)tree by plain strings.
+   *
+   * This is needed before writing a tree with bpp-phyl, which only knows BppString.
+   */
+  static void toBppStrings(Node& root);
+
+  size_t getNumberOfValues() const { return values_.size(); }
+};
+
+#endif // _VALUEPOOL_H_
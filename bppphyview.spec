@@ -47,6 +47,7 @@ BuildRoot: %{_builddir}/%{name}-root
 BuildRequires: cmake >= 2.8.11
 BuildRequires: gcc-c++ >= 4.7.0
 BuildRequires: groff
+BuildRequires: zlib-devel
 BuildRequires: libbpp-core4 = 2.4.1
 BuildRequires: libbpp-core-devel = 2.4.1
 BuildRequires: libbpp-phyl12 = 2.4.1